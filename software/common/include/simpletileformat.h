@@ -0,0 +1,140 @@
+#ifndef _SIMPLETILEFORMAT_H
+#define _SIMPLETILEFORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/*
+
+    Layout of the map file, shared by the converter (software/cpp) and the firmware. Plain C++11 without
+    any dependencies, so it compiles with the toolchain of the ESP32 as well as on the host.
+
+    Version 1:
+
+        header      MapHeader (80 bytes)
+        pointers    uint64[n_tiles], offset of each tile relative to the start of the tile data in bytes
+        tile data   int16 pairs of local coordinates, ways separated by (0, 0)
+
+    Version 2:
+
+        header      MapHeaderV2 (104 bytes), MAGIC_V2 followed by the fields of version 1, flags and n_entries
+        index       uint32[n_entries] sorted IDs of the stored tiles, padded to 8 bytes (FLAG_SPARSE only)
+        entries     uint64[n_entries] offset, size and quantization shift of each stored tile
+        tile data
+
+    Version 1 files start with map_x, which can never take the value of the magic number. All values
+    are little endian, which is the byte order of both the host and the ESP32.
+
+*/
+namespace SimpleTileFormat {
+
+    const uint64_t MAGIC_V2 = 0x0000000250414d53ULL;
+    const uint64_t FLAG_SPARSE = 1;
+
+    // Largest quantization shift that fits into an entry
+    const uint8_t MAX_SHIFT = 15;
+
+    struct MapHeader {
+        int64_t map_x;          // x-coordinate of lower left corner (mercator-web)
+        int64_t map_y;          // y-coordinate of lower left corner (mercator-web)
+        uint64_t map_width;
+        uint64_t map_height;
+        uint64_t n_x_tiles;     // number of tiles in x direction
+        uint64_t tile_size;     // size of a tile in mercator units
+        uint64_t n_tiles;       // number of tiles
+        uint64_t max_nodes;     // largest number of coordinate pairs on a single tile
+        uint64_t n_nodes;       // number of coordinate pairs on all tiles, including separators
+        uint64_t n_ways;        // number of ways
+
+        uint64_t n_y_tiles() const {
+            return n_tiles / n_x_tiles;
+        }
+    };
+
+    struct MapHeaderV2 {
+        uint64_t magic;
+        MapHeader map;
+        uint64_t flags;         // combination of FLAG_*
+        uint64_t n_entries;     // number of stored tiles
+    };
+
+    static_assert(sizeof(MapHeader) == 80, "Map header must consist of 10 64-bit values");
+    static_assert(offsetof(MapHeader, tile_size) == 40 && offsetof(MapHeader, max_nodes) == 56,
+        "Map header must not be padded");
+    static_assert(sizeof(MapHeaderV2) == 104, "Map header of version 2 must consist of 13 64-bit values");
+    static_assert(offsetof(MapHeaderV2, map) == 8 && offsetof(MapHeaderV2, flags) == 88,
+        "Map header of version 2 must not be padded");
+
+    // Size of the sparse tile index in bytes, including padding
+    constexpr uint64_t indexBytes(uint64_t flags, uint64_t nEntries) {
+        return (flags & FLAG_SPARSE) ? ((nEntries*sizeof(uint32_t) + 7) / 8) * 8 : 0;
+    }
+
+    // Position of the sparse tile index in the file (version 2)
+    constexpr uint64_t indexOffset() {
+        return sizeof(MapHeaderV2);
+    }
+
+    // Position of the tile pointers (version 1) or the entries (version 2) in the file
+    constexpr uint64_t entriesOffset(uint8_t version, uint64_t flags, uint64_t nEntries) {
+        return version == 2 ? sizeof(MapHeaderV2) + indexBytes(flags, nEntries) : sizeof(MapHeader);
+    }
+
+    // Position of the tile data in the file. nEntries equals n_tiles for version 1.
+    constexpr uint64_t dataOffset(uint8_t version, uint64_t flags, uint64_t nEntries) {
+        return entriesOffset(version, flags, nEntries) + nEntries*sizeof(uint64_t);
+    }
+
+    // Entry of a tile (version 2)
+    //   bits  0-39  offset of the tile relative to the start of the tile data / 4
+    //   bits 40-59  size of the tile / 4
+    //   bits 60-63  quantization shift, local coordinates are value << shift
+    constexpr uint64_t packEntry(uint64_t offset, uint64_t size, uint8_t shift) {
+        return (offset >> 2) | ((size >> 2) << 40) | ((uint64_t) shift << 60);
+    }
+    constexpr uint64_t entryOffset(uint64_t entry) { return (entry & 0xFFFFFFFFFFULL) << 2; }
+    constexpr uint64_t entrySize(uint64_t entry) { return ((entry >> 40) & 0xFFFFFULL) << 2; }
+    constexpr uint8_t entryShift(uint64_t entry) { return entry >> 60; }
+
+    /*
+        Parses the start of a map file, at least sizeof(MapHeaderV2) bytes unless the file is shorter.
+        Returns the version or 0 if the data is not a map. Version 1 maps have no flags and n_tiles entries.
+    */
+    inline uint8_t parseHeader(const void* data, size_t length, MapHeader& header, uint64_t& flags, uint64_t& nEntries) {
+        uint64_t first;
+        if(length < sizeof(MapHeader)) return 0;
+        memcpy(&first, data, sizeof(uint64_t));
+        if(first == MAGIC_V2) {
+            if(length < sizeof(MapHeaderV2)) return 0;
+            MapHeaderV2 headerV2;
+            memcpy(&headerV2, data, sizeof(MapHeaderV2));
+            header = headerV2.map;
+            flags = headerV2.flags;
+            nEntries = headerV2.n_entries;
+            return header.n_x_tiles ? 2 : 0;
+        }
+        memcpy(&header, data, sizeof(MapHeader));
+        flags = 0;
+        nEntries = header.n_tiles;
+        return header.n_x_tiles ? 1 : 0;
+    }
+
+    // CRC32 (IEEE 802.3, reflected). Small and table-less, so the device can use the same implementation.
+    // Sidecar files (tracks, name index, routing graph) store the CRC32 of the 80 byte map header.
+    inline uint32_t crc32(const void* data, size_t length) {
+        const uint8_t* bytes = (const uint8_t*) data;
+        uint32_t crc = 0xFFFFFFFF;
+        for(size_t i=0; i<length; i++) {
+            crc ^= bytes[i];
+            for(int k=0; k<8; k++) {
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+}
+
+#endif
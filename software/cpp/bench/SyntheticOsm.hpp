@@ -0,0 +1,284 @@
+#ifndef SYNTHETIC_OSM_H
+#define SYNTHETIC_OSM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/io/any_output.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/location.hpp>
+
+/*
+
+    Deterministic generator for synthetic OSM files.
+
+    Generates a road network with roughly n_nodes nodes that is made of three kinds of features:
+        - grid cities:          square lattices of residential streets sharing their junction nodes
+        - diagonal highways:    long chains of ways crossing the whole map
+        - dense clusters:       many short, randomly oriented ways packed into a small area
+    A small share of the ways are buildings, which the converter has to skip.
+
+    The covered area grows with the number of nodes so the node density (and thus the nodes per tile)
+    stays roughly constant. The same seed and node count always produce the same file.
+
+*/
+class SyntheticOsmGenerator {
+
+public:
+    // Approximate number of nodes in the generated file
+    uint64_t n_nodes;
+    uint64_t seed;
+
+    // Number of nodes and ways that were actually generated
+    uint64_t generated_nodes = 0;
+    uint64_t generated_ways = 0;
+    uint64_t generated_highways = 0;
+
+    SyntheticOsmGenerator(uint64_t n_nodes, uint64_t seed = 42) : n_nodes(n_nodes), seed(seed) {
+        // 0.2 x 0.2 degree for 10^5 nodes, scaled such that the density stays constant
+        _extent = 0.2 * std::sqrt((double) n_nodes / 1e5);
+        _min_lon = 11.5 - _extent/2;
+        _min_lat = 48.0 - _extent/2;
+    };
+
+    // Writes the synthetic map to path. The format is derived from the file extension (.osm.pbf, .osm, ...)
+    void write(const std::string& path) {
+        osmium::io::Header header;
+        header.set("generator", "osm2simpletile synthetic generator");
+        osmium::io::Writer writer{path, header, osmium::io::overwrite::allow};
+
+        // Nodes have to be written before all ways. The same feature sequence is generated twice,
+        // first emitting only nodes, then only ways. Both passes assign identical node IDs.
+        _buffer = new osmium::memory::Buffer(buffer_size, osmium::memory::Buffer::auto_grow::yes);
+        _writer = &writer;
+
+        _emit_nodes = true;
+        generate();
+        _emit_nodes = false;
+        generate();
+
+        flush(true);
+        delete _buffer;
+        writer.close();
+    }
+
+private:
+    static const size_t buffer_size = 10 * 1024 * 1024;
+
+    double _extent, _min_lon, _min_lat;
+    bool _emit_nodes;
+    uint64_t _rng_state;
+    osmium::object_id_type _next_node_id, _next_way_id;
+    osmium::memory::Buffer* _buffer;
+    osmium::io::Writer* _writer;
+
+    // Splitmix64. Used instead of the <random> distributions because their output is not identical across standard libraries.
+    uint64_t next_random() {
+        uint64_t z = (_rng_state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform random number in [0, 1)
+    double uniform() {
+        return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Uniform random integer in [lo, hi]
+    uint64_t uniform_int(uint64_t lo, uint64_t hi) {
+        return lo + next_random() % (hi - lo + 1);
+    }
+
+    void generate() {
+        _rng_state = seed;
+        _next_node_id = 1;
+        _next_way_id = 1;
+        generated_nodes = 0;
+        generated_ways = 0;
+        generated_highways = 0;
+
+        // Node budget per feature type
+        const uint64_t city_budget = n_nodes / 2;
+        const uint64_t highway_budget = n_nodes / 5;
+        const uint64_t cluster_budget = n_nodes - city_budget - highway_budget;
+
+        uint64_t used = 0;
+        while(used < city_budget) {
+            used += grid_city(city_budget - used);
+        }
+        used = 0;
+        while(used < highway_budget) {
+            used += diagonal_highway(highway_budget - used);
+        }
+        used = 0;
+        while(used < cluster_budget) {
+            used += dense_cluster(cluster_budget - used);
+        }
+    }
+
+    // Square lattice of streets. Horizontal and vertical streets share the junction nodes.
+    uint64_t grid_city(uint64_t budget) {
+        uint64_t n_dim = uniform_int(10, 60);
+        // Streets are subdivided between junctions
+        uint64_t n_sub = uniform_int(1, 4);
+        uint64_t n_lattice = (n_dim - 1) * n_sub + 1;
+        if(n_lattice * n_lattice > budget) {
+            n_lattice = std::max<uint64_t>(2, (uint64_t) std::sqrt((double) budget));
+            n_sub = 1;
+        }
+        // ~100m between lattice points. Cities never cover more than half of the map.
+        double spacing = std::min(0.001, 0.5 * _extent / n_lattice);
+        double lon0 = _min_lon + uniform() * (_extent - spacing * n_lattice);
+        double lat0 = _min_lat + uniform() * (_extent - spacing * n_lattice);
+
+        osmium::object_id_type first_id = _next_node_id;
+        for(uint64_t r=0; r<n_lattice; r++) {
+            for(uint64_t c=0; c<n_lattice; c++) {
+                add_node(lon0 + c * spacing, lat0 + r * spacing);
+            }
+        }
+
+        std::vector<osmium::object_id_type> refs;
+        // Streets along rows, one way per block
+        for(uint64_t r=0; r<n_lattice; r+=n_sub) {
+            for(uint64_t c=0; c+n_sub<n_lattice; c+=n_sub) {
+                refs.clear();
+                for(uint64_t k=0; k<=n_sub; k++) {
+                    refs.push_back(first_id + r * n_lattice + c + k);
+                }
+                add_way(refs, "residential");
+            }
+        }
+        // Streets along columns
+        for(uint64_t c=0; c<n_lattice; c+=n_sub) {
+            for(uint64_t r=0; r+n_sub<n_lattice; r+=n_sub) {
+                refs.clear();
+                for(uint64_t k=0; k<=n_sub; k++) {
+                    refs.push_back(first_id + (r + k) * n_lattice + c);
+                }
+                add_way(refs, "residential");
+            }
+        }
+        return n_lattice * n_lattice;
+    }
+
+    // Long chain of ways crossing the map diagonally with a slight meander.
+    uint64_t diagonal_highway(uint64_t budget) {
+        uint64_t n = std::min<uint64_t>(budget, uniform_int(2000, 20000));
+        if(n < 2) n = 2;
+        bool rising = uniform() < 0.5;
+        double lon_start = _min_lon + uniform() * _extent * 0.1;
+        double lat_start = _min_lat + (rising ? 0.0 : _extent) + (rising ? 1 : -1) * uniform() * _extent * 0.1;
+        double dlon = _extent * 0.9 / n;
+        double dlat = (rising ? 1 : -1) * _extent * 0.9 / n;
+        double phase = uniform() * 6.28;
+
+        std::vector<osmium::object_id_type> refs;
+        for(uint64_t i=0; i<n; i++) {
+            double meander = 0.002 * std::sin(phase + i * 0.01);
+            refs.push_back(add_node(lon_start + i * dlon + meander, lat_start + i * dlat - meander));
+            // OSM limits ways to 2000 nodes. Split the highway, consecutive ways share their end nodes.
+            if(refs.size() == 2000 || i == n-1) {
+                add_way(refs, "primary");
+                osmium::object_id_type last = refs.back();
+                refs.clear();
+                refs.push_back(last);
+            }
+        }
+        return n;
+    }
+
+    // Many short ways packed densely, e.g. tracks, paths and parking aisles.
+    uint64_t dense_cluster(uint64_t budget) {
+        double radius = 0.002 + uniform() * 0.003;
+        double lon_c = _min_lon + radius + uniform() * (_extent - 2 * radius);
+        double lat_c = _min_lat + radius + uniform() * (_extent - 2 * radius);
+        uint64_t n_ways = uniform_int(50, 400);
+        uint64_t used = 0;
+
+        std::vector<osmium::object_id_type> refs;
+        for(uint64_t w=0; w<n_ways && used < budget; w++) {
+            uint64_t n = std::min<uint64_t>(budget - used, uniform_int(2, 12));
+            if(n < 2) break;
+            double lon = lon_c + (uniform() - 0.5) * 2 * radius;
+            double lat = lat_c + (uniform() - 0.5) * 2 * radius;
+            double angle = uniform() * 6.28;
+            refs.clear();
+            for(uint64_t i=0; i<n; i++) {
+                refs.push_back(add_node(lon, lat));
+                angle += (uniform() - 0.5);
+                lon += 0.0001 * std::cos(angle);
+                lat += 0.0001 * std::sin(angle);
+            }
+            if(w % 10 == 9) {
+                // Close the ring and tag it as building. Not a highway.
+                refs.push_back(refs.front());
+                add_way(refs, nullptr);
+            } else {
+                add_way(refs, w % 2 ? "path" : "service");
+            }
+            used += n;
+        }
+        return std::max<uint64_t>(used, 1);
+    }
+
+    osmium::object_id_type add_node(double lon, double lat) {
+        osmium::object_id_type id = _next_node_id++;
+        generated_nodes++;
+        if(!_emit_nodes) return id;
+        {
+            osmium::builder::NodeBuilder builder{*_buffer};
+            builder.object().set_id(id);
+            builder.object().set_version(1);
+            builder.object().set_location(osmium::Location{lon, lat});
+        }
+        _buffer->commit();
+        flush(false);
+        return id;
+    }
+
+    // Adds a way with the given highway class. A null class creates a building instead.
+    void add_way(const std::vector<osmium::object_id_type>& refs, const char* highway) {
+        osmium::object_id_type id = _next_way_id++;
+        generated_ways++;
+        if(highway) generated_highways++;
+        if(_emit_nodes) return;
+        {
+            osmium::builder::WayBuilder builder{*_buffer};
+            builder.object().set_id(id);
+            builder.object().set_version(1);
+            {
+                osmium::builder::WayNodeListBuilder wnl_builder{builder};
+                for(auto ref : refs) {
+                    wnl_builder.add_node_ref(osmium::NodeRef{ref});
+                }
+            }
+            {
+                osmium::builder::TagListBuilder tl_builder{builder};
+                if(highway) {
+                    tl_builder.add_tag("highway", highway);
+                } else {
+                    tl_builder.add_tag("building", "yes");
+                }
+            }
+        }
+        _buffer->commit();
+        flush(false);
+    }
+
+    // Hand the buffer to the writer once it is full (or always if force is set)
+    void flush(bool force) {
+        if(force || _buffer->committed() > buffer_size - 64 * 1024) {
+            (*_writer)(std::move(*_buffer));
+            delete _buffer;
+            _buffer = new osmium::memory::Buffer(buffer_size, osmium::memory::Buffer::auto_grow::yes);
+        }
+    }
+
+};
+
+#endif
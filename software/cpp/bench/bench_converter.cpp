@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <benchmark/benchmark.h>
+#include <osmium/visitor.hpp>
+#include <osmium/io/any_input.hpp>
+#include <osmium/index/map/flex_mem.hpp>
+#include <osmium/handler/node_locations_for_ways.hpp>
+
+#include <BoundingBox.hpp>
+#include <Tile.hpp>
+#include <CustomHandlers.hpp>
+#include <TileWriter.hpp>
+#include <SyntheticOsm.hpp>
+
+using index_type = osmium::index::map::FlexMem<osmium::unsigned_object_id_type, osmium::Location>;
+using location_handler_type = osmium::handler::NodeLocationsForWays<index_type>;
+
+/*
+
+    Benchmarks for the handlers in CustomHandlers.hpp and the tile write loop.
+
+    Each benchmark runs on a synthetic map with state.range(0) nodes. The maps are generated once
+    into BENCH_DATA_DIR (defaults to /tmp) and reused by later runs.
+
+*/
+
+// Synthetic map and the intermediate results of all passes, as main.cpp computes them.
+struct SyntheticMap {
+    std::string path;
+    uint64_t n_nodes;
+    int tile_size = 512;
+
+    int n_x_tiles, n_y_tiles, n_tiles, n_collisions, map_x, map_y, max_way_node_count, all_way_node_count;
+    uint64_t highways;
+
+    WayBox* wBoxes = nullptr;
+    uint16_t* nodes_per_tile = nullptr;
+    int32_t* node_x_coords = nullptr;
+    int32_t* node_y_coords = nullptr;
+    uint64_t* highway_indices = nullptr;
+    uint64_t* ptr_per_tile = nullptr;
+    uint64_t byte_tiles = 0;
+};
+
+static std::string data_dir() {
+    const char* dir = std::getenv("BENCH_DATA_DIR");
+    return dir ? dir : "/tmp";
+}
+
+template <typename THandler>
+static void apply_pass(const std::string& path, THandler& handler) {
+    index_type index;
+    location_handler_type location_handler{index};
+    osmium::io::Reader reader{path, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way};
+    osmium::apply(reader, location_handler, handler);
+    reader.close();
+}
+
+// Generate the map for n_nodes (if it does not exist yet) and run all passes once
+static SyntheticMap& get_map(uint64_t n_nodes) {
+    static std::map<uint64_t, std::unique_ptr<SyntheticMap>> maps;
+    auto it = maps.find(n_nodes);
+    if(it != maps.end()) return *it->second;
+
+    auto m = std::make_unique<SyntheticMap>();
+    m->n_nodes = n_nodes;
+    m->path = data_dir() + "/synthetic_" + std::to_string(n_nodes) + ".osm.pbf";
+    if(!std::ifstream(m->path).good()) {
+        std::cerr << "Generating " << m->path << "\n";
+        SyntheticOsmGenerator generator(n_nodes);
+        generator.write(m->path);
+    }
+
+    StatHandler stats;
+    apply_pass(m->path, stats);
+    m->n_x_tiles = ceil((double) (stats.max_x - stats.min_x) / m->tile_size);
+    m->n_y_tiles = ceil((double) (stats.max_y - stats.min_y) / m->tile_size);
+    m->n_tiles = m->n_x_tiles * m->n_y_tiles;
+    m->map_x = stats.min_x;
+    m->map_y = stats.min_y;
+    m->highways = stats.highways;
+    m->max_way_node_count = stats.max_way_node_count;
+    m->all_way_node_count = stats.all_way_node_count;
+
+    m->wBoxes = new WayBox[m->highways];
+    BoxHandler bHandler(m->wBoxes, m->tile_size, m->n_x_tiles, m->map_x, m->map_y);
+    apply_pass(m->path, bHandler);
+    m->n_collisions = bHandler.n_collisions;
+
+    m->nodes_per_tile = new uint16_t[m->n_tiles] {0};
+    TileAssigner tHandler(m->n_collisions, m->tile_size, m->n_x_tiles, m->map_x, m->map_y,
+        m->max_way_node_count, m->wBoxes, m->nodes_per_tile);
+    apply_pass(m->path, tHandler);
+
+    m->node_x_coords = new int32_t[m->all_way_node_count];
+    m->node_y_coords = new int32_t[m->all_way_node_count];
+    m->highway_indices = new uint64_t[m->highways];
+    MercatorConverter mercConv(m->node_x_coords, m->node_y_coords, m->highway_indices);
+    apply_pass(m->path, mercConv);
+
+    m->ptr_per_tile = new uint64_t[m->n_tiles];
+    for(int i=0; i<m->n_tiles; i++) {
+        m->ptr_per_tile[i] = m->byte_tiles;
+        m->byte_tiles += 2*sizeof(uint16_t)*m->nodes_per_tile[i];
+    }
+
+    return *(maps[n_nodes] = std::move(m));
+}
+
+static void set_counters(benchmark::State& state, SyntheticMap& m) {
+    state.SetItemsProcessed(state.iterations() * m.n_nodes);
+    state.counters["highways"] = m.highways;
+    state.counters["tiles"] = m.n_tiles;
+}
+
+static void BM_StatHandler(benchmark::State& state) {
+    SyntheticMap& m = get_map(state.range(0));
+    for(auto _ : state) {
+        StatHandler stats;
+        apply_pass(m.path, stats);
+        benchmark::DoNotOptimize(stats.highways);
+    }
+    set_counters(state, m);
+}
+
+static void BM_BoxHandler(benchmark::State& state) {
+    SyntheticMap& m = get_map(state.range(0));
+    WayBox* wBoxes = new WayBox[m.highways];
+    for(auto _ : state) {
+        BoxHandler bHandler(wBoxes, m.tile_size, m.n_x_tiles, m.map_x, m.map_y);
+        apply_pass(m.path, bHandler);
+        benchmark::DoNotOptimize(bHandler.n_collisions);
+    }
+    delete[] wBoxes;
+    set_counters(state, m);
+}
+
+static void BM_TileAssigner(benchmark::State& state) {
+    SyntheticMap& m = get_map(state.range(0));
+    uint16_t* nodes_per_tile = new uint16_t[m.n_tiles];
+    for(auto _ : state) {
+        std::fill(nodes_per_tile, nodes_per_tile + m.n_tiles, 0);
+        TileAssigner tHandler(m.n_collisions, m.tile_size, m.n_x_tiles, m.map_x, m.map_y,
+            m.max_way_node_count, m.wBoxes, nodes_per_tile);
+        apply_pass(m.path, tHandler);
+        benchmark::DoNotOptimize(tHandler.total_number_of_tile_nodes);
+    }
+    delete[] nodes_per_tile;
+    set_counters(state, m);
+}
+
+static void BM_MercatorConverter(benchmark::State& state) {
+    SyntheticMap& m = get_map(state.range(0));
+    int32_t* node_x_coords = new int32_t[m.all_way_node_count];
+    int32_t* node_y_coords = new int32_t[m.all_way_node_count];
+    uint64_t* highway_indices = new uint64_t[m.highways];
+    for(auto _ : state) {
+        MercatorConverter mercConv(node_x_coords, node_y_coords, highway_indices);
+        apply_pass(m.path, mercConv);
+        benchmark::DoNotOptimize(node_x_coords);
+    }
+    delete[] node_x_coords;
+    delete[] node_y_coords;
+    delete[] highway_indices;
+    set_counters(state, m);
+}
+
+// Only the write loop. No OSM parsing involved.
+static void BM_WriteTiles(benchmark::State& state) {
+    SyntheticMap& m = get_map(state.range(0));
+    int16_t* buffer_tiles = (int16_t*) calloc(m.byte_tiles, sizeof(char));
+    for(auto _ : state) {
+        write_tiles(buffer_tiles, m.ptr_per_tile, m.wBoxes, m.highways,
+            m.node_x_coords, m.node_y_coords, m.highway_indices, m.all_way_node_count,
+            m.tile_size, m.n_x_tiles, m.map_x, m.map_y, m.n_tiles);
+        benchmark::ClobberMemory();
+    }
+    free(buffer_tiles);
+    set_counters(state, m);
+    state.SetBytesProcessed(state.iterations() * m.byte_tiles);
+}
+
+BENCHMARK(BM_StatHandler)->RangeMultiplier(10)->Range(100000, 1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BoxHandler)->RangeMultiplier(10)->Range(100000, 1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TileAssigner)->RangeMultiplier(10)->Range(100000, 1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_MercatorConverter)->RangeMultiplier(10)->Range(100000, 1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_WriteTiles)->RangeMultiplier(10)->Range(100000, 1000000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
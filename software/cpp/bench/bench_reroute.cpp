@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <GeometryStore.hpp>
+#include <MapFile.hpp>
+#include <RoutingGraph.hpp>
+#include <StoreConversion.hpp>
+
+// Router and memory limits of the device
+#include <globalconfig.h>
+#include <routing.h>
+
+/*
+
+    Reroute latency benchmark. Runs the router of the device (routing.h) on the host.
+
+    Without arguments, a synthetic road network of 30 x 30 km is generated: a lattice of streets with a junction
+    every ~150m, curved streets between the junctions, main roads every 10th row and column, some one way streets
+    and ~10% missing blocks. The map and routing graph are written into BENCH_DATA_DIR (defaults to /tmp).
+    Alternatively an existing map and graph are given as arguments.
+
+    Routes between random points 5 to 20 km apart are computed with the memory limits of globalconfig.h
+    for several weights of the heuristic. Latency, expanded nodes, partition loads and bytes read are reported.
+    The bytes read are the best estimate for the device, where reading partitions from SD dominates.
+
+*/
+
+using clock_type = std::chrono::steady_clock;
+
+static std::string data_dir() {
+    const char* dir = std::getenv("BENCH_DATA_DIR");
+    return dir ? dir : "/tmp";
+}
+
+// Splitmix64, same as the synthetic OSM generator
+static uint64_t rng_state = 7;
+static uint64_t next_random() {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+static double uniform() {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+    Synthetic lattice network written directly into a geometry store
+*/
+static void synthetic_network(GeometryStore& store, std::vector<uint8_t>& classes, double extent_m) {
+    const double lat = 48.0;
+    const double scale = 1.0 / std::cos(lat * M_PI / 180.0);
+    const double spacing = 150.0 * scale;
+    const int n = extent_m * scale / spacing;
+    const int n_shape = 3;
+    const double x0 = 11.5 * M_PI / 180.0 * 6378137.0;
+    const double y0 = std::log(std::tan(M_PI/4 + lat * M_PI / 360.0)) * 6378137.0;
+
+    struct Block {
+        int r0, c0, r1, c1;
+        uint8_t cls;
+    };
+    std::vector<Block> blocks;
+    for(int r=0; r<n; r++) {
+        for(int c=0; c<n; c++) {
+            for(int dir=0; dir<2; dir++) {
+                int r1 = r + dir, c1 = c + 1 - dir;
+                if(r1 >= n || c1 >= n) continue;
+                bool main_road = dir == 0 ? r % 10 == 0 : c % 10 == 0;
+                if(!main_road && uniform() < 0.1) continue;
+                uint8_t cls = main_road ? ROAD_SECONDARY : ROAD_RESIDENTIAL;
+                if(!main_road && uniform() < 0.05) cls |= ROAD_ONEWAY_FORWARD;
+                blocks.push_back({r, c, r1, c1, cls});
+            }
+        }
+    }
+
+    store.allocate(blocks.size(), blocks.size()*(n_shape + 2), true);
+    uint64_t coord = 0;
+    for(uint64_t b=0; b<blocks.size(); b++) {
+        const Block& block = blocks[b];
+        store.way_ids[b] = b + 1;
+        store.highway_indices[b] = coord;
+        classes.push_back(block.cls);
+        for(int k=0; k<=n_shape+1; k++) {
+            double t = (double) k / (n_shape + 1);
+            double bend = std::sin(t * M_PI) * 0.15 * spacing;
+            double x = x0 + ((1 - t)*block.c0 + t*block.c1) * spacing + (block.r0 != block.r1 ? bend : 0);
+            double y = y0 + ((1 - t)*block.r0 + t*block.r1) * spacing + (block.c0 != block.c1 ? bend : 0);
+            store.node_x_coords[coord] = (int32_t) x;
+            store.node_y_coords[coord] = (int32_t) y;
+            if(k == 0) store.node_ids[coord] = (int64_t) block.r0*n + block.c0 + 1;
+            else if(k == n_shape + 1) store.node_ids[coord] = (int64_t) block.r1*n + block.c1 + 1;
+            else store.node_ids[coord] = (int64_t) n*n + b*n_shape + k;
+            coord++;
+        }
+    }
+    store.map_x = (int64_t) (x0 - spacing);
+    store.map_y = (int64_t) (y0 - spacing);
+    store.map_width = (uint64_t) ((n + 1) * spacing);
+    store.map_height = (uint64_t) ((n + 1) * spacing);
+    store.n_ways = blocks.size();
+}
+
+class FilePartitionSource : public Routing::PartitionSource {
+public:
+    int fd = -1;
+    bool read(uint32_t offset, void* buffer, uint32_t size) {
+        return pread(fd, buffer, size, offset) == (ssize_t) size;
+    }
+};
+
+static double percentile(std::vector<double> values, double p) {
+    if(values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min<size_t>(values.size() - 1, p * values.size())];
+}
+
+int main(int argc, char *argv[]) {
+    std::string map_path, graph_path;
+    if(argc == 3) {
+        map_path = argv[1];
+        graph_path = argv[2];
+    } else {
+        map_path = data_dir() + "/reroute_bench.bin";
+        graph_path = data_dir() + "/reroute_bench.graph";
+        GeometryStore store;
+        std::vector<uint8_t> classes;
+        synthetic_network(store, classes, 30000);
+        if(!write_map(store, 512, map_path.c_str()) || !write_routing_graph(store, classes, map_path.c_str(), graph_path.c_str())) {
+            return 1;
+        }
+    }
+
+    MapFile map;
+    if(!map.open(map_path.c_str())) return 1;
+    FilePartitionSource source;
+    source.fd = ::open(graph_path.c_str(), O_RDONLY);
+    if(source.fd < 0) {
+        std::cout << "Error: Could not open " << graph_path << "\n";
+        return 1;
+    }
+
+    Routing::Router router;
+    if(!router.initialize(&source, crc32(&map.header, sizeof(MapHeader)), ROUTE_CACHE_SLOTS, ROUTE_MAX_NODES)) {
+        std::cout << "Error: Routing graph does not match map\n";
+        return 1;
+    }
+    std::cout << "Router memory: \t\t\t" << ROUTE_MAX_NODES << " nodes, " << ROUTE_CACHE_SLOTS << " x "
+        << router.header.maxPartitionBytes << " bytes partition cache\n";
+
+    // Random pairs of points 5 to 20 km apart within the map
+    const int n_routes = 200;
+    double meters_per_unit = 1.0 / std::cosh((map.header.map_y + map.header.map_height/2) / 6378137.0);
+    std::vector<int32_t> pairs;
+    while(pairs.size() < 4*n_routes) {
+        double sx = map.header.map_x + uniform() * map.header.map_width;
+        double sy = map.header.map_y + uniform() * map.header.map_height;
+        double distance = (5000 + uniform() * 15000) / meters_per_unit;
+        double angle = uniform() * 2 * M_PI;
+        double gx = sx + distance * std::cos(angle);
+        double gy = sy + distance * std::sin(angle);
+        if(gx < map.header.map_x || gy < map.header.map_y || gx > map.header.map_x + (double) map.header.map_width
+            || gy > map.header.map_y + (double) map.header.map_height) continue;
+        pairs.insert(pairs.end(), {(int32_t) sx, (int32_t) sy, (int32_t) gx, (int32_t) gy});
+    }
+
+    std::vector<int32_t> path_x(ROUTE_MAX_POINTS*16), path_y(ROUTE_MAX_POINTS*16);
+    printf("%8s %8s %10s %10s %10s %10s %12s %12s\n", "weight", "found", "p50 [ms]", "p95 [ms]", "max [ms]",
+        "expanded", "partitions", "read [KB]");
+    for(float weight : {1.0f, 1.5f, 2.0f, 3.0f}) {
+        router.heuristicWeight = weight;
+        std::vector<double> latency;
+        uint64_t found = 0, expanded = 0, loads = 0, bytes = 0;
+        for(int i=0; i<n_routes; i++) {
+            auto t_start = clock_type::now();
+            uint32_t n = router.route(pairs[4*i], pairs[4*i+1], pairs[4*i+2], pairs[4*i+3], path_x.data(), path_y.data(), path_x.size());
+            latency.push_back(std::chrono::duration<double, std::milli>(clock_type::now() - t_start).count());
+            found += n > 0;
+            expanded += router.stats.expanded;
+            loads += router.stats.partitionLoads;
+            bytes += router.stats.bytesRead;
+        }
+        printf("%8.1f %7.0f%% %10.3f %10.3f %10.3f %10.0f %12.1f %12.1f\n", weight, 100.0 * found / n_routes,
+            percentile(latency, 0.5), percentile(latency, 0.95), percentile(latency, 1.0),
+            (double) expanded / n_routes, (double) loads / n_routes, bytes / 1024.0 / n_routes);
+    }
+    ::close(source.fd);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include <iostream>
+#include <string>
+
+#include <SyntheticOsm.hpp>
+
+/*
+
+    Commandline tool to write a synthetic OSM file with a given number of nodes.
+
+*/
+int main(int argc, char *argv[]) {
+
+    if (argc != 3 && argc != 4) {
+        std::cout << "Usage: osm-synth N_NODES PATH_TO_OUTPUT_FILE [SEED]\n";
+        return 1;
+    }
+
+    uint64_t n_nodes = std::stoull(argv[1]);
+    uint64_t seed = argc == 4 ? std::stoull(argv[3]) : 42;
+
+    SyntheticOsmGenerator generator(n_nodes, seed);
+    generator.write(argv[2]);
+
+    std::cout << "Nodes: \t\t\t\t" << generator.generated_nodes << "\n";
+    std::cout << "Ways: \t\t\t\t" << generator.generated_ways << "\n";
+    std::cout << "Highways: \t\t\t" << generator.generated_highways << "\n";
+    std::cout << "Synthetic map created successfully at: " << argv[2] << "\n";
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <SyntheticOsm.hpp>
+
+/*
+
+    Scaling driver for osm2simpletile.
+
+    Generates synthetic maps from 10^5 up to 10^8 nodes, runs the converter as a child process on each of them
+    and prints the wall time, throughput and peak memory of the conversion together with the duration of every
+    conversion stage (taken from the stage banners the converter prints).
+
+*/
+
+using clock_type = std::chrono::steady_clock;
+
+struct RunResult {
+    bool ok = false;
+    double wall_s = 0;
+    long peak_rss_kb = 0;
+    std::vector<std::pair<std::string, double>> stages;
+};
+
+static double seconds_since(clock_type::time_point t) {
+    return std::chrono::duration<double>(clock_type::now() - t).count();
+}
+
+static uint64_t file_size(const std::string& path) {
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) return 0;
+    return st.st_size;
+}
+
+// Run the converter and collect timing and memory statistics of the child process
+static RunResult run_converter(const std::string& converter, const std::string& input, const std::string& output) {
+    RunResult result;
+    int pipefd[2];
+    if(pipe(pipefd) != 0) return result;
+
+    auto t_start = clock_type::now();
+    pid_t pid = fork();
+    if(pid == 0) {
+        dup2(pipefd[1], STDOUT_FILENO);
+        close(pipefd[0]);
+        close(pipefd[1]);
+        execl(converter.c_str(), converter.c_str(), input.c_str(), output.c_str(), (char*) nullptr);
+        _exit(127);
+    }
+    close(pipefd[1]);
+
+    // Stage banners look like "---- 1/6 Gathering map statistics ----"
+    FILE* out = fdopen(pipefd[0], "r");
+    char line[512];
+    std::string curr_stage;
+    auto t_stage = t_start;
+    while(fgets(line, sizeof(line), out)) {
+        if(strncmp(line, "-----", 5) != 0) continue;
+        std::string name(line);
+        size_t first = name.find_first_not_of("- ");
+        size_t last = name.find_last_not_of("- \n");
+        if(first == std::string::npos) continue;
+        name = name.substr(first, last - first + 1);
+        if(!curr_stage.empty()) {
+            result.stages.push_back({curr_stage, std::chrono::duration<double>(clock_type::now() - t_stage).count()});
+        }
+        curr_stage = name;
+        t_stage = clock_type::now();
+    }
+    fclose(out);
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    result.wall_s = seconds_since(t_start);
+    if(!curr_stage.empty()) {
+        result.stages.push_back({curr_stage, std::chrono::duration<double>(clock_type::now() - t_stage).count()});
+    }
+    // ru_maxrss is given in kilobytes on linux
+    result.peak_rss_kb = usage.ru_maxrss;
+    result.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+
+    if (argc < 3 || argc > 4) {
+        std::cout << "Usage: osm2simpletile-scaling PATH_TO_CONVERTER WORK_DIR [MAX_NODES]\n";
+        return 1;
+    }
+
+    std::string converter = argv[1];
+    std::string work_dir = argv[2];
+    uint64_t max_nodes = argc == 4 ? std::stoull(argv[3]) : 100000000ULL;
+
+    std::vector<RunResult> results;
+    std::vector<uint64_t> sizes;
+    for(uint64_t n_nodes = 100000; n_nodes <= max_nodes; n_nodes *= 10) {
+        std::string input = work_dir + "/synthetic_" + std::to_string(n_nodes) + ".osm.pbf";
+        std::string output = work_dir + "/synthetic_" + std::to_string(n_nodes) + ".bin";
+
+        if(!std::ifstream(input).good()) {
+            std::cout << "Generating " << input << "\n";
+            auto t_gen = clock_type::now();
+            SyntheticOsmGenerator generator(n_nodes);
+            generator.write(input);
+            std::cout << "Generated " << generator.generated_nodes << " nodes in " << seconds_since(t_gen) << "s\n";
+        }
+
+        std::cout << "Converting " << input << "\n";
+        RunResult result = run_converter(converter, input, output);
+        if(!result.ok) {
+            std::cout << "Conversion failed for " << n_nodes << " nodes. Stopping.\n";
+            break;
+        }
+        for(auto& stage : result.stages) {
+            printf("    %-45s %10.2fs\n", stage.first.c_str(), stage.second);
+        }
+        sizes.push_back(n_nodes);
+        results.push_back(result);
+    }
+
+    // Throughput and memory curve
+    printf("\n%12s %12s %12s %14s %14s %12s\n", "nodes", "pbf [MB]", "wall [s]", "knodes/s", "peak RSS [MB]", "map [MB]");
+    for(size_t i=0; i<results.size(); i++) {
+        std::string input = work_dir + "/synthetic_" + std::to_string(sizes[i]) + ".osm.pbf";
+        std::string output = work_dir + "/synthetic_" + std::to_string(sizes[i]) + ".bin";
+        printf("%12llu %12.1f %12.2f %14.1f %14.1f %12.1f\n",
+            (unsigned long long) sizes[i],
+            file_size(input) / 1e6,
+            results[i].wall_s,
+            sizes[i] / results[i].wall_s / 1e3,
+            results[i].peak_rss_kb / 1024.0,
+            file_size(output) / 1e6);
+    }
+
+    return 0;
+}
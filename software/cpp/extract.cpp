@@ -0,0 +1,38 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include <MapExtract.hpp>
+
+/*
+
+    Commandline tool to cut a region out of an existing map.
+
+*/
+int main(int argc, char *argv[]) {
+
+    if (argc != 5 || (std::string(argv[3]) != "--bbox" && std::string(argv[3]) != "--poly")) {
+        std::cout << "Usage: simpletile-extract PATH_TO_INPUT_MAP PATH_TO_OUTPUT_MAP --bbox MIN_LON,MIN_LAT,MAX_LON,MAX_LAT\n";
+        std::cout << "       simpletile-extract PATH_TO_INPUT_MAP PATH_TO_OUTPUT_MAP --poly PATH_TO_POLY_FILE\n";
+        return 1;
+    }
+
+    Region region;
+    if(std::string(argv[3]) == "--bbox") {
+        double min_lon, min_lat, max_lon, max_lat;
+        if(sscanf(argv[4], "%lf,%lf,%lf,%lf", &min_lon, &min_lat, &max_lon, &max_lat) != 4 || min_lon >= max_lon || min_lat >= max_lat) {
+            std::cout << "Error: Invalid bounding box " << argv[4] << "\n";
+            return 1;
+        }
+        region = Region::from_bbox(min_lon, min_lat, max_lon, max_lat);
+    } else if(!region.read_poly(argv[4])) {
+        return 1;
+    }
+
+    if(!extract_map(argv[1], argv[2], region)) {
+        return 1;
+    }
+    std::cout << "Map extracted successfully at: " << argv[2] << "\n";
+
+    return 0;
+}
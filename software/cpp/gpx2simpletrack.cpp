@@ -0,0 +1,40 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <Gpx.hpp>
+#include <MapFile.hpp>
+#include <SimpleTrack.hpp>
+
+/*
+
+    Commandline tool to compile a GPX file into a binary track for a map.
+
+*/
+int main(int argc, char *argv[]) {
+
+    if (argc != 4 && argc != 5) {
+        std::cout << "Usage: gpx2simpletrack PATH_TO_MAP PATH_TO_GPX_FILE PATH_TO_OUTPUT_FILE [TOLERANCE_METERS]\n";
+        return 1;
+    }
+
+    // Maximum deviation of the simplified track in meters
+    double tolerance = argc == 5 ? atof(argv[4]) : 2.0;
+
+    MapFile map;
+    if(!map.open(argv[1])) {
+        return 1;
+    }
+
+    std::vector<TrackPoint> points;
+    if(!read_gpx(argv[2], points)) {
+        return 1;
+    }
+
+    if(!compile_track(map, points, tolerance, argv[3])) {
+        return 1;
+    }
+    std::cout << "Track created successfully at: " << argv[3] << "\n";
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#ifndef BATCH_CONVERSION_H
+#define BATCH_CONVERSION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GeometryStore.hpp>
+#include <StoreConversion.hpp>
+
+
+/*
+
+    Merges several geometry stores into one. Regional extracts overlap at their borders, so ways are
+    deduplicated by their OSM ID. If a way is contained in several stores, the version with the most nodes
+    is kept, since extracts may cut ways at the border. Highways keep the order of the input stores.
+
+*/
+inline bool merge_stores(const std::vector<GeometryStore*>& stores, GeometryStore& merged) {
+    // Store and highway index of the version of each way that is kept
+    std::unordered_map<int64_t, std::pair<size_t, uint64_t>> kept;
+    int64_t min_x = INT64_MAX, min_y = INT64_MAX, max_x = INT64_MIN, max_y = INT64_MIN;
+    uint64_t n_ways = 0;
+    for(size_t s=0; s<stores.size(); s++) {
+        GeometryStore& store = *stores[s];
+        if(!store.way_ids) {
+            std::cout << "Error: Merging requires geometry stores with OSM IDs\n";
+            return false;
+        }
+        min_x = std::min(min_x, store.map_x);
+        min_y = std::min(min_y, store.map_y);
+        max_x = std::max<int64_t>(max_x, store.map_x + store.map_width);
+        max_y = std::max<int64_t>(max_y, store.map_y + store.map_height);
+        n_ways += store.n_ways;
+        for(uint64_t hw_id=0; hw_id<store.n_highways; hw_id++) {
+            auto result = kept.insert({store.way_ids[hw_id], {s, hw_id}});
+            if(result.second) continue;
+            // Duplicate way, keep the longer version
+            n_ways--;
+            GeometryStore& other = *stores[result.first->second.first];
+            uint64_t other_id = result.first->second.second;
+            if(store.way_end(hw_id) - store.way_begin(hw_id) > other.way_end(other_id) - other.way_begin(other_id)) {
+                result.first->second = {s, hw_id};
+            }
+        }
+    }
+
+    uint64_t n_highways = 0;
+    uint64_t n_coords = 0;
+    for(auto& way : kept) {
+        GeometryStore& store = *stores[way.second.first];
+        n_highways++;
+        n_coords += store.way_end(way.second.second) - store.way_begin(way.second.second);
+    }
+    if(!merged.allocate(n_highways, n_coords)) return false;
+    merged.map_x = min_x;
+    merged.map_y = min_y;
+    merged.map_width = max_x - min_x;
+    merged.map_height = max_y - min_y;
+    merged.n_ways = n_ways;
+
+    uint64_t hw_ptr = 0;
+    uint64_t coord_ptr = 0;
+    for(size_t s=0; s<stores.size(); s++) {
+        GeometryStore& store = *stores[s];
+        for(uint64_t hw_id=0; hw_id<store.n_highways; hw_id++) {
+            auto& way = kept[store.way_ids[hw_id]];
+            if(way.first != s || way.second != hw_id) continue;
+            merged.way_ids[hw_ptr] = store.way_ids[hw_id];
+            merged.highway_indices[hw_ptr] = coord_ptr;
+            for(uint64_t j=store.way_begin(hw_id); j<store.way_end(hw_id); j++) {
+                merged.node_ids[coord_ptr] = store.node_ids[j];
+                merged.node_x_coords[coord_ptr] = store.node_x_coords[j];
+                merged.node_y_coords[coord_ptr] = store.node_y_coords[j];
+                coord_ptr++;
+            }
+            hw_ptr++;
+        }
+    }
+    return true;
+}
+
+
+/*
+
+    Output path of an input file in batch mode: OUTPUT_DIR/NAME.bin, where NAME is the file name of the
+    input without its OSM extensions.
+
+*/
+inline std::string batch_output_path(const std::string& output_dir, const std::string& input_path) {
+    std::string name = input_path.substr(input_path.find_last_of('/') + 1);
+    for(const char* ext : {".pbf", ".bz2", ".gz", ".osm", ".o5m"}) {
+        std::string e(ext);
+        if(name.size() > e.size() && name.compare(name.size() - e.size(), e.size(), e) == 0) {
+            name.erase(name.size() - e.size());
+        }
+    }
+    return output_dir + "/" + name + ".bin";
+}
+
+
+/*
+
+    Converts several OSM files at once. Inputs are distributed over all cores with OpenMP, while the
+    decoding of PBF blocks runs in the thread pool that osmium shares between all readers.
+
+    If merge_path is set, the geometry of all inputs is merged and written into a single map.
+    Otherwise each input is written to its own map in output_dir.
+
+*/
+inline bool batch_convert(const std::vector<std::string>& inputs, const char* output_dir, const char* merge_path, int tile_size) {
+    using clock_type = std::chrono::steady_clock;
+    auto t_start = clock_type::now();
+
+    std::vector<GeometryStore*> stores(inputs.size(), nullptr);
+    std::vector<double> durations(inputs.size(), 0);
+    // One byte per input, vector<bool> would share words between the threads
+    std::vector<char> success(inputs.size(), false);
+    bool keep_stores = merge_path != nullptr;
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(size_t i=0; i<inputs.size(); i++) {
+        auto t_input = clock_type::now();
+        GeometryStore* store = new GeometryStore();
+        bool ok = false;
+        try {
+            ok = read_geometry(inputs[i].c_str(), *store, keep_stores);
+            if(ok && !keep_stores) {
+                ok = write_map(*store, tile_size, batch_output_path(output_dir, inputs[i]).c_str());
+            }
+        } catch(const std::exception& e) {
+            #pragma omp critical
+            std::cout << "Error: Conversion of " << inputs[i] << " failed: " << e.what() << "\n";
+        }
+        if(keep_stores) {
+            stores[i] = store;
+        } else {
+            delete store;
+        }
+        durations[i] = std::chrono::duration<double>(clock_type::now() - t_input).count();
+        success[i] = ok;
+
+        #pragma omp critical
+        std::cout << (ok ? "Converted " : "Failed ") << inputs[i] << " in " << durations[i] << "s\n";
+    }
+
+    bool all_success = std::all_of(success.begin(), success.end(), [](char b) { return b != 0; });
+    if(merge_path && all_success) {
+        std::cout << "------------------------------- Merging inputs ---------------------------------\n";
+        GeometryStore merged;
+        all_success = merge_stores(stores, merged) && write_map(merged, tile_size, merge_path);
+        if(all_success) {
+            std::cout << "Highways: \t\t\t" << merged.n_highways << "\n";
+            std::cout << "Map created successfully at: " << merge_path << "\n";
+        }
+    }
+    for(GeometryStore* store : stores) delete store;
+
+    double wall = std::chrono::duration<double>(clock_type::now() - t_start).count();
+    double work = 0;
+    for(double d : durations) work += d;
+    std::cout << "Inputs: \t\t\t" << inputs.size() << "\n";
+    std::cout << "Sum of input times: \t\t" << work << "s\n";
+    std::cout << "Wall time: \t\t\t" << wall << "s\n";
+    return all_success;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef CONVERSION_CACHE_H
+#define CONVERSION_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <GeometryStore.hpp>
+#include <StoreConversion.hpp>
+
+// Identifies the way filter and projection of the handlers in CustomHandlers.hpp.
+// Has to be changed whenever different geometry is selected or projected, so old cache entries are not used anymore.
+#define FILTER_PROFILE "highway=*;mercator-int32;v1"
+
+
+/*
+
+    64-bit hash of the content of a file. The file is memory mapped and hashed in chunks of 16MB in parallel,
+    the chunk hashes are then combined in order. Not cryptographic, only meant to detect changed inputs.
+
+*/
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+inline bool hash_file(const char* path, uint64_t& hash) {
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0) {
+        std::cout << "Error: Could not open " << path << "\n";
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    uint64_t size = st.st_size;
+    const char* data = size ? (const char*) mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : nullptr;
+    ::close(fd);
+    if(data == MAP_FAILED) {
+        std::cout << "Error: Could not map " << path << " into memory\n";
+        return false;
+    }
+    if(size) madvise((void*) data, size, MADV_SEQUENTIAL);
+
+    const uint64_t chunk_size = 16*1024*1024;
+    int64_t n_chunks = (size + chunk_size - 1) / chunk_size;
+    uint64_t* chunk_hashes = new uint64_t[n_chunks ? n_chunks : 1];
+
+    #pragma omp parallel for schedule(static)
+    for(int64_t c=0; c<n_chunks; c++) {
+        uint64_t begin = c*chunk_size;
+        uint64_t end = std::min(begin + chunk_size, size);
+        uint64_t h = mix64(c + 1);
+        uint64_t i = begin;
+        for(; i + 8 <= end; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            h = mix64(h ^ word) + i;
+        }
+        // Remaining bytes of the last chunk
+        uint64_t word = 0;
+        memcpy(&word, data + i, end - i);
+        chunk_hashes[c] = mix64(h ^ word ^ (end - i));
+    }
+
+    hash = mix64(size);
+    for(int64_t c=0; c<n_chunks; c++) {
+        hash = mix64(hash ^ chunk_hashes[c]);
+    }
+    delete[] chunk_hashes;
+    if(size) munmap((void*) data, size);
+    return true;
+}
+
+
+/*
+
+    Reads the geometry of an input file through a cache in cache_dir. Cache entries are geometry stores named
+    after the hash of the input content and the filter profile. On a cache hit the store is memory mapped and
+    the input is not parsed at all. On a miss the input is parsed and the store is saved for the next run.
+
+*/
+inline bool read_geometry_cached(const char* input_path, const char* cache_dir, GeometryStore& store) {
+    uint64_t hash;
+    if(!hash_file(input_path, hash)) return false;
+    const char* profile = FILTER_PROFILE;
+    for(size_t i=0; i<strlen(profile); i++) {
+        hash = mix64(hash ^ (uint64_t) profile[i]);
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.store", (unsigned long long) hash);
+    std::string path = std::string(cache_dir) + "/" + name;
+
+    struct stat st;
+    if(stat(path.c_str(), &st) == 0) {
+        if(store.map(path.c_str())) {
+            std::cout << "Cache hit: \t\t\t" << path << "\n";
+            return true;
+        }
+        std::cout << "Warning: Ignoring invalid cache entry " << path << "\n";
+    }
+
+    std::cout << "Cache miss: \t\t\t" << path << "\n";
+    if(!read_geometry(input_path, store, true)) return false;
+    // Write into a temporary file first, so an interrupted run does not leave a broken entry
+    std::string tmp_path = path + ".tmp";
+    if(!store.save(tmp_path.c_str()) || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cout << "Warning: Could not write cache entry " << path << "\n";
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef CORRIDOR_H
+#define CORRIDOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <GeometryStore.hpp>
+#include <Gpx.hpp>
+#include <MapFile.hpp>
+#include <Tile.hpp>
+#include <TileWriter.hpp>
+
+
+/*
+
+    Distance between a point and an axis aligned rectangle. Zero if the point is inside.
+
+*/
+inline double point_rect_distance(double x, double y, double x0, double y0, double x1, double y1) {
+    double dx = std::max(std::max(x0 - x, 0.0), x - x1);
+    double dy = std::max(std::max(y0 - y, 0.0), y - y1);
+    return std::sqrt(dx*dx + dy*dy);
+}
+
+inline double point_segment_distance(double x, double y, double ax, double ay, double bx, double by) {
+    double dx = bx - ax;
+    double dy = by - ay;
+    double len2 = dx*dx + dy*dy;
+    double t = len2 > 0 ? std::min(std::max(((x - ax)*dx + (y - ay)*dy) / len2, 0.0), 1.0) : 0.0;
+    double px = ax + t*dx - x;
+    double py = ay + t*dy - y;
+    return std::sqrt(px*px + py*py);
+}
+
+/*
+
+    Distance between a line segment and an axis aligned rectangle. If the segment does not cross the rectangle,
+    the closest points are an end point of the segment or a corner of the rectangle.
+
+*/
+inline double segment_rect_distance(double ax, double ay, double bx, double by, double x0, double y0, double x1, double y1) {
+    // Slab test for an intersection
+    double t0 = 0, t1 = 1;
+    double d[2] = {bx - ax, by - ay};
+    double a[2] = {ax, ay};
+    double lo[2] = {x0, y0};
+    double hi[2] = {x1, y1};
+    bool crosses = true;
+    for(int k=0; k<2 && crosses; k++) {
+        if(d[k] == 0) {
+            crosses = a[k] >= lo[k] && a[k] <= hi[k];
+            continue;
+        }
+        double ta = (lo[k] - a[k]) / d[k];
+        double tb = (hi[k] - a[k]) / d[k];
+        t0 = std::max(t0, std::min(ta, tb));
+        t1 = std::min(t1, std::max(ta, tb));
+        crosses = t0 <= t1;
+    }
+    if(crosses) return 0;
+
+    double dist = std::min(point_rect_distance(ax, ay, x0, y0, x1, y1), point_rect_distance(bx, by, x0, y0, x1, y1));
+    dist = std::min(dist, point_segment_distance(x0, y0, ax, ay, bx, by));
+    dist = std::min(dist, point_segment_distance(x1, y0, ax, ay, bx, by));
+    dist = std::min(dist, point_segment_distance(x0, y1, ax, ay, bx, by));
+    dist = std::min(dist, point_segment_distance(x1, y1, ax, ay, bx, by));
+    return dist;
+}
+
+
+/*
+
+    Tiles of the map grid within a distance of width (in meters) of a track, in the order in which the track
+    reaches them. Mercator distances are scaled by 1/cos(lat), so the width is converted per track segment.
+
+*/
+inline std::vector<uint64_t> corridor_tiles(const std::vector<TrackPoint>& track, double width, const MapHeader& header) {
+    std::vector<uint64_t> route_tiles;
+    std::vector<bool> selected(header.n_tiles, false);
+    double tile_size = header.tile_size;
+
+    for(size_t i=0; i<track.size(); i++) {
+        const TrackPoint& a = track[i];
+        const TrackPoint& b = track[i + 1 < track.size() ? i + 1 : i];
+        double w = width / std::cos(a.lat * M_PI / 180.0);
+        BoundingBox box(std::min(a.x, b.x) - w, std::min(a.y, b.y) - w, std::max(a.x, b.x) + w, std::max(a.y, b.y) + w);
+        TileRange range(box, header);
+
+        // Candidates of this segment, sorted by their position along the segment
+        std::vector<std::pair<double, uint64_t>> candidates;
+        double dx = b.x - a.x;
+        double dy = b.y - a.y;
+        for(int64_t ty=range.y0; ty<=range.y1; ty++) {
+            for(int64_t tx=range.x0; tx<=range.x1; tx++) {
+                uint64_t tile_id = ty*header.n_x_tiles + tx;
+                if(selected[tile_id]) continue;
+                double x0 = header.map_x + tx*tile_size;
+                double y0 = header.map_y + ty*tile_size;
+                if(segment_rect_distance(a.x, a.y, b.x, b.y, x0, y0, x0 + tile_size, y0 + tile_size) > w) continue;
+                double along = (x0 + tile_size/2 - a.x)*dx + (y0 + tile_size/2 - a.y)*dy;
+                candidates.push_back({along, tile_id});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for(auto& candidate : candidates) {
+            selected[candidate.second] = true;
+            route_tiles.push_back(candidate.second);
+        }
+    }
+    return route_tiles;
+}
+
+
+/*
+
+    Writes a sparse map (version 2) that only contains the tiles along a track. The map is rebased to the
+    bounding box of these tiles and the tiles are stored in the order in which the track passes them, so
+    loading the tiles of a ride reads the file mostly sequentially.
+
+*/
+inline bool write_corridor_map(const GeometryStore& store, uint64_t tile_size, const std::vector<TrackPoint>& track,
+    double width, const char* output_path) {
+
+    // Grid of the complete map, same as write_map
+    MapHeader grid;
+    grid.map_x = store.map_x;
+    grid.map_y = store.map_y;
+    grid.map_width = store.map_width;
+    grid.map_height = store.map_height;
+    grid.n_x_tiles = std::max<uint64_t>(ceil((double) store.map_width/tile_size), 1);
+    grid.tile_size = tile_size;
+    grid.n_tiles = grid.n_x_tiles * std::max<uint64_t>(ceil((double) store.map_height/tile_size), 1);
+
+    std::vector<uint64_t> route_tiles = corridor_tiles(track, width, grid);
+    if(route_tiles.empty()) {
+        std::cout << "Error: The track does not overlap with the map\n";
+        return false;
+    }
+
+    // Rebase the map to the bounding box of all tiles along the route
+    int64_t tx0 = INT64_MAX, ty0 = INT64_MAX, tx1 = INT64_MIN, ty1 = INT64_MIN;
+    for(uint64_t tile_id : route_tiles) {
+        tx0 = std::min<int64_t>(tx0, tile_id % grid.n_x_tiles);
+        tx1 = std::max<int64_t>(tx1, tile_id % grid.n_x_tiles);
+        ty0 = std::min<int64_t>(ty0, tile_id / grid.n_x_tiles);
+        ty1 = std::max<int64_t>(ty1, tile_id / grid.n_x_tiles);
+    }
+    MapHeader header = grid;
+    header.map_x = grid.map_x + tx0*tile_size;
+    header.map_y = grid.map_y + ty0*tile_size;
+    header.n_x_tiles = tx1 - tx0 + 1;
+    header.n_tiles = header.n_x_tiles * (ty1 - ty0 + 1);
+    header.map_width = std::min<int64_t>(header.n_x_tiles*tile_size, grid.map_width - tx0*tile_size);
+    header.map_height = std::min<int64_t>((ty1 - ty0 + 1)*tile_size, grid.map_height - ty0*tile_size);
+    header.max_nodes = 0;
+    header.n_nodes = 0;
+    header.n_ways = 0;
+    if(header.n_tiles > UINT32_MAX) {
+        std::cout << "Error: Too many tiles for a sparse map\n";
+        return false;
+    }
+
+    // Payload of every tile along the route, highways in the same order as in a full map
+    std::unordered_map<uint64_t, size_t> route_position;
+    for(size_t i=0; i<route_tiles.size(); i++) route_position[route_tiles[i]] = i;
+    std::vector<std::vector<int16_t>> payloads(route_tiles.size());
+    // The quantization shift of a tile is only known after all highways were visited, so a first pass
+    // measures the extent of the local coordinates of each tile
+    std::vector<int64_t> extents(route_tiles.size(), 0);
+    for(uint64_t hw_id=0; hw_id<store.n_highways; hw_id++) {
+        TileRange range(store.way_box(hw_id), grid);
+        for(int64_t ty=std::max(range.y0, ty0); ty<=std::min(range.y1, ty1); ty++) {
+            for(int64_t tx=std::max(range.x0, tx0); tx<=std::min(range.x1, tx1); tx++) {
+                auto position = route_position.find(ty*grid.n_x_tiles + tx);
+                if(position == route_position.end()) continue;
+                Tile tile(position->first, tile_size, grid.n_x_tiles, grid.map_x, grid.map_y);
+                write_way_on_tile(tile, store.node_x_coords, store.node_y_coords, store.way_begin(hw_id), store.way_end(hw_id),
+                    nullptr, &extents[position->second]);
+            }
+        }
+    }
+    std::vector<uint8_t> route_shifts(route_tiles.size());
+    for(size_t i=0; i<route_tiles.size(); i++) route_shifts[i] = shift_for_extent(extents[i]);
+    for(uint64_t hw_id=0; hw_id<store.n_highways; hw_id++) {
+        TileRange range(store.way_box(hw_id), grid);
+        for(int64_t ty=std::max(range.y0, ty0); ty<=std::min(range.y1, ty1); ty++) {
+            for(int64_t tx=std::max(range.x0, tx0); tx<=std::min(range.x1, tx1); tx++) {
+                auto position = route_position.find(ty*grid.n_x_tiles + tx);
+                if(position == route_position.end()) continue;
+                std::vector<int16_t>& payload = payloads[position->second];
+                Tile tile(position->first, tile_size, grid.n_x_tiles, grid.map_x, grid.map_y);
+                tile.shift = route_shifts[position->second];
+                uint64_t begin = store.way_begin(hw_id);
+                uint64_t end = store.way_end(hw_id);
+                uint64_t n = write_way_on_tile(tile, store.node_x_coords, store.node_y_coords, begin, end, nullptr);
+                uint64_t offset = payload.size();
+                payload.resize(offset + n);
+                write_way_on_tile(tile, store.node_x_coords, store.node_y_coords, begin, end, payload.data() + offset);
+            }
+        }
+    }
+
+    // Entries sorted by the new tile ID, tile data in route order
+    std::vector<std::pair<uint32_t, size_t>> order;
+    std::vector<uint64_t> route_offsets(route_tiles.size());
+    uint64_t offset = 0;
+    for(size_t i=0; i<route_tiles.size(); i++) {
+        uint64_t tx = route_tiles[i] % grid.n_x_tiles - tx0;
+        uint64_t ty = route_tiles[i] / grid.n_x_tiles - ty0;
+        order.push_back({(uint32_t) (ty*header.n_x_tiles + tx), i});
+        route_offsets[i] = offset;
+        offset += payloads[i].size()*sizeof(int16_t);
+
+        // Nodes include separators, ways are counted per tile, i.e. as separators
+        uint64_t n_pairs = payloads[i].size()/2;
+        header.max_nodes = std::max(header.max_nodes, n_pairs);
+        header.n_nodes += n_pairs;
+        for(uint64_t j=0; j<n_pairs; j++) {
+            if(!payloads[i][2*j] && !payloads[i][2*j+1]) header.n_ways++;
+        }
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<uint32_t> tile_ids;
+    std::vector<uint64_t> offsets, sizes;
+    std::vector<uint8_t> shifts;
+    for(auto& entry : order) {
+        tile_ids.push_back(entry.first);
+        offsets.push_back(route_offsets[entry.second]);
+        sizes.push_back(payloads[entry.second].size()*sizeof(int16_t));
+        shifts.push_back(route_shifts[entry.second]);
+    }
+
+    MapFileWriter writer;
+    if(!writer.open_v2(output_path, header, MAP_FLAG_SPARSE, tile_ids, offsets, sizes, shifts)) return false;
+    for(auto& payload : payloads) {
+        writer.write_tile(payload.data(), payload.size()*sizeof(int16_t));
+    }
+    writer.close();
+
+    std::cout << "Track points: \t\t\t" << track.size() << "\n";
+    std::cout << "Corridor tiles: \t\t" << route_tiles.size() << " of " << header.n_tiles << "\n";
+    return true;
+}
+
+#endif
@@ -262,11 +262,16 @@ struct MercatorConverter : public osmium::handler::Handler {
     int32_t* _node_x_coords;
     int32_t* _node_y_coords;
     uint64_t* _highway_indices;
+    // Optional buffers for the OSM IDs of highways and nodes
+    int64_t* _way_ids;
+    int64_t* _node_ids;
     int _way_cnt;
     uint64_t _coord_ptr;
 
-    MercatorConverter(int32_t* node_x_coords, int32_t* node_y_coords, uint64_t* highway_indices) :
-        _node_x_coords(node_x_coords), _node_y_coords(node_y_coords), _highway_indices(highway_indices), _way_cnt(0), _coord_ptr(0) {};
+    MercatorConverter(int32_t* node_x_coords, int32_t* node_y_coords, uint64_t* highway_indices,
+        int64_t* way_ids = nullptr, int64_t* node_ids = nullptr) :
+        _node_x_coords(node_x_coords), _node_y_coords(node_y_coords), _highway_indices(highway_indices),
+        _way_ids(way_ids), _node_ids(node_ids), _way_cnt(0), _coord_ptr(0) {};
 
     void way(const osmium::Way& way) noexcept {
         const char* highway = way.tags()["highway"];
@@ -274,12 +279,14 @@ struct MercatorConverter : public osmium::handler::Handler {
             // Mark start for current highway by writing coord pointer to highway indices array.
             // Points to the first node of the current highway.
             _highway_indices[_way_cnt] = _coord_ptr;
+            if(_way_ids) _way_ids[_way_cnt] = way.id();
 
             // Iterate over all remaining nodes in the highway
             auto it = way.nodes().begin();
             for(uint64_t i=0; i<way.nodes().size(); i++) {
                 _node_x_coords[_coord_ptr] = osmium::geom::detail::lon_to_x(it->lon());
                 _node_y_coords[_coord_ptr] = osmium::geom::detail::lat_to_y(it->lat());
+                if(_node_ids) _node_ids[_coord_ptr] = it->ref();
 
                 _coord_ptr++;
                 it++;
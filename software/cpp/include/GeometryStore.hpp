@@ -0,0 +1,249 @@
+#ifndef GEOMETRY_STORE_H
+#define GEOMETRY_STORE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <BoundingBox.hpp>
+
+/*
+
+    Projected geometry of all highways of a map. This is everything the tiles are generated from,
+    so it can be stored next to a map and used to update the map without reading the full OSM file again.
+
+    The file layout is the memory layout of the store:
+
+        magic           8 byte  "STSTORE1"
+        map_x           int64   x-coordinate of lower left corner (mercator-web)
+        map_y           int64   y-coordinate of lower left corner (mercator-web)
+        map_width       uint64
+        map_height      uint64
+        n_ways          uint64  number of ways in the OSM file
+        n_highways      uint64  number of highways in the store
+        n_coords        uint64  number of nodes of all highways
+        way_ids         int64[n_highways]   OSM way ID of each highway
+        highway_indices uint64[n_highways]  index of the first node of each highway
+        node_ids        int64[n_coords]     OSM node ID of each node
+        node_x_coords   int32[n_coords]     mercator x-coordinate of each node
+        node_y_coords   int32[n_coords]     mercator y-coordinate of each node
+
+*/
+class GeometryStore {
+
+public:
+    int64_t map_x = 0;
+    int64_t map_y = 0;
+    uint64_t map_width = 0;
+    uint64_t map_height = 0;
+    uint64_t n_ways = 0;
+    uint64_t n_highways = 0;
+    uint64_t n_coords = 0;
+
+    int64_t* way_ids = nullptr;
+    uint64_t* highway_indices = nullptr;
+    int64_t* node_ids = nullptr;
+    int32_t* node_x_coords = nullptr;
+    int32_t* node_y_coords = nullptr;
+
+    GeometryStore() {};
+
+    ~GeometryStore() {
+        release();
+    }
+
+    GeometryStore(const GeometryStore&) = delete;
+    GeometryStore& operator=(const GeometryStore&) = delete;
+
+    // Allocate memory for the given number of highways and nodes. OSM IDs are only kept if with_ids is set,
+    // which is required to save the store.
+    bool allocate(uint64_t highways, uint64_t coords, bool with_ids = true) {
+        release();
+        n_highways = highways;
+        n_coords = coords;
+        _has_ids = with_ids;
+        _block_size = array_bytes();
+        _block = (char*) calloc(_block_size ? _block_size : 1, 1);
+        if(!_block) {
+            std::cout << "Error: Could not allocate memory for geometry store\n";
+            return false;
+        }
+        assign_arrays();
+        return true;
+    }
+
+    bool save(const char* path) {
+        if(!_has_ids) {
+            std::cout << "Error: Geometry store without OSM IDs can not be saved\n";
+            return false;
+        }
+        FILE* file = fopen(path, "wb");
+        if(!file) {
+            std::cout << "Error: Could not open " << path << " for writing\n";
+            return false;
+        }
+        uint64_t meta[7] = {(uint64_t) map_x, (uint64_t) map_y, map_width, map_height, n_ways, n_highways, n_coords};
+        fwrite(magic, 1, 8, file);
+        fwrite(meta, sizeof(uint64_t), 7, file);
+        fwrite(_block, 1, _block_size, file);
+        fclose(file);
+        return true;
+    }
+
+    bool load(const char* path) {
+        FILE* file = fopen(path, "rb");
+        if(!file) {
+            std::cout << "Error: Could not open geometry store " << path << "\n";
+            return false;
+        }
+        char file_magic[8];
+        uint64_t meta[7];
+        if(fread(file_magic, 1, 8, file) != 8 || memcmp(file_magic, magic, 8) != 0 ||
+            fread(meta, sizeof(uint64_t), 7, file) != 7) {
+            std::cout << "Error: " << path << " is not a geometry store\n";
+            fclose(file);
+            return false;
+        }
+        map_x = (int64_t) meta[0];
+        map_y = (int64_t) meta[1];
+        map_width = meta[2];
+        map_height = meta[3];
+        n_ways = meta[4];
+        if(!allocate(meta[5], meta[6])) {
+            fclose(file);
+            return false;
+        }
+        bool success = fread(_block, 1, _block_size, file) == _block_size;
+        fclose(file);
+        if(!success) {
+            std::cout << "Error: Geometry store " << path << " is truncated\n";
+        }
+        return success;
+    }
+
+    // Map a saved store into memory instead of reading it. The pages are mapped copy-on-write,
+    // so the store can still be modified without changing the file.
+    bool map(const char* path) {
+        release();
+        int fd = ::open(path, O_RDONLY);
+        if(fd < 0) {
+            std::cout << "Error: Could not open geometry store " << path << "\n";
+            return false;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        uint64_t file_size = st.st_size;
+        char* data = file_size >= header_bytes ? (char*) mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : (char*) MAP_FAILED;
+        ::close(fd);
+        if(data == MAP_FAILED || memcmp(data, magic, 8) != 0) {
+            std::cout << "Error: " << path << " is not a geometry store\n";
+            if(data != MAP_FAILED) munmap(data, file_size);
+            return false;
+        }
+        uint64_t meta[7];
+        memcpy(meta, data + 8, sizeof(meta));
+        map_x = (int64_t) meta[0];
+        map_y = (int64_t) meta[1];
+        map_width = meta[2];
+        map_height = meta[3];
+        n_ways = meta[4];
+        n_highways = meta[5];
+        n_coords = meta[6];
+        _has_ids = true;
+        _block_size = array_bytes();
+        if(header_bytes + _block_size > file_size) {
+            std::cout << "Error: Geometry store " << path << " is truncated\n";
+            munmap(data, file_size);
+            return false;
+        }
+        _mapping = data;
+        _mapping_size = file_size;
+        _block = data + header_bytes;
+        assign_arrays();
+        return true;
+    }
+
+    // Index of the first node of a highway
+    uint64_t way_begin(uint64_t hw_id) const {
+        return highway_indices[hw_id];
+    }
+
+    // Index after the last node of a highway
+    uint64_t way_end(uint64_t hw_id) const {
+        return (hw_id + 1 < n_highways) ? highway_indices[hw_id + 1] : n_coords;
+    }
+
+    // Bounding box of a highway in mercator coordinates
+    WayBox way_box(uint64_t hw_id) const {
+        uint64_t begin = way_begin(hw_id);
+        uint64_t end = way_end(hw_id);
+        WayBox box(INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN);
+        for(uint64_t j=begin; j<end; j++) {
+            box.lower_x = std::min(box.lower_x, node_x_coords[j]);
+            box.lower_y = std::min(box.lower_y, node_y_coords[j]);
+            box.upper_x = std::max(box.upper_x, node_x_coords[j]);
+            box.upper_y = std::max(box.upper_y, node_y_coords[j]);
+        }
+        if(begin == end) box = WayBox();
+        box.way_id = way_ids ? way_ids[hw_id] : 0;
+        return box;
+    }
+
+private:
+    static constexpr const char* magic = "STSTORE1";
+    // Magic and metadata. Keeps the arrays of a mapped store 64-bit aligned.
+    static constexpr uint64_t header_bytes = 8 + 7*sizeof(uint64_t);
+
+    char* _block = nullptr;
+    uint64_t _block_size = 0;
+    bool _has_ids = true;
+    // Memory mapped file if the store was mapped instead of allocated
+    char* _mapping = nullptr;
+    uint64_t _mapping_size = 0;
+
+    void release() {
+        if(_mapping) {
+            munmap(_mapping, _mapping_size);
+        } else {
+            free(_block);
+        }
+        _mapping = nullptr;
+        _block = nullptr;
+    }
+
+    uint64_t array_bytes() const {
+        uint64_t bytes = n_highways*sizeof(uint64_t) + 2*n_coords*sizeof(int32_t);
+        if(_has_ids) bytes += n_highways*sizeof(int64_t) + n_coords*sizeof(int64_t);
+        return bytes;
+    }
+
+    // Let the array pointers point into the memory block. 64-bit arrays first to keep them aligned.
+    void assign_arrays() {
+        char* p = _block;
+        way_ids = nullptr;
+        node_ids = nullptr;
+        if(_has_ids) {
+            way_ids = (int64_t*) p;
+            p += n_highways*sizeof(int64_t);
+        }
+        highway_indices = (uint64_t*) p;
+        p += n_highways*sizeof(uint64_t);
+        if(_has_ids) {
+            node_ids = (int64_t*) p;
+            p += n_coords*sizeof(int64_t);
+        }
+        node_x_coords = (int32_t*) p;
+        p += n_coords*sizeof(int32_t);
+        node_y_coords = (int32_t*) p;
+    }
+
+};
+
+#endif
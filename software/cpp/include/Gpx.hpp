@@ -0,0 +1,74 @@
+#ifndef GPX_H
+#define GPX_H
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <osmium/geom/mercator_projection.hpp>
+
+
+/*
+
+    Point of a GPX track in mercator coordinates
+
+*/
+struct TrackPoint {
+    double x, y;
+    double lat;
+};
+
+
+/*
+
+    Reads all track and route points of a GPX file (<trkpt> and <rtept>) in order of their appearance.
+    Only the lat and lon attributes are used, everything else is ignored.
+
+*/
+inline bool read_gpx(const char* path, std::vector<TrackPoint>& points) {
+    std::ifstream file(path);
+    if(!file.good()) {
+        std::cout << "Error: Could not open GPX file " << path << "\n";
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string xml = buffer.str();
+
+    // Value of an attribute within a tag
+    auto attribute = [&xml](size_t tag_start, size_t tag_end, const char* name, double& value) {
+        std::string key = std::string(" ") + name + "=";
+        size_t pos = xml.find(key, tag_start);
+        if(pos == std::string::npos || pos > tag_end) return false;
+        pos += key.size();
+        if(xml[pos] == '"' || xml[pos] == '\'') pos++;
+        value = atof(xml.c_str() + pos);
+        return true;
+    };
+
+    size_t pos = 0;
+    while((pos = xml.find('<', pos)) != std::string::npos) {
+        if(xml.compare(pos, 6, "<trkpt") != 0 && xml.compare(pos, 6, "<rtept") != 0) {
+            pos++;
+            continue;
+        }
+        size_t end = xml.find('>', pos);
+        if(end == std::string::npos) break;
+        double lat, lon;
+        if(attribute(pos, end, "lat", lat) && attribute(pos, end, "lon", lon)) {
+            points.push_back({osmium::geom::detail::lon_to_x(lon), osmium::geom::detail::lat_to_y(lat), lat});
+        }
+        pos = end;
+    }
+
+    if(points.empty()) {
+        std::cout << "Error: GPX file " << path << " contains no track points\n";
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,356 @@
+#ifndef INCREMENTAL_UPDATE_H
+#define INCREMENTAL_UPDATE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <osmium/handler.hpp>
+#include <osmium/io/any_input.hpp>
+#include <osmium/visitor.hpp>
+#include <osmium/geom/mercator_projection.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <BoundingBox.hpp>
+#include <GeometryStore.hpp>
+#include <MapFile.hpp>
+#include <Tile.hpp>
+#include <TileWriter.hpp>
+
+
+/*
+
+    Handler to collect all nodes and ways of an OSM change file (.osc).
+    Deleted objects are kept with visible = false.
+
+*/
+struct ChangeHandler : public osmium::handler::Handler {
+
+    struct ChangedNode {
+        int32_t x, y;
+        bool visible;
+    };
+
+    struct ChangedWay {
+        std::vector<int64_t> refs;
+        bool highway;
+        bool visible;
+        bool created;
+    };
+
+    std::unordered_map<int64_t, ChangedNode> nodes;
+    std::unordered_map<int64_t, ChangedWay> ways;
+
+    void node(const osmium::Node& node) {
+        ChangedNode changed{0, 0, node.visible() && node.location().valid()};
+        if(changed.visible) {
+            changed.x = osmium::geom::detail::lon_to_x(node.location().lon());
+            changed.y = osmium::geom::detail::lat_to_y(node.location().lat());
+        }
+        // Change files are ordered, the last change of an object wins
+        nodes[node.id()] = changed;
+    }
+
+    void way(const osmium::Way& way) {
+        ChangedWay changed;
+        changed.highway = way.tags()["highway"] != nullptr;
+        changed.visible = way.visible();
+        changed.created = way.version() == 1;
+        for(auto& node : way.nodes()) {
+            changed.refs.push_back(node.ref());
+        }
+        auto prev = ways.find(way.id());
+        // A way created and modified within the same change file is still new
+        if(prev != ways.end() && prev->second.created) changed.created = true;
+        ways[way.id()] = changed;
+    }
+
+};
+
+
+/*
+
+    Marks all tiles of the map grid that collide with a bounding box.
+
+*/
+inline void mark_tiles(const BoundingBox& box, const MapHeader& header, std::vector<bool>& dirty) {
+    TileRange range(box, header);
+    for(int64_t ty=range.y0; ty<=range.y1; ty++) {
+        for(int64_t tx=range.x0; tx<=range.x1; tx++) {
+            dirty[ty*header.n_x_tiles + tx] = true;
+        }
+    }
+}
+
+
+/*
+
+    Updates an existing map with an OSM change file.
+
+    The geometry store of the old map provides the projected nodes of all highways together with their OSM IDs,
+    so only the change file has to be read. Every tile that collides with the old or the new geometry of a changed
+    highway is recomputed. If out_map equals old_map and no tile changed its size, the tiles are patched in place.
+    Otherwise the map is rewritten, unchanged tiles are copied from the old map.
+
+    The tile grid of the old map is kept. Geometry that leaves the map area is clipped at the grid boundary.
+    The IDs of all tiles whose content changed are printed to stdout.
+
+*/
+inline bool update_map(const char* old_map_path, const char* store_path, const char* osc_path,
+    const char* out_map_path, const char* out_store_path) {
+
+    std::cout << "------------------------- 1/4 Reading map and changes --------------------------\n";
+    MapFile old_map;
+    if(!old_map.open(old_map_path)) return false;
+    const MapHeader& header = old_map.header;
+    if(old_map.version != 1) {
+        std::cout << "Error: Only maps of version 1 can be updated\n";
+        return false;
+    }
+
+    GeometryStore store;
+    if(!store.load(store_path)) return false;
+    if(store.map_x != header.map_x || store.map_y != header.map_y) {
+        std::cout << "Error: Geometry store " << store_path << " does not belong to map " << old_map_path << "\n";
+        return false;
+    }
+
+    ChangeHandler changes;
+    osmium::io::Reader reader{osmium::io::File{osc_path}, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way};
+    osmium::apply(reader, changes);
+    reader.close();
+    std::cout << "Changed nodes: \t\t\t" << changes.nodes.size() << "\n";
+    std::cout << "Changed ways: \t\t\t" << changes.ways.size() << "\n";
+
+    // Locations of nodes referenced by changed ways, but not contained in the change file, come from the store
+    std::unordered_map<int64_t, std::pair<int32_t, int32_t>> locations;
+    for(auto& way : changes.ways) {
+        if(!way.second.visible || !way.second.highway) continue;
+        for(int64_t ref : way.second.refs) {
+            if(!changes.nodes.count(ref)) locations[ref] = {0, 0};
+        }
+    }
+    std::unordered_set<int64_t> resolved;
+    for(uint64_t j=0; j<store.n_coords; j++) {
+        auto it = locations.find(store.node_ids[j]);
+        if(it != locations.end()) {
+            it->second = {store.node_x_coords[j], store.node_y_coords[j]};
+            resolved.insert(store.node_ids[j]);
+        }
+    }
+
+    std::cout << "------------------------- 2/4 Updating geometry store --------------------------\n";
+    std::vector<bool> dirty(header.n_tiles, false);
+    std::vector<int64_t> way_ids;
+    std::vector<uint64_t> highway_indices;
+    std::vector<int64_t> node_ids;
+    std::vector<int32_t> node_x_coords;
+    std::vector<int32_t> node_y_coords;
+    uint64_t n_unresolved = 0;
+    uint64_t n_created = 0;
+    uint64_t n_deleted = 0;
+
+    // Appends the new geometry of a changed way to the new store. Returns false if the way is no highway anymore.
+    auto append_changed_way = [&](int64_t way_id, const ChangeHandler::ChangedWay& way) {
+        if(!way.visible || !way.highway) return false;
+        way_ids.push_back(way_id);
+        highway_indices.push_back(node_ids.size());
+        for(int64_t ref : way.refs) {
+            auto changed = changes.nodes.find(ref);
+            if(changed != changes.nodes.end() && changed->second.visible) {
+                node_x_coords.push_back(changed->second.x);
+                node_y_coords.push_back(changed->second.y);
+            } else if(changed == changes.nodes.end() && resolved.count(ref)) {
+                node_x_coords.push_back(locations[ref].first);
+                node_y_coords.push_back(locations[ref].second);
+            } else {
+                n_unresolved++;
+                continue;
+            }
+            node_ids.push_back(ref);
+        }
+        return true;
+    };
+
+    // Bounding box of the last highway of the new store
+    auto last_box = [&]() {
+        BoundingBox box(INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN);
+        for(uint64_t j=highway_indices.back(); j<node_ids.size(); j++) {
+            box.lower_x = std::min(box.lower_x, node_x_coords[j]);
+            box.lower_y = std::min(box.lower_y, node_y_coords[j]);
+            box.upper_x = std::max(box.upper_x, node_x_coords[j]);
+            box.upper_y = std::max(box.upper_y, node_y_coords[j]);
+        }
+        return box;
+    };
+
+    std::unordered_set<int64_t> seen_ways;
+    for(uint64_t hw_id=0; hw_id<store.n_highways; hw_id++) {
+        int64_t way_id = store.way_ids[hw_id];
+        seen_ways.insert(way_id);
+        auto changed = changes.ways.find(way_id);
+        bool affected = changed != changes.ways.end();
+
+        if(!affected) {
+            // Copy the highway, but take over changed node locations
+            way_ids.push_back(way_id);
+            highway_indices.push_back(node_ids.size());
+            for(uint64_t j=store.way_begin(hw_id); j<store.way_end(hw_id); j++) {
+                auto node = changes.nodes.find(store.node_ids[j]);
+                if(node != changes.nodes.end()) {
+                    affected = true;
+                    // Deleted nodes are removed from a way by a change of the way itself
+                    if(!node->second.visible) continue;
+                    node_ids.push_back(store.node_ids[j]);
+                    node_x_coords.push_back(node->second.x);
+                    node_y_coords.push_back(node->second.y);
+                } else {
+                    node_ids.push_back(store.node_ids[j]);
+                    node_x_coords.push_back(store.node_x_coords[j]);
+                    node_y_coords.push_back(store.node_y_coords[j]);
+                }
+            }
+        } else if(!append_changed_way(way_id, changed->second)) {
+            if(!changed->second.visible) n_deleted++;
+        }
+
+        if(affected) {
+            mark_tiles(store.way_box(hw_id), header, dirty);
+            if(!way_ids.empty() && way_ids.back() == way_id) mark_tiles(last_box(), header, dirty);
+        }
+    }
+
+    // Highways that were created or became a highway are appended
+    for(auto& way : changes.ways) {
+        if(seen_ways.count(way.first)) continue;
+        if(!way.second.visible && !way.second.created) n_deleted++;
+        if(way.second.created && way.second.visible) n_created++;
+        if(append_changed_way(way.first, way.second)) mark_tiles(last_box(), header, dirty);
+    }
+
+    if(n_unresolved) {
+        std::cout << "Warning: " << n_unresolved << " node references could not be resolved and were skipped.\n";
+    }
+
+    GeometryStore new_store;
+    if(!new_store.allocate(way_ids.size(), node_ids.size())) return false;
+    new_store.map_x = store.map_x;
+    new_store.map_y = store.map_y;
+    new_store.map_width = store.map_width;
+    new_store.map_height = store.map_height;
+    new_store.n_ways = store.n_ways + n_created - std::min(n_deleted, store.n_ways + n_created);
+    std::copy(way_ids.begin(), way_ids.end(), new_store.way_ids);
+    std::copy(highway_indices.begin(), highway_indices.end(), new_store.highway_indices);
+    std::copy(node_ids.begin(), node_ids.end(), new_store.node_ids);
+    std::copy(node_x_coords.begin(), node_x_coords.end(), new_store.node_x_coords);
+    std::copy(node_y_coords.begin(), node_y_coords.end(), new_store.node_y_coords);
+
+    std::cout << "---------------------------- 3/4 Recomputing tiles -----------------------------\n";
+    // Payload of every dirty tile, written in the same order of highways as a full conversion
+    std::unordered_map<uint64_t, std::vector<int16_t>> payloads;
+    for(uint64_t tile_id=0; tile_id<header.n_tiles; tile_id++) {
+        if(dirty[tile_id]) payloads[tile_id];
+    }
+    for(uint64_t hw_id=0; hw_id<new_store.n_highways; hw_id++) {
+        TileRange range(new_store.way_box(hw_id), header);
+        uint64_t begin = new_store.way_begin(hw_id);
+        uint64_t end = new_store.way_end(hw_id);
+        for(int64_t ty=range.y0; ty<=range.y1; ty++) {
+            for(int64_t tx=range.x0; tx<=range.x1; tx++) {
+                uint64_t tile_id = ty*header.n_x_tiles + tx;
+                if(!dirty[tile_id]) continue;
+                std::vector<int16_t>& payload = payloads[tile_id];
+                Tile tile(tile_id, header.tile_size, header.n_x_tiles, header.map_x, header.map_y);
+                uint64_t n = write_way_on_tile(tile, new_store.node_x_coords, new_store.node_y_coords, begin, end, nullptr);
+                uint64_t offset = payload.size();
+                payload.resize(offset + n);
+                write_way_on_tile(tile, new_store.node_x_coords, new_store.node_y_coords, begin, end, payload.data() + offset);
+            }
+        }
+    }
+
+    // Compare against the old tiles
+    std::vector<uint64_t> changed_tiles;
+    bool same_sizes = true;
+    MapHeader new_header = header;
+    new_header.n_ways = new_store.n_ways;
+    for(auto& payload : payloads) {
+        uint64_t tile_id = payload.first;
+        uint64_t old_bytes = old_map.tile_size(tile_id);
+        uint64_t new_bytes = payload.second.size()*sizeof(int16_t);
+        if(old_bytes == new_bytes && memcmp(old_map.tile(tile_id), payload.second.data(), new_bytes) == 0) continue;
+        changed_tiles.push_back(tile_id);
+        if(old_bytes != new_bytes) same_sizes = false;
+    }
+    std::sort(changed_tiles.begin(), changed_tiles.end());
+
+    std::vector<uint64_t> tile_sizes(header.n_tiles);
+    // Counted from all tiles, which also corrects the count of maps written by older versions
+    new_header.max_nodes = 0;
+    new_header.n_nodes = 0;
+    for(uint64_t tile_id=0; tile_id<header.n_tiles; tile_id++) {
+        auto payload = payloads.find(tile_id);
+        tile_sizes[tile_id] = payload != payloads.end() ? payload->second.size()*sizeof(int16_t) : old_map.tile_size(tile_id);
+        new_header.max_nodes = std::max<uint64_t>(new_header.max_nodes, tile_sizes[tile_id]/(2*sizeof(int16_t)));
+        new_header.n_nodes += tile_sizes[tile_id]/(2*sizeof(int16_t));
+    }
+
+    std::cout << "------------------------------ 4/4 Writing map ---------------------------------\n";
+    bool in_place = same_sizes && std::string(old_map_path) == std::string(out_map_path);
+    if(in_place) {
+        // Only header and changed tiles are written
+        uint64_t data_start = SimpleTileFormat::dataOffset(1, 0, header.n_tiles);
+        std::vector<uint64_t> pointers(old_map.pointers, old_map.pointers + header.n_tiles);
+        old_map.close();
+        FILE* file = fopen(out_map_path, "r+b");
+        if(!file) {
+            std::cout << "Error: Could not open " << out_map_path << " for writing\n";
+            return false;
+        }
+        fwrite(&new_header, sizeof(MapHeader), 1, file);
+        for(uint64_t tile_id : changed_tiles) {
+            fseek(file, data_start + pointers[tile_id], SEEK_SET);
+            fwrite(payloads[tile_id].data(), sizeof(int16_t), payloads[tile_id].size(), file);
+        }
+        fclose(file);
+        std::cout << "Patched " << changed_tiles.size() << " tiles in place\n";
+    } else {
+        // Write into a temporary file first, the old map may be the output
+        std::string tmp_path = std::string(out_map_path) + ".tmp";
+        MapFileWriter writer;
+        if(!writer.open(tmp_path.c_str(), new_header, tile_sizes)) return false;
+        for(uint64_t tile_id=0; tile_id<header.n_tiles; tile_id++) {
+            auto payload = payloads.find(tile_id);
+            if(payload != payloads.end()) {
+                writer.write_tile(payload->second.data(), tile_sizes[tile_id]);
+            } else {
+                writer.write_tile(old_map.tile(tile_id), tile_sizes[tile_id]);
+            }
+        }
+        writer.close();
+        old_map.close();
+        if(rename(tmp_path.c_str(), out_map_path) != 0) {
+            std::cout << "Error: Could not move " << tmp_path << " to " << out_map_path << "\n";
+            return false;
+        }
+        std::cout << "Rewrote map with " << changed_tiles.size() << " changed tiles\n";
+    }
+
+    if(!new_store.save(out_store_path ? out_store_path : store_path)) return false;
+
+    std::cout << "Changed tiles: \t\t\t" << changed_tiles.size() << "\n";
+    std::cout << "Changed tile IDs:";
+    for(uint64_t tile_id : changed_tiles) std::cout << " " << tile_id;
+    std::cout << "\n";
+    std::cout << "Map updated successfully at: " << out_map_path << "\n";
+    return true;
+}
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef MAP_EXTRACT_H
+#define MAP_EXTRACT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <osmium/geom/mercator_projection.hpp>
+
+#include <BoundingBox.hpp>
+#include <MapFile.hpp>
+
+
+/*
+
+    Region given as one or more closed rings in mercator coordinates, e.g. read from an osmosis .poly file.
+    Holes are ignored, i.e. the region always covers the complete outer rings.
+
+*/
+class Region {
+
+public:
+    std::vector<std::vector<std::pair<double, double>>> rings;
+
+    // Rectangular region from lon/lat bounds
+    static Region from_bbox(double min_lon, double min_lat, double max_lon, double max_lat) {
+        double x0 = osmium::geom::detail::lon_to_x(min_lon);
+        double y0 = osmium::geom::detail::lat_to_y(min_lat);
+        double x1 = osmium::geom::detail::lon_to_x(max_lon);
+        double y1 = osmium::geom::detail::lat_to_y(max_lat);
+        Region region;
+        region.rings.push_back({{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}});
+        return region;
+    }
+
+    // Read the outer rings of an osmosis polygon filter file
+    bool read_poly(const char* path) {
+        std::ifstream file(path);
+        if(!file.good()) {
+            std::cout << "Error: Could not open polygon " << path << "\n";
+            return false;
+        }
+        std::string line;
+        // First line is the name of the polygon
+        std::getline(file, line);
+        while(std::getline(file, line)) {
+            line.erase(0, line.find_first_not_of(" \t"));
+            if(line.empty()) continue;
+            if(line.compare(0, 3, "END") == 0) break;
+            // Start of a ring. Rings starting with '!' are holes.
+            bool hole = line[0] == '!';
+            std::vector<std::pair<double, double>> ring;
+            while(std::getline(file, line)) {
+                line.erase(0, line.find_first_not_of(" \t"));
+                if(line.compare(0, 3, "END") == 0) break;
+                std::istringstream coords(line);
+                double lon, lat;
+                if(!(coords >> lon >> lat)) {
+                    std::cout << "Error: Invalid line in polygon " << path << ": " << line << "\n";
+                    return false;
+                }
+                ring.push_back({osmium::geom::detail::lon_to_x(lon), osmium::geom::detail::lat_to_y(lat)});
+            }
+            if(!hole && ring.size() >= 3) rings.push_back(ring);
+        }
+        if(rings.empty()) {
+            std::cout << "Error: Polygon " << path << " contains no ring\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Mercator bounding box of all rings
+    BoundingBox bounds() const {
+        double x0 = 1e10, y0 = 1e10, x1 = -1e10, y1 = -1e10;
+        for(auto& ring : rings) {
+            for(auto& p : ring) {
+                x0 = std::min(x0, p.first);
+                y0 = std::min(y0, p.second);
+                x1 = std::max(x1, p.first);
+                y1 = std::max(y1, p.second);
+            }
+        }
+        return BoundingBox(x0, y0, x1, y1);
+    }
+
+    // Check if an axis aligned rectangle intersects the region
+    bool intersects(double x0, double y0, double x1, double y1) const {
+        // Rectangle inside of the region
+        if(contains((x0 + x1)/2, (y0 + y1)/2)) return true;
+        // Region inside of the rectangle or any edge crossing the rectangle
+        for(auto& ring : rings) {
+            for(size_t i=0; i<ring.size(); i++) {
+                auto& a = ring[i];
+                auto& b = ring[(i + 1) % ring.size()];
+                if(segment_intersects(a.first, a.second, b.first, b.second, x0, y0, x1, y1)) return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    // Even-odd rule over all rings
+    bool contains(double x, double y) const {
+        bool inside = false;
+        for(auto& ring : rings) {
+            for(size_t i=0, j=ring.size()-1; i<ring.size(); j=i++) {
+                if(((ring[i].second > y) != (ring[j].second > y)) &&
+                    (x < (ring[j].first - ring[i].first) * (y - ring[i].second) / (ring[j].second - ring[i].second) + ring[i].first)) {
+                    inside = !inside;
+                }
+            }
+        }
+        return inside;
+    }
+
+    // Slab test of a line segment against an axis aligned rectangle
+    static bool segment_intersects(double ax, double ay, double bx, double by, double x0, double y0, double x1, double y1) {
+        double t0 = 0, t1 = 1;
+        double d[2] = {bx - ax, by - ay};
+        double a[2] = {ax, ay};
+        double lo[2] = {x0, y0};
+        double hi[2] = {x1, y1};
+        for(int k=0; k<2; k++) {
+            if(d[k] == 0) {
+                if(a[k] < lo[k] || a[k] > hi[k]) return false;
+                continue;
+            }
+            double ta = (lo[k] - a[k]) / d[k];
+            double tb = (hi[k] - a[k]) / d[k];
+            t0 = std::max(t0, std::min(ta, tb));
+            t1 = std::min(t1, std::max(ta, tb));
+            if(t0 > t1) return false;
+        }
+        return true;
+    }
+
+};
+
+
+/*
+
+    Cuts a region out of an existing map. The tile grid of the source map is kept, the new map consists of all
+    tiles within the bounding box of the region. Since tile coordinates are stored relative to their tile, the
+    payloads are copied from the memory mapped source without decoding, together with their quantization shift.
+    Tiles that lie within the bounding box, but do not intersect the region, are left empty.
+
+*/
+inline bool extract_map(const char* input_path, const char* output_path, const Region& region) {
+    MapFile map;
+    if(!map.open(input_path)) return false;
+    const MapHeader& header = map.header;
+    int64_t tile_size = header.tile_size;
+
+    // Tile range of the region, clamped to the source map
+    BoundingBox bounds = region.bounds();
+    int64_t tx0 = std::max<int64_t>((int64_t) std::floor((double) (bounds.lower_x - header.map_x) / tile_size), 0);
+    int64_t ty0 = std::max<int64_t>((int64_t) std::floor((double) (bounds.lower_y - header.map_y) / tile_size), 0);
+    int64_t tx1 = std::min<int64_t>((int64_t) std::floor((double) (bounds.upper_x - header.map_x) / tile_size), header.n_x_tiles - 1);
+    int64_t ty1 = std::min<int64_t>((int64_t) std::floor((double) (bounds.upper_y - header.map_y) / tile_size), header.n_y_tiles() - 1);
+    if(tx0 > tx1 || ty0 > ty1) {
+        std::cout << "Error: Region does not overlap with map " << input_path << "\n";
+        return false;
+    }
+
+    MapHeader out_header = header;
+    out_header.map_x = header.map_x + tx0*tile_size;
+    out_header.map_y = header.map_y + ty0*tile_size;
+    out_header.n_x_tiles = tx1 - tx0 + 1;
+    out_header.n_tiles = out_header.n_x_tiles * (ty1 - ty0 + 1);
+    out_header.map_width = std::min<int64_t>(out_header.n_x_tiles*tile_size, header.map_width - tx0*tile_size);
+    out_header.map_height = std::min<int64_t>((ty1 - ty0 + 1)*tile_size, header.map_height - ty0*tile_size);
+    out_header.max_nodes = 0;
+    out_header.n_nodes = 0;
+    out_header.n_ways = 0;
+
+    // Map new tile IDs to source tile IDs. Tiles outside of the region get no source tile.
+    std::vector<int64_t> source(out_header.n_tiles, -1);
+    std::vector<uint64_t> tile_sizes(out_header.n_tiles, 0);
+    std::vector<uint8_t> shifts(out_header.n_tiles, 0);
+    for(int64_t ty=ty0; ty<=ty1; ty++) {
+        for(int64_t tx=tx0; tx<=tx1; tx++) {
+            double x = header.map_x + tx*tile_size;
+            double y = header.map_y + ty*tile_size;
+            if(!region.intersects(x, y, x + tile_size, y + tile_size)) continue;
+            uint64_t new_id = (ty - ty0)*out_header.n_x_tiles + (tx - tx0);
+            source[new_id] = ty*header.n_x_tiles + tx;
+            tile_sizes[new_id] = map.tile_size(source[new_id]);
+            shifts[new_id] = map.tile_shift(source[new_id]);
+
+            // Statistics of the new map. Nodes include separators, ways are counted per tile, i.e. as separators.
+            const int16_t* tile = map.tile(source[new_id]);
+            uint64_t n_pairs = tile_sizes[new_id]/(2*sizeof(int16_t));
+            out_header.max_nodes = std::max(out_header.max_nodes, n_pairs);
+            out_header.n_nodes += n_pairs;
+            for(uint64_t i=0; i<n_pairs; i++) {
+                if(!tile[2*i] && !tile[2*i+1]) out_header.n_ways++;
+            }
+        }
+    }
+
+    MapFileWriter writer;
+    if(!writer.open(output_path, out_header, tile_sizes, shifts)) return false;
+    for(uint64_t tile_id=0; tile_id<out_header.n_tiles; tile_id++) {
+        writer.write_tile(source[tile_id] >= 0 ? map.tile(source[tile_id]) : nullptr, tile_sizes[tile_id]);
+    }
+    writer.close();
+
+    std::cout << "X-tiles: \t\t\t" << out_header.n_x_tiles << "\n";
+    std::cout << "Y-tiles: \t\t\t" << out_header.n_y_tiles() << "\n";
+    std::cout << "Total tiles: \t\t\t" << out_header.n_tiles << "\n";
+    std::cout << "Nodes: \t\t\t\t" << out_header.n_nodes << "\n";
+    return true;
+}
+
+#endif
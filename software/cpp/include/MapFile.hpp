@@ -0,0 +1,375 @@
+#ifndef MAP_FILE_H
+#define MAP_FILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <simpletileformat.h>
+
+/*
+
+    The layout of the map file is defined in simpletileformat.h (software/common/include), which is shared with
+    the firmware. The names below are the ones used throughout the converter.
+
+    Entries of version 2 contain the offset, the size and the quantization shift of a tile. Local coordinates of a
+    tile with shift s are stored in units of 2^s, i.e. the coordinate relative to the tile origin is value << s.
+    The shift is the smallest one at which all coordinates of the tile fit into int16, so it is zero unless the
+    tile is larger than INT16_MAX or a way leaves the tile far away. Writers only use version 2 for a dense map
+    if at least one tile has a shift.
+
+*/
+typedef SimpleTileFormat::MapHeader MapHeader;
+typedef SimpleTileFormat::MapHeaderV2 MapHeaderV2;
+using SimpleTileFormat::crc32;
+
+const uint64_t MAP_MAGIC_V2 = SimpleTileFormat::MAGIC_V2;
+const uint64_t MAP_FLAG_SPARSE = SimpleTileFormat::FLAG_SPARSE;
+
+// Largest shift that fits into an entry
+const uint8_t MAP_MAX_SHIFT = SimpleTileFormat::MAX_SHIFT;
+// Largest tile size, tiles with 4 times the extent of INT16_MAX use a shift of 2
+const uint64_t MAP_MAX_TILE_SIZE = 1 << 17;
+
+inline uint64_t pack_tile_entry(uint64_t offset, uint64_t size, uint8_t shift = 0) {
+    return SimpleTileFormat::packEntry(offset, size, shift);
+}
+
+inline uint64_t tile_entry_offset(uint64_t entry) {
+    return SimpleTileFormat::entryOffset(entry);
+}
+
+inline uint64_t tile_entry_size(uint64_t entry) {
+    return SimpleTileFormat::entrySize(entry);
+}
+
+inline uint8_t tile_entry_shift(uint64_t entry) {
+    return SimpleTileFormat::entryShift(entry);
+}
+
+// Smallest shift at which a local coordinate of the given absolute value fits into int16 after rounding
+inline uint8_t shift_for_extent(int64_t extent) {
+    uint8_t shift = 0;
+    while(shift < MAP_MAX_SHIFT && ((extent + ((1LL << shift) >> 1)) >> shift) >= INT16_MAX) shift++;
+    return shift;
+}
+
+// Size of the sparse tile index in bytes, including padding
+inline uint64_t tile_index_bytes(uint64_t n_entries) {
+    return SimpleTileFormat::indexBytes(MAP_FLAG_SPARSE, n_entries);
+}
+
+
+/*
+
+    Way on a tile: consecutive coordinates between two separators, pointing into the tile data.
+
+*/
+struct Polyline {
+    const int16_t* coords;
+    uint64_t n_points;
+
+    int16_t x(uint64_t i) const { return coords[2*i]; }
+    int16_t y(uint64_t i) const { return coords[2*i + 1]; }
+};
+
+// Forward iterator over the polylines of a tile. Separators are skipped, so no polyline is empty.
+class PolylineIterator {
+
+public:
+    PolylineIterator(const int16_t* begin, const int16_t* end) : _end(end) {
+        find(begin);
+    }
+
+    const Polyline& operator*() const { return _current; }
+    const Polyline* operator->() const { return &_current; }
+
+    PolylineIterator& operator++() {
+        find(_current.coords + 2*_current.n_points);
+        return *this;
+    }
+
+    bool operator==(const PolylineIterator& other) const { return _current.coords == other._current.coords; }
+    bool operator!=(const PolylineIterator& other) const { return _current.coords != other._current.coords; }
+
+private:
+    const int16_t* _end;
+    Polyline _current;
+
+    void find(const int16_t* p) {
+        while(p < _end && !p[0] && !p[1]) p += 2;
+        const int16_t* q = p;
+        while(q < _end && (q[0] || q[1])) q += 2;
+        _current = {p < _end ? p : _end, (uint64_t) (q - p)/2};
+    }
+
+};
+
+
+/*
+
+    Zero-copy view of the data of a single tile, similar to a std::span. Only valid while the map is open.
+    Local coordinates relative to the tile origin are value << shift.
+
+*/
+struct TileView {
+    const int16_t* data = nullptr;
+    // Number of int16 values (twice the number of coordinate pairs including separators)
+    uint64_t size = 0;
+    uint8_t shift = 0;
+
+    struct Polylines {
+        const int16_t* first;
+        const int16_t* last;
+        PolylineIterator begin() const { return PolylineIterator(first, last); }
+        PolylineIterator end() const { return PolylineIterator(last, last); }
+    };
+
+    bool empty() const { return !size; }
+    uint64_t n_pairs() const { return size/2; }
+    const int16_t* begin() const { return data; }
+    const int16_t* end() const { return data + size; }
+    const int16_t& operator[](uint64_t i) const { return data[i]; }
+
+    // Ways on the tile, e.g. for(const Polyline& way : view.polylines())
+    Polylines polylines() const {
+        return {data, data + 2*n_pairs()};
+    }
+};
+
+
+/*
+
+    Read-only view of an existing map file. The file is memory mapped, tiles are accessed without copying.
+    Supports both versions of the file format. Tiles that are not stored in a sparse map are empty.
+
+*/
+class MapFile {
+
+public:
+    MapHeader header;
+    // Version of the file format, flags and number of stored tiles (version 2)
+    int version = 1;
+    uint64_t flags = 0;
+    uint64_t n_entries = 0;
+    // Tile pointers in BYTE count relative to the start of the tile data (version 1)
+    const uint64_t* pointers = nullptr;
+    // Sorted IDs of stored tiles (sparse maps) and tile entries (version 2)
+    const uint32_t* index = nullptr;
+    const uint64_t* entries = nullptr;
+    // Start of tile data
+    const int16_t* tiles = nullptr;
+    // Size of tile data in bytes
+    uint64_t tile_bytes = 0;
+
+    MapFile() {};
+
+    ~MapFile() {
+        close();
+    }
+
+    bool open(const char* path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if(fd < 0) {
+            std::cout << "Error: Could not open map " << path << "\n";
+            return false;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        _size = st.st_size;
+        if(_size < sizeof(MapHeader)) {
+            std::cout << "Error: " << path << " is not a valid map\n";
+            ::close(fd);
+            return false;
+        }
+        _data = (char*) mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(_data == MAP_FAILED) {
+            _data = nullptr;
+            std::cout << "Error: Could not map " << path << " into memory\n";
+            return false;
+        }
+
+        version = SimpleTileFormat::parseHeader(_data, _size, header, flags, n_entries);
+        uint64_t entries_start = SimpleTileFormat::entriesOffset(version, flags, n_entries);
+        uint64_t data_start = SimpleTileFormat::dataOffset(version, flags, n_entries);
+        if(!version || data_start > _size) {
+            std::cout << "Error: " << path << " is not a valid map\n";
+            close();
+            return false;
+        }
+        if(version == 2) {
+            index = (flags & MAP_FLAG_SPARSE) ? (const uint32_t*) (_data + SimpleTileFormat::indexOffset()) : nullptr;
+            entries = (const uint64_t*) (_data + entries_start);
+        } else {
+            pointers = (const uint64_t*) (_data + entries_start);
+        }
+        tiles = (const int16_t*) (_data + data_start);
+        tile_bytes = _size - data_start;
+        return true;
+    }
+
+    void close() {
+        if(_data) munmap(_data, _size);
+        _data = nullptr;
+        pointers = nullptr;
+        index = nullptr;
+        entries = nullptr;
+        tiles = nullptr;
+    }
+
+    // Position of a tile in the entry table or -1 if the tile is not stored (version 2)
+    int64_t entry_of(uint64_t tile_id) const {
+        if(!index) return tile_id < n_entries ? tile_id : -1;
+        const uint32_t* it = std::lower_bound(index, index + n_entries, (uint32_t) tile_id);
+        return (it != index + n_entries && *it == tile_id) ? it - index : -1;
+    }
+
+    // Size of a tile in bytes
+    uint64_t tile_size(uint64_t tile_id) const {
+        if(version == 2) {
+            int64_t e = entry_of(tile_id);
+            return e >= 0 ? tile_entry_size(entries[e]) : 0;
+        }
+        uint64_t end = (tile_id + 1 < header.n_tiles) ? pointers[tile_id + 1] : tile_bytes;
+        return end - pointers[tile_id];
+    }
+
+    // Quantization shift of a tile, always zero in version 1
+    uint8_t tile_shift(uint64_t tile_id) const {
+        if(version != 2) return 0;
+        int64_t e = entry_of(tile_id);
+        return e >= 0 ? tile_entry_shift(entries[e]) : 0;
+    }
+
+    // Pointer to the first coordinate of a tile
+    const int16_t* tile(uint64_t tile_id) const {
+        if(version == 2) {
+            int64_t e = entry_of(tile_id);
+            return e >= 0 ? tiles + tile_entry_offset(entries[e])/sizeof(int16_t) : tiles;
+        }
+        return tiles + pointers[tile_id]/sizeof(int16_t);
+    }
+
+    // Zero-copy view of a tile with a single lookup of its entry. Empty if the tile is not stored.
+    TileView view(uint64_t tile_id) const {
+        TileView view;
+        if(tile_id >= header.n_tiles) return view;
+        if(version == 2) {
+            int64_t e = entry_of(tile_id);
+            if(e < 0) return view;
+            view.data = tiles + tile_entry_offset(entries[e])/sizeof(int16_t);
+            view.size = tile_entry_size(entries[e])/sizeof(int16_t);
+            view.shift = tile_entry_shift(entries[e]);
+        } else {
+            view.data = tile(tile_id);
+            view.size = tile_size(tile_id)/sizeof(int16_t);
+        }
+        return view;
+    }
+
+    // Size of the mapped file in bytes
+    uint64_t file_size() const {
+        return _size;
+    }
+
+private:
+    char* _data = nullptr;
+    uint64_t _size = 0;
+
+};
+
+
+/*
+
+    Sequential writer for map files. The sizes of all tiles have to be known upfront, the tiles are then
+    appended one after another in order of their ID.
+
+*/
+class MapFileWriter {
+
+public:
+    uint64_t n_written = 0;
+
+    // tile_sizes contains the size of each tile in BYTE count. If any tile has a quantization shift,
+    // a dense map of version 2 is written, otherwise a map of version 1.
+    bool open(const char* path, const MapHeader& header, const std::vector<uint64_t>& tile_sizes,
+        const std::vector<uint8_t>& shifts = {}) {
+        std::vector<uint64_t> pointers(tile_sizes.size());
+        uint64_t ptr = 0;
+        for(size_t i=0; i<tile_sizes.size(); i++) {
+            pointers[i] = ptr;
+            ptr += tile_sizes[i];
+        }
+        if(std::any_of(shifts.begin(), shifts.end(), [](uint8_t shift) { return shift > 0; })) {
+            std::vector<uint32_t> tile_ids(tile_sizes.size());
+            for(size_t i=0; i<tile_ids.size(); i++) tile_ids[i] = i;
+            return open_v2(path, header, 0, tile_ids, pointers, tile_sizes, shifts);
+        }
+        _file = fopen(path, "wb");
+        if(!_file) {
+            std::cout << "Error: Could not open " << path << " for writing\n";
+            return false;
+        }
+        fwrite(&header, sizeof(MapHeader), 1, _file);
+        fwrite(pointers.data(), sizeof(uint64_t), pointers.size(), _file);
+        n_written = 0;
+        return true;
+    }
+
+    // Version 2 map. tile_ids are the sorted IDs of all stored tiles, offsets and sizes the position of each tile
+    // in the tile data in BYTE count and shifts their quantization shift (zero if empty). Tiles are then appended
+    // in order of their offsets.
+    bool open_v2(const char* path, const MapHeader& header, uint64_t flags, const std::vector<uint32_t>& tile_ids,
+        const std::vector<uint64_t>& offsets, const std::vector<uint64_t>& sizes, const std::vector<uint8_t>& shifts = {}) {
+        for(size_t i=0; i<tile_ids.size(); i++) {
+            if(sizes[i] >= (1ULL << 22) || offsets[i] >= (1ULL << 42)) {
+                std::cout << "Error: Tile " << tile_ids[i] << " does not fit into a map of version 2\n";
+                return false;
+            }
+        }
+        _file = fopen(path, "wb");
+        if(!_file) {
+            std::cout << "Error: Could not open " << path << " for writing\n";
+            return false;
+        }
+        MapHeaderV2 header_v2 = {MAP_MAGIC_V2, header, flags, tile_ids.size()};
+        fwrite(&header_v2, sizeof(MapHeaderV2), 1, _file);
+        if(flags & MAP_FLAG_SPARSE) {
+            std::vector<uint32_t> index(tile_index_bytes(tile_ids.size())/sizeof(uint32_t), 0);
+            std::copy(tile_ids.begin(), tile_ids.end(), index.begin());
+            fwrite(index.data(), sizeof(uint32_t), index.size(), _file);
+        }
+        std::vector<uint64_t> entries(tile_ids.size());
+        for(size_t i=0; i<tile_ids.size(); i++) {
+            entries[i] = pack_tile_entry(offsets[i], sizes[i], shifts.empty() ? 0 : shifts[i]);
+        }
+        fwrite(entries.data(), sizeof(uint64_t), entries.size(), _file);
+        n_written = 0;
+        return true;
+    }
+
+    void write_tile(const int16_t* data, uint64_t n_bytes) {
+        if(n_bytes) fwrite(data, 1, n_bytes, _file);
+        n_written++;
+    }
+
+    void close() {
+        if(_file) fclose(_file);
+        _file = nullptr;
+    }
+
+private:
+    FILE* _file = nullptr;
+
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef MAP_VERIFY_H
+#define MAP_VERIFY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include <MapFile.hpp>
+
+/*
+
+    Consistency check of a map file. The header and the tile index are checked once, then every stored
+    tile is checked in parallel for
+
+        offsets     tile data is 4 byte aligned and lies within the file, pointers of version 1 are ascending
+        separators  a tile that is not empty ends with a separator
+        max_nodes   no tile has more coordinate pairs than max_nodes of the header, which sizes the tile
+                    buffer of the device
+        n_nodes     the header counts the coordinate pairs of all tiles, including separators
+        bounds      no node lies left of or below its tile. Tiles only contain their own nodes and the
+                    neighbours of clipped ways to their top or right (see TileWriter.hpp).
+
+    The tile data is only read through the memory map, so a map of several GB is checked at the speed of
+    the disk. At most max_reported errors are printed. Returns true if no error was found.
+
+*/
+inline bool verify_map(const MapFile& map, uint64_t max_reported = 20) {
+    const MapHeader& header = map.header;
+    uint64_t n_errors = 0;
+
+    auto report = [&n_errors, max_reported](const std::string& message) {
+        #pragma omp critical
+        {
+            if(n_errors < max_reported) std::cout << "Error: " << message << "\n";
+            n_errors++;
+        }
+    };
+
+    // Header
+    if(!header.tile_size || header.tile_size > MAP_MAX_TILE_SIZE) {
+        report("Invalid tile size " + std::to_string(header.tile_size));
+    }
+    if(header.n_tiles % header.n_x_tiles) {
+        report("Number of tiles " + std::to_string(header.n_tiles) + " is not a multiple of "
+            + std::to_string(header.n_x_tiles) + " tiles in x direction");
+    }
+    if(header.n_x_tiles*header.tile_size < header.map_width || header.n_y_tiles()*header.tile_size < header.map_height) {
+        report("Tile grid does not cover the map area");
+    }
+    if(map.version == 2 && (map.flags & ~MAP_FLAG_SPARSE)) {
+        report("Unknown flags " + std::to_string(map.flags));
+    }
+    if(map.version == 2 && !map.index && map.n_entries != header.n_tiles) {
+        report("Dense map stores " + std::to_string(map.n_entries) + " of " + std::to_string(header.n_tiles) + " tiles");
+    }
+    if(map.index) {
+        for(uint64_t e=0; e<map.n_entries; e++) {
+            if(map.index[e] >= header.n_tiles || (e && map.index[e] <= map.index[e-1])) {
+                report("Tile index is not sorted or out of range at entry " + std::to_string(e));
+                break;
+            }
+        }
+    }
+    if(n_errors) return false;
+
+    uint64_t n_stored = 0, n_pairs = 0, n_nodes = 0, n_polylines = 0, max_pairs = 0;
+
+    #pragma omp parallel for schedule(dynamic, 256) reduction(+:n_stored, n_pairs, n_nodes, n_polylines) reduction(max:max_pairs)
+    for(int64_t e=0; e<(int64_t) map.n_entries; e++) {
+        uint64_t tile_id = map.index ? map.index[e] : e;
+        std::string tile_name = "Tile " + std::to_string(tile_id) + ": ";
+
+        uint64_t offset, size;
+        uint8_t shift = 0;
+        if(map.version == 2) {
+            offset = tile_entry_offset(map.entries[e]);
+            size = tile_entry_size(map.entries[e]);
+            shift = tile_entry_shift(map.entries[e]);
+        } else {
+            offset = map.pointers[e];
+            uint64_t end = (e + 1 < (int64_t) header.n_tiles) ? map.pointers[e + 1] : map.tile_bytes;
+            if(offset % 4 || end < offset) {
+                report(tile_name + "pointer " + std::to_string(offset) + " is not aligned or not ascending");
+                continue;
+            }
+            size = end - offset;
+        }
+        if(offset + size > map.tile_bytes) {
+            report(tile_name + "data at " + std::to_string(offset) + " with " + std::to_string(size) + " bytes exceeds the file");
+            continue;
+        }
+        if(size % 4) {
+            report(tile_name + "size " + std::to_string(size) + " is not a multiple of a coordinate pair");
+            continue;
+        }
+        if(!size) continue;
+        n_stored++;
+
+        TileView view = {map.tiles + offset/sizeof(int16_t), size/sizeof(int16_t), shift};
+        n_pairs += view.n_pairs();
+        max_pairs = std::max<uint64_t>(max_pairs, view.n_pairs());
+        if(view.n_pairs() > header.max_nodes) {
+            report(tile_name + std::to_string(view.n_pairs()) + " coordinate pairs exceed max_nodes " + std::to_string(header.max_nodes));
+        }
+        if(view[view.size - 2] || view[view.size - 1]) {
+            report(tile_name + "last way is not terminated by a separator");
+        }
+
+        // Nodes left of or below the tile, with a tolerance of the rounding error of the shift
+        int64_t tile_size = header.tile_size;
+        int64_t half = (1LL << shift) >> 1;
+        uint64_t n_outside = 0;
+        for(const Polyline& way : view.polylines()) {
+            n_polylines++;
+            n_nodes += way.n_points;
+            for(uint64_t i=0; i<way.n_points; i++) {
+                int64_t x = (int64_t) way.x(i) * (1LL << shift);
+                int64_t y = (int64_t) way.y(i) * (1LL << shift);
+                if((x < -half || y < -half) && x + half <= tile_size && y + half <= tile_size) n_outside++;
+            }
+        }
+        if(n_outside) {
+            report(tile_name + std::to_string(n_outside) + " nodes lie left of or below the tile");
+        }
+    }
+
+    if(n_pairs != header.n_nodes) {
+        report("Header counts " + std::to_string(header.n_nodes) + " nodes, the tiles hold " + std::to_string(n_pairs)
+            + " coordinate pairs including separators");
+    }
+
+    std::cout << "Map version: \t\t\t" << map.version << "\n";
+    std::cout << "Tiles: \t\t\t\t" << n_stored << " of " << header.n_tiles << " not empty\n";
+    std::cout << "Ways on tiles: \t\t\t" << n_polylines << "\n";
+    std::cout << "Nodes on tiles: \t\t" << n_nodes << " (" << n_pairs << " pairs with separators)\n";
+    std::cout << "Largest tile: \t\t\t" << max_pairs << " pairs (max_nodes " << header.max_nodes << ")\n";
+    if(n_errors > max_reported) {
+        std::cout << "... " << n_errors - max_reported << " more errors\n";
+    }
+    return !n_errors;
+}
+
+#endif
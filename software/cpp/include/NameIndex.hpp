@@ -0,0 +1,258 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <osmium/handler.hpp>
+#include <osmium/visitor.hpp>
+#include <osmium/io/any_input.hpp>
+#include <osmium/geom/mercator_projection.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <MapFile.hpp>
+#include <StoreConversion.hpp>
+
+
+/*
+
+    Name index, a sidecar file that maps street and place names to positions on a map.
+
+        magic       char[8]     "STNAMES1"
+        header_crc  uint32      CRC32 of the 80 byte map header (version 1 fields) the index was created for
+        n_names     uint32      number of names
+        n_blocks    uint32      number of blocks
+        reserved    uint32      zero
+        directory   n_blocks * char[32], search key of the first name of each block, zero padded
+        padding     up to the next multiple of NAME_BLOCK_SIZE
+        blocks      n_blocks * NAME_BLOCK_SIZE bytes
+
+    Names are sorted by their search key (ASCII letters in lower case, all other bytes unchanged). Within a
+    block, names are front coded. Every entry consists of
+
+        shared      uint8       number of leading bytes shared with the previous name of the block
+        length      uint8       number of following bytes
+        suffix      char[length]
+        kind        uint8       NAME_KIND_STREET or NAME_KIND_PLACE
+        tile_id     uint32
+        x, y        int16       local coordinates on the tile
+
+    and a block ends with shared = length = 0 or its last byte. A prefix search does a binary search over the
+    directory and then reads blocks until the names do not match the prefix anymore, so it touches only a few
+    blocks of the file and the index never has to be loaded into memory.
+
+*/
+#define NAMES_MAGIC "STNAMES1"
+
+const uint64_t NAME_BLOCK_SIZE = 512;
+const uint64_t NAME_KEY_SIZE = 32;
+// Longer names are truncated
+const uint64_t NAME_MAX_LENGTH = 63;
+
+const uint8_t NAME_KIND_STREET = 0;
+const uint8_t NAME_KIND_PLACE = 1;
+
+struct NamesFileHeader {
+    char magic[8];
+    uint32_t header_crc;
+    uint32_t n_names;
+    uint32_t n_blocks;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(NamesFileHeader) == 24, "Name index header must be 24 bytes");
+
+
+/*
+
+    Named object in mercator coordinates
+
+*/
+struct NamedObject {
+    std::string name;
+    uint8_t kind;
+    int32_t x, y;
+};
+
+inline std::string name_key(const std::string& name) {
+    std::string key = name;
+    for(char& c : key) {
+        if(c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    }
+    return key;
+}
+
+// Truncates a name without cutting a multi-byte UTF-8 character in half
+inline std::string truncate_name(const char* name) {
+    std::string s(name);
+    if(s.size() <= NAME_MAX_LENGTH) return s;
+    size_t length = NAME_MAX_LENGTH;
+    while(length > 0 && (s[length] & 0xC0) == 0x80) length--;
+    return s.substr(0, length);
+}
+
+
+/*
+
+    Handler to collect the names of highways and places. A highway is located at its middle node,
+    a place at its node. Requires node locations.
+
+*/
+struct NameHandler : public osmium::handler::Handler {
+
+    std::vector<NamedObject>& _names;
+
+    NameHandler(std::vector<NamedObject>& names) : _names(names) {};
+
+    void node(const osmium::Node& node) noexcept {
+        const char* place = node.tags()["place"];
+        const char* name = node.tags()["name"];
+        if(!place || !name || !node.location().valid()) return;
+        if(strcmp(place, "city") && strcmp(place, "town") && strcmp(place, "village") && strcmp(place, "hamlet")
+            && strcmp(place, "suburb") && strcmp(place, "quarter") && strcmp(place, "neighbourhood")) return;
+        _names.push_back({truncate_name(name), NAME_KIND_PLACE,
+            (int32_t) osmium::geom::detail::lon_to_x(node.location().lon()),
+            (int32_t) osmium::geom::detail::lat_to_y(node.location().lat())});
+    }
+
+    void way(const osmium::Way& way) noexcept {
+        const char* highway = way.tags()["highway"];
+        const char* name = way.tags()["name"];
+        if(!highway || !name || way.nodes().empty()) return;
+        const osmium::NodeRef& middle = way.nodes()[way.nodes().size()/2];
+        if(!middle.location().valid()) return;
+        _names.push_back({truncate_name(name), NAME_KIND_STREET,
+            (int32_t) osmium::geom::detail::lon_to_x(middle.lon()),
+            (int32_t) osmium::geom::detail::lat_to_y(middle.lat())});
+    }
+
+};
+
+
+/*
+
+    Reads the names of all highways and places of an OSM file. Needs one additional pass over the file.
+
+*/
+inline bool read_names(const char* input_path, std::vector<NamedObject>& names) {
+    const osmium::io::File input_file{input_path};
+    index_type index;
+    location_handler_type location_handler{index};
+    NameHandler handler(names);
+    osmium::io::Reader reader{input_file, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way};
+    osmium::apply(reader, location_handler, handler);
+    reader.close();
+    return true;
+}
+
+
+/*
+
+    Writes the name index for an existing map. Names outside of the map or on tiles that are not stored in a
+    sparse map are dropped. A street that is split into several ways is only stored once per tile.
+
+*/
+inline bool write_name_index(const std::vector<NamedObject>& names, const char* map_path, const char* output_path) {
+    MapFile map;
+    if(!map.open(map_path)) return false;
+    const MapHeader& header = map.header;
+    int64_t tile_size = header.tile_size;
+    // Positions are stored in local coordinates of their tile without quantization
+    if(tile_size > INT16_MAX) {
+        std::cout << "Error: Name indices can only be written for maps with a tile size of at most " << INT16_MAX << "\n";
+        return false;
+    }
+
+    struct Entry {
+        std::string key;
+        const NamedObject* object;
+        uint32_t tile_id;
+        int16_t x, y;
+    };
+    std::vector<Entry> entries;
+    for(const NamedObject& object : names) {
+        int64_t offset_x = (int64_t) object.x - header.map_x;
+        int64_t offset_y = (int64_t) object.y - header.map_y;
+        if(offset_x < 0 || offset_y < 0) continue;
+        int64_t tx = offset_x / tile_size;
+        int64_t ty = offset_y / tile_size;
+        if(tx >= (int64_t) header.n_x_tiles || ty >= (int64_t) header.n_y_tiles()) continue;
+        uint64_t tile_id = ty*header.n_x_tiles + tx;
+        if(map.version == 2 && map.entry_of(tile_id) < 0) continue;
+        entries.push_back({name_key(object.name), &object, (uint32_t) tile_id,
+            (int16_t) (offset_x - tx*tile_size), (int16_t) (offset_y - ty*tile_size)});
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        if(a.key != b.key) return a.key < b.key;
+        if(a.object->name != b.object->name) return a.object->name < b.object->name;
+        if(a.object->kind != b.object->kind) return a.object->kind < b.object->kind;
+        return a.tile_id < b.tile_id;
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.object->name == b.object->name && a.object->kind == b.object->kind && a.tile_id == b.tile_id;
+    }), entries.end());
+
+    // Front coding into blocks
+    std::vector<uint8_t> blocks;
+    std::vector<char> directory;
+    std::string prev;
+    uint64_t block_start = 0;
+    for(const Entry& entry : entries) {
+        const std::string& name = entry.object->name;
+        size_t shared = 0;
+        while(shared < prev.size() && shared < name.size() && prev[shared] == name[shared]) shared++;
+        // Start a new block if the entry does not fit. The first name of a block is stored completely.
+        if(blocks.empty() || blocks.size() + 2 + (name.size() - shared) + 9 > block_start + NAME_BLOCK_SIZE) {
+            blocks.resize(blocks.size() ? block_start + NAME_BLOCK_SIZE : 0, 0);
+            block_start = blocks.size();
+            shared = 0;
+            char key[NAME_KEY_SIZE] = {0};
+            memcpy(key, entry.key.data(), std::min<size_t>(entry.key.size(), NAME_KEY_SIZE));
+            directory.insert(directory.end(), key, key + NAME_KEY_SIZE);
+        }
+        blocks.push_back(shared);
+        blocks.push_back(name.size() - shared);
+        blocks.insert(blocks.end(), name.begin() + shared, name.end());
+        blocks.push_back(entry.object->kind);
+        uint8_t position[8];
+        memcpy(position, &entry.tile_id, 4);
+        memcpy(position + 4, &entry.x, 2);
+        memcpy(position + 6, &entry.y, 2);
+        blocks.insert(blocks.end(), position, position + 8);
+        prev = name;
+    }
+    if(!blocks.empty()) blocks.resize(block_start + NAME_BLOCK_SIZE, 0);
+
+    NamesFileHeader names_header;
+    memcpy(names_header.magic, NAMES_MAGIC, 8);
+    names_header.header_crc = crc32(&header, sizeof(MapHeader));
+    names_header.n_names = entries.size();
+    names_header.n_blocks = blocks.size() / NAME_BLOCK_SIZE;
+    names_header.reserved = 0;
+
+    FILE* file = fopen(output_path, "wb");
+    if(!file) {
+        std::cout << "Error: Could not open " << output_path << " for writing\n";
+        return false;
+    }
+    // Blocks are aligned to NAME_BLOCK_SIZE, so every block is a single sector on the SD-card
+    uint64_t directory_end = sizeof(NamesFileHeader) + directory.size();
+    std::vector<char> padding((NAME_BLOCK_SIZE - directory_end % NAME_BLOCK_SIZE) % NAME_BLOCK_SIZE, 0);
+    fwrite(&names_header, sizeof(NamesFileHeader), 1, file);
+    fwrite(directory.data(), 1, directory.size(), file);
+    fwrite(padding.data(), 1, padding.size(), file);
+    fwrite(blocks.data(), 1, blocks.size(), file);
+    fclose(file);
+
+    std::cout << "Names: \t\t\t\t" << names_header.n_names << " in " << names_header.n_blocks << " blocks\n";
+    return true;
+}
+
+#endif
@@ -0,0 +1,367 @@
+#ifndef ROUTING_GRAPH_H
+#define ROUTING_GRAPH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <osmium/handler.hpp>
+#include <osmium/visitor.hpp>
+#include <osmium/io/any_input.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <GeometryStore.hpp>
+#include <MapFile.hpp>
+#include <SimpleTrack.hpp>
+
+
+/*
+
+    Routing graph, a sidecar file with the highway network of a map in compressed sparse row (CSR) form.
+
+    Graph nodes are junctions (nodes shared by several ways and end points of ways) and the shape points of
+    the ways between them that are needed to follow the road within GRAPH_SHAPE_TOLERANCE meters. Nodes are
+    partitioned by a grid of partition_size x partition_size mercator units, aligned to the tiles of the map.
+    A node is referenced by its partition and its index within the partition.
+
+        header              GraphFileHeader (64 bytes)
+        partition offsets   (n_partitions + 1) * uint32, byte offset of each partition relative to the first partition.
+                            Partitions are numbered row by row, empty partitions have a size of 0.
+        partitions
+
+    Every partition consists of
+
+        n_nodes     uint32
+        n_edges     uint32
+        coords      n_nodes * {int32 x, int32 y}    global mercator coordinates
+        first_edge  (n_nodes + 1) * uint32          index of the first outgoing edge of each node
+        edges       n_edges * GraphEdge
+
+    Edge costs are the length in meters times class_cost[edge class] / 10. The device (routing.h) reads the
+    graph one partition at a time.
+
+*/
+#define GRAPH_MAGIC "STGRAPH1"
+
+// Maximum deviation of the graph from the original road in meters
+const double GRAPH_SHAPE_TOLERANCE = 10.0;
+// Edges are split such that their length fits into 16 bits
+const double GRAPH_MAX_EDGE_LENGTH = 60000.0;
+
+struct GraphFileHeader {
+    char magic[8];
+    uint32_t header_crc;
+    uint32_t n_partitions;
+    uint32_t n_x_partitions;
+    uint32_t partition_size;
+    int32_t origin_x;
+    int32_t origin_y;
+    uint32_t n_nodes;
+    uint32_t n_edges;
+    uint32_t max_partition_bytes;
+    uint32_t reserved;
+    uint8_t class_cost[16];
+};
+
+static_assert(sizeof(GraphFileHeader) == 64, "Graph file header must be 64 bytes");
+
+struct GraphEdge {
+    uint32_t partition;
+    uint16_t node;
+    uint16_t length;
+    uint8_t road_class;
+    uint8_t flags;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(GraphEdge) == 12, "Graph edge must be 12 bytes");
+
+
+/*
+
+    Road classes for bicycles. Class 0 is not routable. The cost factors (times 10) are written into the header.
+
+*/
+enum RoadClass : uint8_t {
+    ROAD_NONE = 0,
+    ROAD_CYCLEWAY,
+    ROAD_PATH,
+    ROAD_TRACK,
+    ROAD_RESIDENTIAL,
+    ROAD_TERTIARY,
+    ROAD_SECONDARY,
+    ROAD_PRIMARY,
+    ROAD_FOOTWAY,
+    ROAD_STEPS
+};
+
+const uint8_t ROAD_CLASS_COST[16] = {0, 10, 13, 14, 10, 12, 15, 20, 25, 60, 0, 0, 0, 0, 0, 0};
+
+// The class byte of a highway additionally stores its direction
+const uint8_t ROAD_ONEWAY_FORWARD = 0x10;
+const uint8_t ROAD_ONEWAY_BACKWARD = 0x20;
+
+inline uint8_t road_class(const osmium::TagList& tags) {
+    const char* highway = tags["highway"];
+    if(!highway) return ROAD_NONE;
+    const char* bicycle = tags["bicycle"];
+    const char* access = tags["access"];
+    if(bicycle && !strcmp(bicycle, "no")) return ROAD_NONE;
+    if(access && (!strcmp(access, "no") || !strcmp(access, "private")) && !(bicycle && !strcmp(bicycle, "yes"))) return ROAD_NONE;
+
+    std::string hw(highway);
+    if(hw.size() > 5 && hw.compare(hw.size() - 5, 5, "_link") == 0) hw = hw.substr(0, hw.size() - 5);
+    uint8_t cls = ROAD_NONE;
+    if(hw == "cycleway") cls = ROAD_CYCLEWAY;
+    else if(hw == "path" || hw == "bridleway") cls = ROAD_PATH;
+    else if(hw == "track") cls = ROAD_TRACK;
+    else if(hw == "residential" || hw == "living_street" || hw == "unclassified" || hw == "service" || hw == "road") cls = ROAD_RESIDENTIAL;
+    else if(hw == "tertiary") cls = ROAD_TERTIARY;
+    else if(hw == "secondary") cls = ROAD_SECONDARY;
+    else if(hw == "primary") cls = ROAD_PRIMARY;
+    else if(hw == "footway" || hw == "pedestrian") cls = ROAD_FOOTWAY;
+    else if(hw == "steps") cls = ROAD_STEPS;
+    if(cls == ROAD_NONE) return ROAD_NONE;
+
+    const char* oneway = tags["oneway"];
+    const char* junction = tags["junction"];
+    const char* oneway_bicycle = tags["oneway:bicycle"];
+    if(oneway_bicycle && !strcmp(oneway_bicycle, "no")) return cls;
+    if(oneway && !strcmp(oneway, "-1")) return cls | ROAD_ONEWAY_BACKWARD;
+    if((oneway && (!strcmp(oneway, "yes") || !strcmp(oneway, "true") || !strcmp(oneway, "1")))
+        || (junction && !strcmp(junction, "roundabout"))) return cls | ROAD_ONEWAY_FORWARD;
+    return cls;
+}
+
+
+/*
+
+    Handler to collect the road class of every highway in the same order as the highways of a geometry store
+
+*/
+struct RoadClassHandler : public osmium::handler::Handler {
+
+    std::vector<uint8_t>& _classes;
+
+    RoadClassHandler(std::vector<uint8_t>& classes) : _classes(classes) {};
+
+    void way(const osmium::Way& way) noexcept {
+        if(way.tags()["highway"]) {
+            _classes.push_back(road_class(way.tags()));
+        }
+    }
+
+};
+
+// Only reads the ways, node locations are not needed
+inline bool read_road_classes(const char* input_path, std::vector<uint8_t>& classes) {
+    osmium::io::Reader reader{input_path, osmium::osm_entity_bits::way};
+    RoadClassHandler handler(classes);
+    osmium::apply(reader, handler);
+    reader.close();
+    return true;
+}
+
+// Distance in meters between two points in mercator coordinates
+inline double mercator_distance(double x0, double y0, double x1, double y1) {
+    double lat = std::atan(std::sinh((y0 + y1) / 2 / 6378137.0));
+    return std::sqrt((x1 - x0)*(x1 - x0) + (y1 - y0)*(y1 - y0)) * std::cos(lat);
+}
+
+
+/*
+
+    Writes the routing graph of a geometry store (with OSM IDs) for an existing map. classes contains the
+    road class of every highway of the store. Partitions are partition_tiles x partition_tiles tiles of the map.
+
+*/
+inline bool write_routing_graph(const GeometryStore& store, const std::vector<uint8_t>& classes, const char* map_path,
+    const char* output_path, uint64_t partition_tiles = 2) {
+
+    if(!store.node_ids) {
+        std::cout << "Error: The routing graph requires the OSM IDs of all nodes\n";
+        return false;
+    }
+    if(classes.size() != store.n_highways) {
+        std::cout << "Error: Road classes do not match the geometry store\n";
+        return false;
+    }
+    MapFile map;
+    if(!map.open(map_path)) return false;
+    const MapHeader& header = map.header;
+
+    // Junctions: nodes referenced more than once by routable ways and end points of ways
+    std::unordered_map<int64_t, uint32_t> references;
+    for(uint64_t hw_id=0; hw_id<store.n_highways; hw_id++) {
+        if(!(classes[hw_id] & 0x0F)) continue;
+        uint64_t begin = store.way_begin(hw_id);
+        uint64_t end = store.way_end(hw_id);
+        for(uint64_t i=begin; i<end; i++) {
+            references[store.node_ids[i]] += (i == begin || i + 1 == end) ? 2 : 1;
+        }
+    }
+
+    // Graph nodes are identified by their OSM ID
+    struct Node {
+        int32_t x, y;
+        uint32_t partition;
+        uint32_t local;
+    };
+    struct Link {
+        uint32_t from, to;
+        uint16_t length;
+        uint8_t road_class;
+    };
+    std::vector<Node> nodes;
+    std::vector<Link> links;
+    std::unordered_map<int64_t, uint32_t> node_index;
+    auto graph_node = [&](uint64_t i) {
+        auto it = node_index.find(store.node_ids[i]);
+        if(it != node_index.end()) return it->second;
+        uint32_t id = nodes.size();
+        node_index[store.node_ids[i]] = id;
+        nodes.push_back({store.node_x_coords[i], store.node_y_coords[i], 0, 0});
+        return id;
+    };
+
+    std::vector<TrackPoint> points;
+    for(uint64_t hw_id=0; hw_id<store.n_highways; hw_id++) {
+        uint8_t cls = classes[hw_id] & 0x0F;
+        if(!cls) continue;
+        uint64_t begin = store.way_begin(hw_id);
+        uint64_t end = store.way_end(hw_id);
+        uint64_t a = begin;
+        for(uint64_t b=begin+1; b<end; b++) {
+            if(references[store.node_ids[b]] < 2) continue;
+            // Section between two junctions, simplified to the shape points that are needed
+            points.clear();
+            for(uint64_t i=a; i<=b; i++) {
+                double y = store.node_y_coords[i];
+                points.push_back({(double) store.node_x_coords[i], y, std::atan(std::sinh(y / 6378137.0)) * 180.0 / M_PI});
+            }
+            std::vector<bool> keep(points.size(), false);
+            for(size_t k : simplify_track(points, GRAPH_SHAPE_TOLERANCE)) keep[k] = true;
+            uint32_t prev = graph_node(a);
+            double length = 0;
+            for(size_t i=1; i<points.size(); i++) {
+                length += mercator_distance(points[i-1].x, points[i-1].y, points[i].x, points[i].y);
+                if(!keep[i] && length < GRAPH_MAX_EDGE_LENGTH) continue;
+                uint32_t next = graph_node(a + i);
+                if(next != prev) {
+                    uint16_t meters = std::max(1.0, std::round(std::min(length, 65535.0)));
+                    if(!(classes[hw_id] & ROAD_ONEWAY_BACKWARD)) links.push_back({prev, next, meters, cls});
+                    if(!(classes[hw_id] & ROAD_ONEWAY_FORWARD)) links.push_back({next, prev, meters, cls});
+                }
+                prev = next;
+                length = 0;
+            }
+            a = b;
+        }
+    }
+
+    // Partition grid aligned to the tiles of the map
+    uint64_t partition_size = header.tile_size * partition_tiles;
+    uint64_t n_x_partitions = (header.n_x_tiles + partition_tiles - 1) / partition_tiles;
+    uint64_t n_y_partitions = (header.n_y_tiles() + partition_tiles - 1) / partition_tiles;
+    uint64_t n_partitions = n_x_partitions * n_y_partitions;
+    if(n_partitions > UINT32_MAX - 1) {
+        std::cout << "Error: Invalid partition size for the routing graph\n";
+        return false;
+    }
+    std::vector<uint32_t> partition_nodes(n_partitions, 0);
+    for(Node& node : nodes) {
+        int64_t px = std::min<int64_t>(std::max<int64_t>((node.x - header.map_x) / (int64_t) partition_size, 0), n_x_partitions - 1);
+        int64_t py = std::min<int64_t>(std::max<int64_t>((node.y - header.map_y) / (int64_t) partition_size, 0), n_y_partitions - 1);
+        node.partition = py*n_x_partitions + px;
+        node.local = partition_nodes[node.partition]++;
+        if(node.local > UINT16_MAX) {
+            std::cout << "Error: Too many graph nodes in one partition, use smaller partitions\n";
+            return false;
+        }
+    }
+
+    // Sort edges by partition and node of their source, so each partition is one CSR block
+    std::sort(links.begin(), links.end(), [&nodes](const Link& l, const Link& r) {
+        const Node& a = nodes[l.from];
+        const Node& b = nodes[r.from];
+        if(a.partition != b.partition) return a.partition < b.partition;
+        return a.local < b.local;
+    });
+    std::vector<std::vector<uint32_t>> partition_members(n_partitions);
+    for(uint32_t i=0; i<nodes.size(); i++) partition_members[nodes[i].partition].push_back(i);
+
+    GraphFileHeader graph_header;
+    memset(&graph_header, 0, sizeof(GraphFileHeader));
+    memcpy(graph_header.magic, GRAPH_MAGIC, 8);
+    graph_header.header_crc = crc32(&header, sizeof(MapHeader));
+    graph_header.n_partitions = n_partitions;
+    graph_header.n_x_partitions = n_x_partitions;
+    graph_header.partition_size = partition_size;
+    graph_header.origin_x = header.map_x;
+    graph_header.origin_y = header.map_y;
+    graph_header.n_nodes = nodes.size();
+    graph_header.n_edges = links.size();
+    memcpy(graph_header.class_cost, ROAD_CLASS_COST, 16);
+
+    std::vector<uint32_t> offsets(n_partitions + 1, 0);
+    std::vector<uint8_t> data;
+    size_t link_idx = 0;
+    for(uint64_t p=0; p<n_partitions; p++) {
+        offsets[p] = data.size();
+        const std::vector<uint32_t>& members = partition_members[p];
+        if(members.empty()) continue;
+        std::vector<uint32_t> counts(2);
+        std::vector<int32_t> coords;
+        std::vector<uint32_t> first_edge;
+        std::vector<GraphEdge> edges;
+        for(uint32_t node_id : members) {
+            coords.push_back(nodes[node_id].x);
+            coords.push_back(nodes[node_id].y);
+            first_edge.push_back(edges.size());
+            while(link_idx < links.size() && links[link_idx].from == node_id) {
+                const Link& link = links[link_idx++];
+                const Node& target = nodes[link.to];
+                edges.push_back({target.partition, (uint16_t) target.local, link.length, link.road_class, 0, 0});
+            }
+        }
+        first_edge.push_back(edges.size());
+        counts[0] = members.size();
+        counts[1] = edges.size();
+        size_t start = data.size();
+        auto append = [&data](const void* src, size_t n) {
+            data.insert(data.end(), (const uint8_t*) src, (const uint8_t*) src + n);
+        };
+        append(counts.data(), 2*sizeof(uint32_t));
+        append(coords.data(), coords.size()*sizeof(int32_t));
+        append(first_edge.data(), first_edge.size()*sizeof(uint32_t));
+        append(edges.data(), edges.size()*sizeof(GraphEdge));
+        graph_header.max_partition_bytes = std::max<uint64_t>(graph_header.max_partition_bytes, data.size() - start);
+    }
+    offsets[n_partitions] = data.size();
+    if(data.size() > UINT32_MAX) {
+        std::cout << "Error: Routing graph is too large\n";
+        return false;
+    }
+
+    FILE* file = fopen(output_path, "wb");
+    if(!file) {
+        std::cout << "Error: Could not open " << output_path << " for writing\n";
+        return false;
+    }
+    fwrite(&graph_header, sizeof(GraphFileHeader), 1, file);
+    fwrite(offsets.data(), sizeof(uint32_t), offsets.size(), file);
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+
+    std::cout << "Graph nodes: \t\t\t" << graph_header.n_nodes << "\n";
+    std::cout << "Graph edges: \t\t\t" << graph_header.n_edges << "\n";
+    std::cout << "Largest partition: \t\t" << graph_header.max_partition_bytes << " bytes\n";
+    return true;
+}
+
+#endif
@@ -0,0 +1,393 @@
+#ifndef SIMPLE_TRACK_H
+#define SIMPLE_TRACK_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <Gpx.hpp>
+#include <MapFile.hpp>
+#include <TileWriter.hpp>
+
+
+/*
+
+    Binary track file, compiled from a GPX file for one specific map. The device loads it with a single read.
+
+        magic       char[8]     "STTRACK1"
+        header_crc  uint32      CRC32 of the 80 byte map header (version 1 fields) the track was compiled for
+        n_points    uint32      number of points
+        n_runs      uint32      number of runs
+        n_cues      uint32      number of turn cues (zero in older files)
+        runs        n_runs * {uint32 tile_id, uint32 first_point}
+        points      n_points * {int16 x, int16 y}
+        cues        n_cues * {uint32 distance, int16 angle, int8 turn, uint8 reserved}
+
+    A run is a sequence of consecutive points on the same tile. The first point of each run is stored in local
+    coordinates of its tile, every following point of the run as the difference to the previous point.
+
+    A turn cue marks a junction of the map at which the track changes its direction. The distance is measured
+    in meters along the stored points from the first point, so the device can compare it with its own position
+    along the track. The angle is the change of bearing in degrees (positive to the left), turn its class
+    (see TURN_*, negative to the left). Cues are sorted by distance.
+
+*/
+#define TRACK_MAGIC "STTRACK1"
+
+struct TrackFileHeader {
+    char magic[8];
+    uint32_t header_crc;
+    uint32_t n_points;
+    uint32_t n_runs;
+    uint32_t n_cues;
+};
+
+static_assert(sizeof(TrackFileHeader) == 24, "Track file header must be 24 bytes");
+
+struct TrackRun {
+    uint32_t tile_id;
+    uint32_t first_point;
+};
+
+struct TrackCue {
+    uint32_t distance;
+    int16_t angle;
+    int8_t turn;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(TrackCue) == 8, "Turn cue must be 8 bytes");
+
+// Angle classes of a turn cue, negative for turns to the left
+const int8_t TURN_SLIGHT = 1;
+const int8_t TURN_NORMAL = 2;
+const int8_t TURN_SHARP = 3;
+const int8_t TURN_UTURN = 4;
+
+// Maximum distance of a junction to the track in meters
+const double CUE_JUNCTION_RADIUS = 15.0;
+// Distance before and after a junction over which the bearing of the track is measured, in meters
+const double CUE_BEARING_DISTANCE = 20.0;
+// Smallest change of bearing that counts as a turn, in degrees
+const double CUE_MIN_ANGLE = 30.0;
+// Of two cues closer than this, only the sharper turn is kept, in meters
+const double CUE_MIN_SPACING = 25.0;
+
+
+/*
+
+    Douglas-Peucker simplification. Returns the indices of all points that are kept. The tolerance is given
+    in meters and converted to mercator units at the latitude of each segment.
+
+*/
+inline std::vector<size_t> simplify_track(const std::vector<TrackPoint>& points, double tolerance) {
+    std::vector<bool> keep(points.size(), false);
+    keep.front() = true;
+    keep.back() = true;
+    std::vector<std::pair<size_t, size_t>> stack;
+    if(points.size() > 2) stack.push_back({0, points.size() - 1});
+    while(!stack.empty()) {
+        size_t first = stack.back().first;
+        size_t last = stack.back().second;
+        stack.pop_back();
+        const TrackPoint& a = points[first];
+        const TrackPoint& b = points[last];
+        double dx = b.x - a.x;
+        double dy = b.y - a.y;
+        double len = std::sqrt(dx*dx + dy*dy);
+        double max_dist = -1;
+        size_t max_idx = first;
+        for(size_t i=first+1; i<last; i++) {
+            double px = points[i].x - a.x;
+            double py = points[i].y - a.y;
+            double dist = len > 0 ? std::fabs(px*dy - py*dx) / len : std::sqrt(px*px + py*py);
+            if(dist > max_dist) {
+                max_dist = dist;
+                max_idx = i;
+            }
+        }
+        if(max_dist > tolerance / std::cos(a.lat * M_PI / 180.0)) {
+            keep[max_idx] = true;
+            if(max_idx - first > 1) stack.push_back({first, max_idx});
+            if(last - max_idx > 1) stack.push_back({max_idx, last});
+        }
+    }
+    std::vector<size_t> indices;
+    for(size_t i=0; i<points.size(); i++) {
+        if(keep[i]) indices.push_back(i);
+    }
+    return indices;
+}
+
+
+/*
+
+    Junctions of the map on and around the given tiles in global mercator coordinates. A junction is a node with
+    at least three distinct neighbours. Ways are clipped to the tiles, so the neighbours of a node are collected
+    from all tiles around the given ones.
+
+*/
+inline std::vector<std::pair<int64_t, int64_t>> map_junctions(const MapFile& map, const std::vector<uint64_t>& tiles) {
+    const MapHeader& header = map.header;
+    int64_t tile_size = header.tile_size;
+    int64_t n_x_tiles = header.n_x_tiles;
+    int64_t n_y_tiles = header.n_y_tiles();
+    std::vector<uint64_t> around;
+    for(uint64_t tile_id : tiles) {
+        int64_t tx = tile_id % n_x_tiles;
+        int64_t ty = tile_id / n_x_tiles;
+        for(int64_t y=std::max<int64_t>(ty-1, 0); y<=std::min(ty+1, n_y_tiles-1); y++) {
+            for(int64_t x=std::max<int64_t>(tx-1, 0); x<=std::min(tx+1, n_x_tiles-1); x++) {
+                around.push_back(y*n_x_tiles + x);
+            }
+        }
+    }
+    std::sort(around.begin(), around.end());
+    around.erase(std::unique(around.begin(), around.end()), around.end());
+
+    // Global mercator coordinates fit into 32 bits
+    auto key = [](int64_t x, int64_t y) {
+        return ((uint64_t) (uint32_t) x << 32) | (uint32_t) y;
+    };
+    std::unordered_map<uint64_t, std::vector<uint64_t>> neighbours;
+    auto link = [&neighbours](uint64_t a, uint64_t b) {
+        std::vector<uint64_t>& n = neighbours[a];
+        if(std::find(n.begin(), n.end(), b) == n.end()) n.push_back(b);
+    };
+    for(uint64_t tile_id : around) {
+        if(map.version == 2 && map.entry_of(tile_id) < 0) continue;
+        const int16_t* data = map.tile(tile_id);
+        uint64_t n_values = map.tile_size(tile_id) / sizeof(int16_t);
+        int64_t origin_x = header.map_x + (int64_t) (tile_id % n_x_tiles) * tile_size;
+        int64_t origin_y = header.map_y + (int64_t) (tile_id / n_x_tiles) * tile_size;
+        uint8_t shift = map.tile_shift(tile_id);
+        bool has_prev = false;
+        uint64_t prev = 0;
+        for(uint64_t i=0; i+1<n_values; i+=2) {
+            // Way separator
+            if(data[i] == 0 && data[i+1] == 0) {
+                has_prev = false;
+                continue;
+            }
+            uint64_t node = key(origin_x + ((int64_t) data[i] << shift), origin_y + ((int64_t) data[i+1] << shift));
+            if(has_prev && node != prev) {
+                link(prev, node);
+                link(node, prev);
+            }
+            prev = node;
+            has_prev = true;
+        }
+    }
+
+    std::vector<std::pair<int64_t, int64_t>> junctions;
+    for(const auto& node : neighbours) {
+        if(node.second.size() < 3) continue;
+        junctions.push_back({(int32_t) (node.first >> 32), (int32_t) (node.first & 0xFFFFFFFF)});
+    }
+    return junctions;
+}
+
+
+/*
+
+    Finds the turns of a track. The track has to be given as it is stored, since the distances of the cues
+    are measured along these points. Every junction of the map close to the track is a candidate. If the
+    bearing of the track changes by at least CUE_MIN_ANGLE around the junction, a cue is created.
+
+*/
+inline std::vector<TrackCue> find_turn_cues(const MapFile& map, const std::vector<TrackPoint>& track) {
+    std::vector<TrackCue> cues;
+    if(track.size() < 3) return cues;
+    const MapHeader& header = map.header;
+
+    // Distance along the track in meters, scaled at the start of each segment like on the device
+    std::vector<double> along(track.size(), 0);
+    for(size_t i=1; i<track.size(); i++) {
+        along[i] = along[i-1] + std::hypot(track[i].x - track[i-1].x, track[i].y - track[i-1].y) * std::cos(track[i-1].lat * M_PI / 180.0);
+    }
+
+    // Tiles along the track
+    std::vector<uint64_t> tiles;
+    for(size_t i=0; i+1<track.size(); i++) {
+        double r = CUE_JUNCTION_RADIUS / std::cos(track[i].lat * M_PI / 180.0);
+        BoundingBox box(std::floor(std::min(track[i].x, track[i+1].x) - r), std::floor(std::min(track[i].y, track[i+1].y) - r),
+            std::ceil(std::max(track[i].x, track[i+1].x) + r), std::ceil(std::max(track[i].y, track[i+1].y) + r));
+        TileRange range(box, header);
+        for(int64_t ty=range.y0; ty<=range.y1; ty++) {
+            for(int64_t tx=range.x0; tx<=range.x1; tx++) {
+                tiles.push_back(ty*header.n_x_tiles + tx);
+            }
+        }
+    }
+    std::sort(tiles.begin(), tiles.end());
+    tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+    std::vector<std::pair<int64_t, int64_t>> junctions = map_junctions(map, tiles);
+
+    // Grid of junctions with cells of the tile size
+    int64_t cell_size = header.tile_size;
+    auto cell_of = [cell_size](double offset) {
+        return (int64_t) std::floor(offset / cell_size);
+    };
+    auto cell = [](int64_t cx, int64_t cy) {
+        return ((uint64_t) (uint32_t) cx << 32) | (uint32_t) cy;
+    };
+    std::unordered_map<uint64_t, std::vector<size_t>> grid;
+    for(size_t j=0; j<junctions.size(); j++) {
+        grid[cell(cell_of(junctions[j].first - header.map_x), cell_of(junctions[j].second - header.map_y))].push_back(j);
+    }
+
+    // Position along the track of every junction close to a segment
+    std::vector<double> candidates;
+    for(size_t i=0; i+1<track.size(); i++) {
+        const TrackPoint& a = track[i];
+        const TrackPoint& b = track[i+1];
+        double r = CUE_JUNCTION_RADIUS / std::cos(a.lat * M_PI / 180.0);
+        double dx = b.x - a.x;
+        double dy = b.y - a.y;
+        double len2 = dx*dx + dy*dy;
+        int64_t cx0 = cell_of(std::min(a.x, b.x) - r - header.map_x);
+        int64_t cy0 = cell_of(std::min(a.y, b.y) - r - header.map_y);
+        int64_t cx1 = cell_of(std::max(a.x, b.x) + r - header.map_x);
+        int64_t cy1 = cell_of(std::max(a.y, b.y) + r - header.map_y);
+        for(int64_t cy=cy0; cy<=cy1; cy++) {
+            for(int64_t cx=cx0; cx<=cx1; cx++) {
+                auto it = grid.find(cell(cx, cy));
+                if(it == grid.end()) continue;
+                for(size_t j : it->second) {
+                    double px = junctions[j].first - a.x;
+                    double py = junctions[j].second - a.y;
+                    double t = len2 > 0 ? std::min(1.0, std::max(0.0, (px*dx + py*dy) / len2)) : 0;
+                    if(std::hypot(px - t*dx, py - t*dy) > r) continue;
+                    candidates.push_back(along[i] + t*(along[i+1] - along[i]));
+                }
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    // Position on the track at a distance along it
+    auto point_at = [&track, &along](double d, double& x, double& y) {
+        size_t i = std::upper_bound(along.begin(), along.end(), d) - along.begin();
+        i = std::min(std::max<size_t>(i, 1), track.size() - 1);
+        double t = along[i] > along[i-1] ? std::min(1.0, std::max(0.0, (d - along[i-1]) / (along[i] - along[i-1]))) : 0;
+        x = track[i-1].x + t*(track[i].x - track[i-1].x);
+        y = track[i-1].y + t*(track[i].y - track[i-1].y);
+    };
+
+    double prev_candidate = -1;
+    for(double d : candidates) {
+        // The same junction is usually found on two neighbouring segments
+        if(prev_candidate >= 0 && d - prev_candidate < 1.0) continue;
+        prev_candidate = d;
+        if(d < CUE_BEARING_DISTANCE || d > along.back() - CUE_BEARING_DISTANCE) continue;
+        double x0, y0, x1, y1, x2, y2;
+        point_at(d - CUE_BEARING_DISTANCE, x0, y0);
+        point_at(d, x1, y1);
+        point_at(d + CUE_BEARING_DISTANCE, x2, y2);
+        // Counterclockwise angle from the incoming to the outgoing direction, positive to the left
+        double angle = std::atan2((x1 - x0)*(y2 - y1) - (y1 - y0)*(x2 - x1), (x1 - x0)*(x2 - x1) + (y1 - y0)*(y2 - y1)) * 180.0 / M_PI;
+        double magnitude = std::fabs(angle);
+        if(magnitude < CUE_MIN_ANGLE) continue;
+        int8_t turn = magnitude < 60 ? TURN_SLIGHT : magnitude < 120 ? TURN_NORMAL : magnitude < 160 ? TURN_SHARP : TURN_UTURN;
+        TrackCue cue = {(uint32_t) std::lround(d), (int16_t) std::lround(angle), (int8_t) (angle > 0 ? -turn : turn), 0};
+        if(!cues.empty() && d - cues.back().distance < CUE_MIN_SPACING) {
+            if(std::abs(cue.angle) > std::abs(cues.back().angle)) cues.back() = cue;
+            continue;
+        }
+        cues.push_back(cue);
+    }
+    return cues;
+}
+
+
+/*
+
+    Compiles a track for a map and writes the binary track file. Points outside of the map are dropped.
+    Turn cues are found on the junctions of the map.
+
+*/
+inline bool compile_track(const MapFile& map, const std::vector<TrackPoint>& points, double tolerance, const char* output_path) {
+    const MapHeader& header = map.header;
+    // Track points are stored in local coordinates of their tile without quantization
+    if(header.tile_size > INT16_MAX) {
+        std::cout << "Error: Tracks can only be compiled for maps with a tile size of at most " << INT16_MAX << "\n";
+        return false;
+    }
+    std::vector<size_t> kept = simplify_track(points, tolerance);
+    // Stored points in global coordinates
+    std::vector<TrackPoint> stored;
+
+    std::vector<TrackRun> runs;
+    std::vector<int16_t> coords;
+    int64_t tile_size = header.tile_size;
+    int64_t prev_tile = -1;
+    int16_t prev_x = 0, prev_y = 0;
+    uint64_t n_outside = 0;
+    for(size_t idx : kept) {
+        int64_t offset_x = (int64_t) std::floor(points[idx].x) - header.map_x;
+        int64_t offset_y = (int64_t) std::floor(points[idx].y) - header.map_y;
+        int64_t tx = offset_x >= 0 ? offset_x / tile_size : -1;
+        int64_t ty = offset_y >= 0 ? offset_y / tile_size : -1;
+        if(tx < 0 || ty < 0 || tx >= (int64_t) header.n_x_tiles || ty >= (int64_t) header.n_y_tiles()) {
+            n_outside++;
+            prev_tile = -1;
+            continue;
+        }
+        int64_t tile_id = ty*header.n_x_tiles + tx;
+        int16_t x = offset_x - tx*tile_size;
+        int16_t y = offset_y - ty*tile_size;
+        stored.push_back({(double) (offset_x + header.map_x), (double) (offset_y + header.map_y), points[idx].lat});
+        if(tile_id != prev_tile) {
+            runs.push_back({(uint32_t) tile_id, (uint32_t) (coords.size()/2)});
+            coords.push_back(x);
+            coords.push_back(y);
+        } else {
+            // Both points lie on the same tile, so the difference always fits into 16 bits
+            coords.push_back(x - prev_x);
+            coords.push_back(y - prev_y);
+        }
+        prev_tile = tile_id;
+        prev_x = x;
+        prev_y = y;
+    }
+
+    if(n_outside) {
+        std::cout << "Warning: Dropped " << n_outside << " points outside of the map\n";
+    }
+    if(runs.empty()) {
+        std::cout << "Error: The track does not overlap with the map\n";
+        return false;
+    }
+    std::vector<TrackCue> cues = find_turn_cues(map, stored);
+
+    TrackFileHeader track_header;
+    memcpy(track_header.magic, TRACK_MAGIC, 8);
+    track_header.header_crc = crc32(&header, sizeof(MapHeader));
+    track_header.n_points = coords.size()/2;
+    track_header.n_runs = runs.size();
+    track_header.n_cues = cues.size();
+
+    FILE* file = fopen(output_path, "wb");
+    if(!file) {
+        std::cout << "Error: Could not open " << output_path << " for writing\n";
+        return false;
+    }
+    fwrite(&track_header, sizeof(TrackFileHeader), 1, file);
+    fwrite(runs.data(), sizeof(TrackRun), runs.size(), file);
+    fwrite(coords.data(), sizeof(int16_t), coords.size(), file);
+    fwrite(cues.data(), sizeof(TrackCue), cues.size(), file);
+    fclose(file);
+
+    std::cout << "GPX points: \t\t\t" << points.size() << "\n";
+    std::cout << "Simplified points: \t\t" << track_header.n_points << "\n";
+    std::cout << "Runs: \t\t\t\t" << track_header.n_runs << "\n";
+    std::cout << "Turn cues: \t\t\t" << track_header.n_cues << "\n";
+    return true;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef STORE_CONVERSION_H
+#define STORE_CONVERSION_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <osmium/visitor.hpp>
+#include <osmium/io/any_input.hpp>
+#include <osmium/index/map/flex_mem.hpp>
+#include <osmium/handler/node_locations_for_ways.hpp>
+
+#include <CustomHandlers.hpp>
+#include <GeometryStore.hpp>
+#include <MapFile.hpp>
+#include <Tile.hpp>
+#include <TileWriter.hpp>
+
+using index_type = osmium::index::map::FlexMem<osmium::unsigned_object_id_type, osmium::Location>;
+using location_handler_type = osmium::handler::NodeLocationsForWays<index_type>;
+
+
+/*
+
+    Reads the projected geometry of all highways of an OSM file into a geometry store.
+    Needs two passes over the file: one for the statistics and one for the coordinates.
+
+*/
+inline bool read_geometry(const char* input_path, GeometryStore& store, bool with_ids) {
+    const osmium::io::File input_file{input_path};
+    index_type index;
+    location_handler_type location_handler{index};
+
+    StatHandler stats;
+    osmium::io::Reader reader{input_file, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way};
+    osmium::apply(reader, location_handler, stats);
+    reader.close();
+    location_handler.clear();
+
+    if(!store.allocate(stats.highways, stats.all_way_node_count, with_ids)) return false;
+    store.map_x = stats.min_x;
+    store.map_y = stats.min_y;
+    store.map_width = stats.max_x - stats.min_x;
+    store.map_height = stats.max_y - stats.min_y;
+    store.n_ways = stats.ways;
+
+    osmium::io::Reader reader2{input_file, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way};
+    MercatorConverter mercConv(store.node_x_coords, store.node_y_coords, store.highway_indices, store.way_ids, store.node_ids);
+    osmium::apply(reader2, location_handler, mercConv);
+    reader2.close();
+    return true;
+}
+
+
+/*
+
+    Writes a map with the given tile size from a geometry store. Uses the same tile layout and the same
+    order of highways within a tile as the conversion in main.cpp.
+
+*/
+inline bool write_map(const GeometryStore& store, uint64_t tile_size, const char* output_path) {
+    MapHeader header;
+    header.map_x = store.map_x;
+    header.map_y = store.map_y;
+    header.map_width = store.map_width;
+    header.map_height = store.map_height;
+    header.n_x_tiles = std::max<uint64_t>(ceil((double) store.map_width/tile_size), 1);
+    header.tile_size = tile_size;
+    header.n_tiles = header.n_x_tiles * std::max<uint64_t>(ceil((double) store.map_height/tile_size), 1);
+    header.max_nodes = 0;
+    header.n_nodes = 0;
+    header.n_ways = store.n_ways;
+
+    // First pass over all highways: size of each tile in BYTE count and extent of its local coordinates
+    std::vector<uint64_t> tile_sizes(header.n_tiles, 0);
+    std::vector<int64_t> extents(header.n_tiles, 0);
+    for(uint64_t hw_id=0; hw_id<store.n_highways; hw_id++) {
+        TileRange range(store.way_box(hw_id), header);
+        for(int64_t ty=range.y0; ty<=range.y1; ty++) {
+            for(int64_t tx=range.x0; tx<=range.x1; tx++) {
+                uint64_t tile_id = ty*header.n_x_tiles + tx;
+                Tile tile(tile_id, tile_size, header.n_x_tiles, header.map_x, header.map_y);
+                tile_sizes[tile_id] += sizeof(int16_t)*write_way_on_tile(tile, store.node_x_coords, store.node_y_coords,
+                    store.way_begin(hw_id), store.way_end(hw_id), nullptr, &extents[tile_id]);
+            }
+        }
+    }
+    std::vector<uint8_t> shifts(header.n_tiles);
+    uint64_t n_shifted = 0;
+    for(uint64_t tile_id=0; tile_id<header.n_tiles; tile_id++) {
+        shifts[tile_id] = shift_for_extent(extents[tile_id]);
+        if(shifts[tile_id]) n_shifted++;
+    }
+
+    std::vector<uint64_t> pointers(header.n_tiles, 0);
+    uint64_t byte_tiles = 0;
+    for(uint64_t tile_id=0; tile_id<header.n_tiles; tile_id++) {
+        pointers[tile_id] = byte_tiles;
+        byte_tiles += tile_sizes[tile_id];
+        header.max_nodes = std::max<uint64_t>(header.max_nodes, tile_sizes[tile_id]/(2*sizeof(int16_t)));
+    }
+
+    // Second pass: write all tiles into one buffer
+    int16_t* buffer_tiles = (int16_t*) calloc(byte_tiles ? byte_tiles : 1, sizeof(char));
+    if(!buffer_tiles) {
+        std::cout << "Error: Could not allocate memory for " << output_path << "\n";
+        return false;
+    }
+    std::vector<uint64_t> offsets(pointers);
+    for(uint64_t hw_id=0; hw_id<store.n_highways; hw_id++) {
+        TileRange range(store.way_box(hw_id), header);
+        for(int64_t ty=range.y0; ty<=range.y1; ty++) {
+            for(int64_t tx=range.x0; tx<=range.x1; tx++) {
+                uint64_t tile_id = ty*header.n_x_tiles + tx;
+                Tile tile(tile_id, tile_size, header.n_x_tiles, header.map_x, header.map_y);
+                tile.shift = shifts[tile_id];
+                offsets[tile_id] += sizeof(int16_t)*write_way_on_tile(tile, store.node_x_coords, store.node_y_coords,
+                    store.way_begin(hw_id), store.way_end(hw_id), buffer_tiles + offsets[tile_id]/sizeof(int16_t));
+            }
+        }
+    }
+
+    // Coordinate pairs of all tiles, including separators
+    header.n_nodes = byte_tiles/(2*sizeof(int16_t));
+
+    if(n_shifted) {
+        std::cout << "Quantized tiles: \t\t" << n_shifted << "\n";
+    }
+    MapFileWriter writer;
+    if(!writer.open(output_path, header, tile_sizes, shifts)) {
+        free(buffer_tiles);
+        return false;
+    }
+    // The tiles are contiguous in the buffer and written at once
+    writer.write_tile(buffer_tiles, byte_tiles);
+    writer.close();
+    free(buffer_tiles);
+    return true;
+}
+
+#endif
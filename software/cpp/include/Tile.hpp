@@ -1,6 +1,9 @@
 #ifndef CUSTOM_TILE_H
 #define CUSTOM_TILE_H
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <BoundingBox.hpp>
 
 /*
@@ -19,6 +22,8 @@ public:
     int _tile_idx, _tile_size, _n_tiles_x;
     // Origin of map (lower left point)
     int _map_x, _map_y;
+    // Quantization shift of the local coordinates (see MapFile.hpp)
+    uint8_t shift = 0;
 
     Tile() : BoundingBox() {};
 
@@ -46,6 +51,13 @@ public:
             return;
         }
 
+        // Round to units of the quantization shift. A node must not turn into a separator.
+        if(shift) {
+            x_local = (x_local + (1 << (shift - 1))) >> shift;
+            y_local = (y_local + (1 << (shift - 1))) >> shift;
+            if(!x_local && !y_local) x_local = 1;
+        }
+
         // Check if node exceeds maximum coordinate-wise distance
         if(std::abs(x_local) > INT16_MAX || std::abs(y_local) > INT16_MAX) {
             // Project to 1/0
@@ -60,6 +72,11 @@ public:
         buffer[1] = (int16_t) y_local;
     }
 
+    // Largest absolute local coordinate of a global coordinate, before quantization
+    int64_t local_extent(int32_t x, int32_t y) {
+        return std::max(std::abs((int64_t) x - lower_x), std::abs((int64_t) y - lower_y));
+    }
+
     // Writes a separator (consisting of two consecutive zeros) into a buffer
     void write_way_separator(int16_t* buffer) {
         buffer[0] = (int16_t) 0;
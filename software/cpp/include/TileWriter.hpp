@@ -0,0 +1,142 @@
+#ifndef TILE_WRITER_H
+#define TILE_WRITER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include <BoundingBox.hpp>
+#include <MapFile.hpp>
+#include <Tile.hpp>
+
+/*
+
+    Writes the part of a highway that lies on a tile into buffer. The highway consists of the nodes
+    [begin, end) of the coordinate arrays. Returns the number of int16_t values that were written.
+    If buffer is a nullptr, nothing is written and only the number of values is returned.
+    If extent is given, it is raised to the largest absolute local coordinate of all nodes of the tile,
+    which determines the quantization shift of the tile.
+
+*/
+inline uint64_t write_way_on_tile(Tile& tile, const int32_t* node_x_coords, const int32_t* node_y_coords,
+    uint64_t begin, uint64_t end, int16_t* buffer, int64_t* extent = nullptr) {
+
+    // ANY CHANGE TO THIS LOGIC HAS TO BE REPLICATED IN THE TILEASSINGER!
+    uint64_t offset = 0;
+    bool prev_node_in_tile = false;
+
+    for(uint64_t j=begin; j<end; j++) {
+        if(tile.contains(node_x_coords[j], node_y_coords[j])) {
+            // Check if we need to add the previous node too
+            if(!prev_node_in_tile && j > begin) {
+                if(tile.isSouthWestOf(node_x_coords[j-1], node_y_coords[j-1])) {
+                    // Add previous node.
+                    if(buffer) tile.write_global_coord(node_x_coords[j-1], node_y_coords[j-1], buffer + offset);
+                    if(extent) *extent = std::max(*extent, tile.local_extent(node_x_coords[j-1], node_y_coords[j-1]));
+                    offset += 2;
+                }
+            }
+            // Add current node. This operation always writes two coordinates.
+            if(buffer) tile.write_global_coord(node_x_coords[j], node_y_coords[j], buffer + offset);
+            if(extent) *extent = std::max(*extent, tile.local_extent(node_x_coords[j], node_y_coords[j]));
+            offset += 2;
+            // Write separator if way ends.
+            if(j==end-1) {
+                if(buffer) tile.write_way_separator(buffer + offset);
+                offset += 2;
+            }
+            // Signal that tile was added
+            prev_node_in_tile = true;
+        } else {
+            // Current node is not in tile.
+            if(prev_node_in_tile && tile.isSouthWestOf(node_x_coords[j], node_y_coords[j])) {
+                // Add the one node that was to the top right of tile
+                if(buffer) tile.write_global_coord(node_x_coords[j], node_y_coords[j], buffer + offset);
+                if(extent) *extent = std::max(*extent, tile.local_extent(node_x_coords[j], node_y_coords[j]));
+                offset += 2;
+            }
+            if(prev_node_in_tile || j==end-1) {
+                // Write separator if end of way.
+                if(buffer) tile.write_way_separator(buffer + offset);
+                offset += 2;
+            }
+            prev_node_in_tile = false;
+        }
+    }
+
+    return offset;
+}
+
+
+/*
+
+    Range of tiles of the map grid that collide with a bounding box. Unlike WayBox::get_colliding_tiles
+    the range is clamped to the grid, since geometry may leave the map area.
+    The range is empty if x0 > x1 or y0 > y1.
+
+*/
+struct TileRange {
+    int64_t x0, y0, x1, y1;
+
+    TileRange(const BoundingBox& box, const MapHeader& header) {
+        int64_t tile_size = header.tile_size;
+        // Floor division, the box may lie left of or below the map origin
+        auto tile_of = [tile_size](int64_t offset) {
+            return offset >= 0 ? offset/tile_size : -((-offset + tile_size - 1)/tile_size);
+        };
+        x0 = std::max<int64_t>(tile_of(box.lower_x - header.map_x), 0);
+        y0 = std::max<int64_t>(tile_of(box.lower_y - header.map_y), 0);
+        x1 = std::min<int64_t>(tile_of(box.upper_x - header.map_x), header.n_x_tiles - 1);
+        y1 = std::min<int64_t>(tile_of(box.upper_y - header.map_y), header.n_y_tiles() - 1);
+    }
+};
+
+/*
+
+    Writes the nodes of all highways into the tile buffer of the map.
+
+    buffer_tiles has to be large enough to hold all tiles and buffer_pointer
+    contains the start of each tile in the tile buffer in BYTE count.
+
+*/
+inline void write_tiles(int16_t* buffer_tiles, uint64_t* buffer_pointer, WayBox* wBoxes, uint64_t highways,
+    int32_t* node_x_coords, int32_t* node_y_coords, uint64_t* highway_indices, uint64_t all_way_node_count,
+    int tile_size, int n_x_tiles, int map_x, int map_y, int n_tiles) {
+
+    int* idx_arr;
+    Tile currTile;
+
+    // Write offset within each tile in BYTE count
+    uint64_t* _local_pointer_offsets = (uint64_t*) calloc(n_tiles, sizeof(uint64_t));
+
+    for(uint64_t hw_id=0; hw_id < highways; hw_id++) {
+        // Get bounding box of current way
+        auto curr_wBox = wBoxes[hw_id];
+        // Get number of colliding tiles
+        int n_idx_curr = curr_wBox.get_n_colliding_tiles(tile_size, n_x_tiles, map_x, map_y);
+        // Allocate memory for tile indices
+        idx_arr = new int[n_idx_curr];
+        // Get colliding tile indices
+        curr_wBox.get_colliding_tiles(tile_size, n_x_tiles, map_x, map_y, idx_arr);
+        // idx_arr now contains the indices for all colliding tiles.
+
+        // Nodes of the current highway
+        uint64_t j_begin = highway_indices[hw_id];
+        uint64_t j_end = (hw_id == highways-1) ? all_way_node_count : highway_indices[hw_id+1];
+
+        // Find containing nodes for each colliding tile
+        for(int i=0; i<n_idx_curr; i++) {
+            int curr_tile_id = idx_arr[i];
+            currTile = Tile(curr_tile_id, tile_size, n_x_tiles, map_x, map_y);
+            _local_pointer_offsets[curr_tile_id] += sizeof(int16_t)*write_way_on_tile(currTile, node_x_coords, node_y_coords, j_begin, j_end,
+                buffer_tiles + (buffer_pointer[curr_tile_id] + _local_pointer_offsets[curr_tile_id])/2);
+        }
+
+        // Avoid memory leak
+        delete[] idx_arr;
+    }
+
+    free(_local_pointer_offsets);
+}
+
+#endif
@@ -14,21 +14,178 @@
 #include <BoundingBox.hpp>
 #include <Tile.hpp>
 #include <CustomHandlers.hpp>
+#include <TileWriter.hpp>
+#include <GeometryStore.hpp>
+#include <IncrementalUpdate.hpp>
+#include <StoreConversion.hpp>
+#include <BatchConversion.hpp>
+#include <ConversionCache.hpp>
+#include <Corridor.hpp>
+#include <NameIndex.hpp>
+#include <RoutingGraph.hpp>
+
+
+void print_usage() {
+    std::cout << "Usage: osm2simpletile PATH_TO_INPUT_FILE PATH_TO_OUTPUT_FILE [--store PATH_TO_STORE] [--cache CACHE_DIR] [--tile-size SIZE[,SIZE...]]\n";
+    std::cout << "                      [--corridor PATH_TO_GPX_FILE [--width METERS]] [--names PATH_TO_NAME_INDEX]\n";
+    std::cout << "                      [--graph PATH_TO_ROUTING_GRAPH]\n";
+    std::cout << "       osm2simpletile --update PATH_TO_OLD_MAP PATH_TO_STORE PATH_TO_CHANGES PATH_TO_NEW_MAP [PATH_TO_NEW_STORE]\n";
+    std::cout << "       osm2simpletile --batch OUTPUT_DIR PATH_TO_INPUT_FILE...\n";
+    std::cout << "       osm2simpletile --merge PATH_TO_OUTPUT_FILE PATH_TO_INPUT_FILE...\n";
+}
+
+// Output path for one of several tile sizes: map.bin becomes map_1024.bin
+std::string output_path_for_size(const std::string& output_path, int tile_size) {
+    size_t slash = output_path.find_last_of('/');
+    size_t dot = output_path.find_last_of('.');
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = output_path.size();
+    return output_path.substr(0, dot) + "_" + std::to_string(tile_size) + output_path.substr(dot);
+}
+
+/*
+
+    Conversion through a geometry store. The geometry is either read from the input or taken from the cache,
+    afterwards a map is written for every tile size. If a track is given, only the corridor along the track is written.
+    Names and road classes are not part of the geometry store, so they are always read from the input.
+
+*/
+int convert_from_store(const char* input_path, const char* output_path, const char* store_path, const char* cache_dir,
+    const std::vector<int>& tile_sizes, const char* corridor_path, double corridor_width, const char* names_path,
+    const char* graph_path) {
+
+    std::vector<TrackPoint> track;
+    if(corridor_path && !read_gpx(corridor_path, track)) return 1;
+
+    std::vector<NamedObject> names;
+    if(names_path && !read_names(input_path, names)) return 1;
+
+    std::vector<uint8_t> classes;
+    if(graph_path && !read_road_classes(input_path, classes)) return 1;
+
+    GeometryStore store;
+    std::cout << "-------------------------- 1/2 Reading highway geometry --------------------------\n";
+    bool with_ids = store_path != nullptr || graph_path != nullptr;
+    bool success = cache_dir ? read_geometry_cached(input_path, cache_dir, store) : read_geometry(input_path, store, with_ids);
+    if(!success) return 1;
+    std::cout << "Highways: \t\t\t" << store.n_highways << "\n";
+    std::cout << "all_way_node_count: \t\t" << store.n_coords << "\n";
+
+    std::cout << "------------------------------- 2/2 Writing maps --------------------------------\n";
+    for(int tile_size : tile_sizes) {
+        std::string path = tile_sizes.size() > 1 ? output_path_for_size(output_path, tile_size) : output_path;
+        if(corridor_path) {
+            if(!write_corridor_map(store, tile_size, track, corridor_width, path.c_str())) return 1;
+        } else if(!write_map(store, tile_size, path.c_str())) {
+            return 1;
+        }
+        std::cout << "Map created successfully at: " << path << "\n";
+        if(names_path) {
+            std::string index_path = tile_sizes.size() > 1 ? output_path_for_size(names_path, tile_size) : names_path;
+            if(!write_name_index(names, path.c_str(), index_path.c_str())) return 1;
+            std::cout << "Name index created successfully at: " << index_path << "\n";
+        }
+        if(graph_path) {
+            std::string graph_map_path = tile_sizes.size() > 1 ? output_path_for_size(graph_path, tile_size) : graph_path;
+            if(!write_routing_graph(store, classes, path.c_str(), graph_map_path.c_str())) return 1;
+            std::cout << "Routing graph created successfully at: " << graph_map_path << "\n";
+        }
+    }
 
-using index_type = osmium::index::map::FlexMem<osmium::unsigned_object_id_type, osmium::Location>;
-using location_handler_type = osmium::handler::NodeLocationsForWays<index_type>;
-
+    if(store_path) {
+        if(!store.save(store_path)) return 1;
+        std::cout << "Geometry store created successfully at: " << store_path << "\n";
+    }
+    return 0;
+}
 
 
 int main(int argc, char *argv[]) {
 
-    if (argc != 3) {
-        std::cout << "Usage: osm2simpletile PATH_TO_INPUT_FILE PATH_TO_OUTPUT_FILE \n";
+    // Update an existing map with an OSM change file
+    if (argc >= 2 && std::string(argv[1]) == "--update") {
+        if (argc != 6 && argc != 7) {
+            print_usage();
+            return 1;
+        }
+        return update_map(argv[2], argv[3], argv[4], argv[5], argc == 7 ? argv[6] : nullptr) ? 0 : 1;
+    }
+
+    // Convert several inputs into one map per input or into one merged map
+    if (argc >= 2 && (std::string(argv[1]) == "--batch" || std::string(argv[1]) == "--merge")) {
+        if (argc < 4) {
+            print_usage();
+            return 1;
+        }
+        bool merge = std::string(argv[1]) == "--merge";
+        std::vector<std::string> inputs(argv + 3, argv + argc);
+        return batch_convert(inputs, merge ? nullptr : argv[2], merge ? argv[2] : nullptr, 512) ? 0 : 1;
+    }
+
+    if (argc < 3) {
+        print_usage();
         return 1;
     }
+    // Optional geometry store needed for incremental updates
+    const char* store_path = nullptr;
+    // Optional directory for cached geometry
+    const char* cache_dir = nullptr;
+    // Tile sizes (in mercator coordinates)
+    std::vector<int> tile_sizes;
+    // Optional GPX track and width of the corridor along the track in meters
+    const char* corridor_path = nullptr;
+    double corridor_width = 1000;
+    // Optional name index for the map
+    const char* names_path = nullptr;
+    // Optional routing graph for the map
+    const char* graph_path = nullptr;
+    for(int i=3; i<argc; i++) {
+        std::string arg = argv[i];
+        if(arg == "--store" && i+1 < argc) {
+            store_path = argv[++i];
+        } else if(arg == "--cache" && i+1 < argc) {
+            cache_dir = argv[++i];
+        } else if(arg == "--graph" && i+1 < argc) {
+            graph_path = argv[++i];
+        } else if(arg == "--names" && i+1 < argc) {
+            names_path = argv[++i];
+        } else if(arg == "--corridor" && i+1 < argc) {
+            corridor_path = argv[++i];
+        } else if(arg == "--width" && i+1 < argc) {
+            corridor_width = atof(argv[++i]);
+            if(corridor_width <= 0) {
+                std::cout << "Error: Invalid corridor width " << argv[i] << "\n";
+                return 1;
+            }
+        } else if(arg == "--tile-size" && i+1 < argc) {
+            std::string sizes = argv[++i];
+            size_t start = 0;
+            while(start <= sizes.size()) {
+                size_t end = std::min(sizes.find(',', start), sizes.size());
+                int size = atoi(sizes.substr(start, end - start).c_str());
+                if(size <= 0 || size > (int) MAP_MAX_TILE_SIZE) {
+                    std::cout << "Error: Invalid tile size " << sizes.substr(start, end - start) << "\n";
+                    return 1;
+                }
+                tile_sizes.push_back(size);
+                start = end + 1;
+            }
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    if(tile_sizes.empty()) tile_sizes.push_back(512);
+
+    // The geometry does not depend on the tile size, so it is only read once if it is cached or several maps are written.
+    // The routing graph is built from the geometry store as well. Only the store based writer quantizes tiles,
+    // which is required for tiles larger than INT16_MAX.
+    bool large_tiles = *std::max_element(tile_sizes.begin(), tile_sizes.end()) > INT16_MAX;
+    if(cache_dir || tile_sizes.size() > 1 || corridor_path || graph_path || large_tiles) {
+        return convert_from_store(argv[1], argv[2], store_path, cache_dir, tile_sizes, corridor_path, corridor_width, names_path, graph_path);
+    }
 
     // Tile size (in mercator coordinates)
-    int tile_size = 512;
+    int tile_size = tile_sizes[0];
 
     // Map statistics
     double map_height, map_width;
@@ -43,6 +200,7 @@ int main(int argc, char *argv[]) {
     uint64_t* ptr_per_tile;
 
     // Buffers to store coordinates and IDs
+    GeometryStore store;
     int32_t* node_x_coords;
     int32_t* node_y_coords;
     uint64_t* highway_indices;
@@ -111,11 +269,15 @@ int main(int argc, char *argv[]) {
 
     // Fourth pass. Get all mercator coordinates of all highways
     std::cout << "-------------------------- 4/6 Converting coordinates --------------------------\n";
-    node_x_coords = new int32_t[all_way_node_count];
-    node_y_coords = new int32_t[all_way_node_count];
-    highway_indices = new uint64_t[highways];
+    // OSM IDs are only needed if the store is saved
+    if(!store.allocate(highways, all_way_node_count, store_path != nullptr)) {
+        return 1;
+    }
+    node_x_coords = store.node_x_coords;
+    node_y_coords = store.node_y_coords;
+    highway_indices = store.highway_indices;
     osmium::io::Reader reader4{input_file, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way};
-    MercatorConverter mercConv(node_x_coords, node_y_coords, highway_indices);
+    MercatorConverter mercConv(node_x_coords, node_y_coords, highway_indices, store.way_ids, store.node_ids);
     osmium::apply(reader4, location_handler, mercConv);
     reader4.close();
     location_handler.clear();
@@ -125,19 +287,8 @@ int main(int argc, char *argv[]) {
     byte_per_tile = new uint16_t[n_tiles];
     ptr_per_tile = new uint64_t[n_tiles];
 
-    // The header stores the following metadata:
-    //  map_x       uint64  x-coordinate of lower left corner (mercator-web)
-    //  map_y       uint64  y-coordinate of lower left corner (mercator-web)
-    //  map_width   uint64
-    //  map_height  uint64
-    //  n_x_tiles   uint64  number of tiles in x direction
-    //  tile_size   uint64  size of tile
-    //  n_tiles     uint64  number of tiles
-    //  max_nodes   uint64  largest number of nodes on single tile
-    //  n_nodes     uint64  number of nodes
-    //  n_ways      uint64  number of ways
-
-    byte_header = 10*8;
+    // Layout of the header: see simpletileformat.h
+    byte_header = sizeof(MapHeader);
     byte_ptr = 0;
     byte_tiles = 0;
     max_tile_nodes = -1;
@@ -179,134 +330,54 @@ int main(int argc, char *argv[]) {
     
     std::cout << "------------------------------- 6/6 Writing map --------------------------------\n";
     // Finally, create the output file!
-    // Create buffer for nodes
-    uint64_t* buffer_header = (uint64_t*) new char[byte_header];
     // buffer_pointer has tile offsets in BYTE count
     uint64_t* buffer_pointer = ptr_per_tile;
     // buffer_tiles has the buffer data
     int16_t* buffer_tiles = (int16_t*) calloc(byte_tiles, sizeof(char));
-    // Write header buffer
-    //  map_x       uint64  x-coordinate of lower left corner (mercator-web)
-    //  map_y       uint64  y-coordinate of lower left corner (mercator-web)
-    //  map_width   uint64
-    //  map_height  uint64
-    //  n_x_tiles   uint64  number of tiles in x direction
-    //  tile_size   uint64  size of tile
-    //  n_tiles     uint64  number of tiles
-    //  max_nodes   uint64  largest number of nodes on single tile
-    //  n_nodes     uint64  number of nodes, including separators
-    //  n_ways      uint64  number of ways
-    buffer_header[0] = (int64_t) map_x;
-    buffer_header[1] = (int64_t) map_y;
-    buffer_header[2] = (uint64_t) map_width;
-    buffer_header[3] = (uint64_t) map_height;
-    buffer_header[4] = (uint64_t) n_x_tiles;
-    buffer_header[5] = (uint64_t) tile_size;
-    buffer_header[6] = (uint64_t) n_tiles;
-    buffer_header[7] = (uint64_t) max_tile_nodes;
-    buffer_header[8] = (uint64_t) total_tile_nodes;
-    buffer_header[9] = (uint64_t) n_ways;
-
-    int* idx_arr;
-    Tile currTile;
+    // Map header. n_nodes includes the separators (see simpletileformat.h).
+    MapHeader header;
+    header.map_x = map_x;
+    header.map_y = map_y;
+    header.map_width = map_width;
+    header.map_height = map_height;
+    header.n_x_tiles = n_x_tiles;
+    header.tile_size = tile_size;
+    header.n_tiles = n_tiles;
+    header.max_nodes = max_tile_nodes;
+    header.n_nodes = total_tile_nodes;
+    header.n_ways = n_ways;
 
     // Write tile buffer
-    uint64_t* _local_pointer_offsets = (uint64_t*) calloc(n_tiles, sizeof(uint64_t));
-
-    for(uint64_t hw_id=0; hw_id < highways; hw_id++) {
-        // Get bounding box of current way
-        auto curr_wBox = wBoxes[hw_id];
-        // Get number of colliding tiles
-        int n_idx_curr = curr_wBox.get_n_colliding_tiles(tile_size, n_x_tiles, map_x, map_y);
-        // Allocate memory for tile indices
-        idx_arr = new int[n_idx_curr];
-        // Get colliding tile indices
-        curr_wBox.get_colliding_tiles(tile_size, n_x_tiles, map_x, map_y, idx_arr);
-        // idx_arr now contains the indices for all colliding tiles.
-
-        // Find containing nodes for each colliding tile
-
-        // ANY CHANGE TO THIS LOGIC HAS TO BE REPLICATED IN THE TILEASSINGER!
-        // TODO: Make this better, it is horrible
-        for(int i=0; i<n_idx_curr; i++) {
-            // Create tile
-            int curr_tile_id = idx_arr[i];
-            currTile = Tile(curr_tile_id, tile_size, n_x_tiles, map_x, map_y);
-            // J goes over all nodes for current hw!
-            uint64_t j_end = 0;
-            // Last highway.
-            if(hw_id == highways-1) {
-                j_end = all_way_node_count-1;
-            } else {
-                j_end = highway_indices[hw_id+1];
-            }
-
-            bool prev_node_in_tile = false;
-
-            for(uint64_t j=highway_indices[hw_id]; j<j_end; j++) {
-                if(currTile.contains(node_x_coords[j], node_y_coords[j])) {
-                    // I=tile_idx
-                    // J=node_idx
-                    // Check if we need to add the previous node too
-                    if(!prev_node_in_tile && j > highway_indices[hw_id]) {
-                        if(currTile.isSouthWestOf(node_x_coords[j-1], node_y_coords[j-1])) {
-                            // Add previous node.
-                            currTile.write_global_coord(
-                                node_x_coords[j-1],
-                                node_y_coords[j-1],
-                                buffer_tiles + (buffer_pointer[curr_tile_id] + _local_pointer_offsets[curr_tile_id])/2
-                            );
-                            // Increase local pointer offset
-                            _local_pointer_offsets[curr_tile_id] += 2*sizeof(int16_t);
-                        }
-                    }
-                    // Add current node in buffer for I-th tile
-                    currTile.write_global_coord(
-                        node_x_coords[j],
-                        node_y_coords[j],
-                        buffer_tiles + (buffer_pointer[curr_tile_id] + _local_pointer_offsets[curr_tile_id])/2
-                    );
-                    // This operation always writes two coordinates, so we increase the pointer offset by 2*sizeof(int16_t)
-                    _local_pointer_offsets[curr_tile_id] += 2*sizeof(int16_t);
-                    // Write separator if way ends.
-                    if(j==j_end-1) {
-                        currTile.write_way_separator(buffer_tiles + (buffer_pointer[curr_tile_id] + _local_pointer_offsets[curr_tile_id])/2);
-                        _local_pointer_offsets[curr_tile_id] += 2*sizeof(int16_t);
-                    }
-                    // Signal that tile was added
-                    prev_node_in_tile = true;
-                } else {
-                    // Current node is not in tile.
-                    if(prev_node_in_tile && currTile.isSouthWestOf(node_x_coords[j], node_y_coords[j])) {
-                        // Add the one node that was to the top right of tile
-                        currTile.write_global_coord(
-                            node_x_coords[j],
-                            node_y_coords[j],
-                            buffer_tiles + (buffer_pointer[curr_tile_id] + _local_pointer_offsets[curr_tile_id])/2
-                        );
-                        // This operation always writes two coordinates, so we increase the pointer offset by 2*sizeof(int16_t)
-                        _local_pointer_offsets[curr_tile_id] += 2*sizeof(int16_t);
-                    }
-                    if(prev_node_in_tile || j==j_end-1) {
-                        // Write separator if end of way.
-                        currTile.write_way_separator(buffer_tiles + (buffer_pointer[curr_tile_id] + _local_pointer_offsets[curr_tile_id])/2);
-                        _local_pointer_offsets[curr_tile_id] += 2*sizeof(int16_t);
-                    }
-                    prev_node_in_tile = false;
-                }
-            }
-        }
-
-        // Avoid memory leak
-        delete idx_arr;
-    }
+    write_tiles(buffer_tiles, buffer_pointer, wBoxes, highways,
+        node_x_coords, node_y_coords, highway_indices, all_way_node_count,
+        tile_size, n_x_tiles, map_x, map_y, n_tiles);
 
     FILE* file = fopen(argv[2], "wb");
-    fwrite(buffer_header, sizeof(buffer_header[0]), 10, file);
+    fwrite(&header, sizeof(MapHeader), 1, file);
     fwrite(buffer_pointer, sizeof(buffer_pointer[0]), n_tiles, file);
     fwrite(buffer_tiles, sizeof(buffer_tiles[0]), byte_tiles/sizeof(buffer_tiles[0]), file);
     fclose(file);
 
     std::cout << "Map created successfully at: " << argv[2] << "\n";
 
+    if(names_path) {
+        std::vector<NamedObject> names;
+        if(!read_names(argv[1], names) || !write_name_index(names, argv[2], names_path)) {
+            return 1;
+        }
+        std::cout << "Name index created successfully at: " << names_path << "\n";
+    }
+
+    if(store_path) {
+        store.map_x = map_x;
+        store.map_y = map_y;
+        store.map_width = map_width;
+        store.map_height = map_height;
+        store.n_ways = n_ways;
+        if(!store.save(store_path)) {
+            return 1;
+        }
+        std::cout << "Geometry store created successfully at: " << store_path << "\n";
+    }
+
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include <chrono>
+#include <iostream>
+
+#include <MapFile.hpp>
+#include <MapVerify.hpp>
+
+/*
+
+    Commandline tool to check maps for consistency.
+
+*/
+int main(int argc, char *argv[]) {
+
+    if (argc < 2) {
+        std::cout << "Usage: simpletile-verify PATH_TO_MAP [PATH_TO_MAP...]\n";
+        return 1;
+    }
+
+    bool valid = true;
+    for(int i=1; i<argc; i++) {
+        auto t_start = std::chrono::steady_clock::now();
+        MapFile map;
+        if(!map.open(argv[i])) {
+            valid = false;
+            continue;
+        }
+        std::cout << "-------------------------------- " << argv[i] << "\n";
+        bool map_valid = verify_map(map);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+        std::cout << "Checked " << map.file_size()/(1000*1000) << " MB in " << seconds << " s: "
+            << (map_valid ? "OK" : "INVALID") << "\n";
+        valid = valid && map_valid;
+    }
+
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#ifndef _FLASHMAP_H
+#define _FLASHMAP_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <simpletile.h>
+
+/*
+
+    Map in a data partition of the internal flash (see partitions_flashmap.csv), memory-mapped with
+    esp_partition_mmap. Tiles are rendered in place: no copies, no SD-card reads and no waiting for the
+    shared SPI bus. Only maps of version 2 are supported, as the size of the last tile of a version 1 map
+    is derived from the file size, which the partition does not know.
+
+*/
+class FlashMap {
+
+private:
+    const uint8_t* _data;
+    spi_flash_mmap_handle_t _handle;
+    SimpleTile::Header* _header;
+
+public:
+    FlashMap();
+
+    // Maps the partition and reads the header. Returns false if there is no valid map in flash.
+    bool initialize(SimpleTile::Header& header);
+    // Entry of a tile (see SimpleTile::packEntry), 0 for empty tiles
+    uint64_t tileEntry(uint64_t tileId);
+    // Start of the tile data
+    const int16_t* tileData();
+
+};
+
+#endif
@@ -15,6 +15,11 @@
 #define SPI_FREQ 8000000
 #define DISPLAY_CS  D3
 #define SDCARD_CS   D2
+// Read tile data by sector from the SD-card, bypassing the file system, if the map file is contiguous
+#define SDCARD_RAW_MAP_READS true
+// Label of the flash partition that holds a map (see partitions_flashmap.csv). A map in flash is used instead of
+// the map on the SD-card.
+#define FLASH_MAP_PARTITION "map"
 
 /**
  * 
@@ -64,12 +69,78 @@
 // If the map should be rotated to be alinged with heading.
 #define RENDER_HEADING true
 
-// Minimum time between two consecutive tile data updates in milliseconds.
-#define TILE_UPDATE_DEBOUNCE_MS 5000
-
 // Minimum free heap memory required after tile buffer allocation
 #define MIN_FREE_HEAP 10000
 
+// Maximum number of tiles and bytes of tile data in the tile cache. Tiles that were left recently stay in memory,
+// so riding back onto them needs no SD reads. Tiles take only their actual size, the cache holds at least the
+// largest tile of the map.
+#define TILE_CACHE_MAX_TILES 64
+#define TILE_CACHE_MAX_BYTES 100000
+
+// Width and height of the window of tile entries (position and size of the tile data in the map file) that is kept
+// in memory. It follows the center and must be at least RENDER_TILES_PER_DIM+2.
+#define TILE_ENTRY_WINDOW 8
+
+// Largest sparse tile index (4 bytes per stored tile) of a version 2 map that is kept in memory. Rows of the entry
+// window are then looked up without SD reads, larger indexes are searched on the SD-card.
+#define SPARSE_INDEX_MAX_BYTES 32768
+
+// Heap in bytes the tile cache leaves to the rerouter and the turn cues, which are initialized after the map
+#define TILE_CACHE_HEAP_RESERVE 80000
+
+// Tiles are read from SD by a background task. Besides the tiles in view, it prefetches the block around the
+// position predicted from heading and speed and the tiles of the next runs of the GPX track.
+// Time in milliseconds the position is predicted ahead
+#define PREFETCH_LOOKAHEAD_MS 15000
+// Number of tiles of the GPX track ahead of the rider that are prefetched
+#define PREFETCH_TRACK_TILES 4
+// Time between two predictions in milliseconds
+#define PREFETCH_INTERVAL_MS 1000
+// Maximum number of tiles requested from the task at once
+#define PREFETCH_QUEUE_SIZE 16
+// Stack size and priority of the task. At priority 0, it only runs while the main loop waits for the next frame.
+#define PREFETCH_TASK_STACK 4096
+#define PREFETCH_TASK_PRIORITY 0
+
+
+/**
+ * 
+ *      Rerouting
+ * 
+**/
+
+// Number of graph partitions kept in memory
+#define ROUTE_CACHE_SLOTS 4
+// Maximum number of nodes a search may visit. Bounds the memory of the router.
+#define ROUTE_MAX_NODES 1000
+// Weight of the A* heuristic. Values > 1 expand less nodes but find slightly longer routes.
+#define ROUTE_HEURISTIC_WEIGHT 2.0
+// Maximum number of points of a route back to the track
+#define ROUTE_MAX_POINTS 256
+// Distance to the track in meters after which the rider is considered off track
+#define ROUTE_OFF_TRACK_DISTANCE 40
+// Distance along the track in meters, after which the route rejoins the track
+#define ROUTE_REJOIN_DISTANCE 300
+// Time between two checks of the distance to the track
+#define ROUTE_CHECK_INTERVAL_MS 2000
+// Minimum time between two reroutes
+#define ROUTE_MIN_INTERVAL_MS 30000
+
+
+/**
+ * 
+ *      Turn cues
+ * 
+**/
+
+// Distance to the track in meters after which no turn is shown
+#define TURN_MAX_TRACK_DISTANCE 50
+// Maximum number of track points the rider may pass between two positions
+#define TURN_MAX_ADVANCE 8
+// Minimum time between two searches of the rider's position on the full track
+#define TURN_RESYNC_INTERVAL_MS 5000
+
 
 /**
  * 
@@ -92,10 +163,11 @@
 // 4 = lat
 // 5 = lon
 // 6 = nsats
+// 7 = next turn (direction and distance, heading if there is no turn ahead)
 // Left element of status bar
 #define LEFT_STAT 0
 // Right element of status bar
-#define RIGHT_STAT 3
+#define RIGHT_STAT 7
 
 
 
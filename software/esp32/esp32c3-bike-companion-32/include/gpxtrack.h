@@ -6,16 +6,74 @@
 
 /*
 
-    GPX-Track
+    Run of consecutive track points on the same tile
+
+*/
+struct TrackRun {
+    uint32_t tileId;
+    uint32_t firstPoint;
+};
+
+
+/*
+
+    Turn at a junction, compiled by gpx2simpletrack. The distance is measured in meters along the track
+    points from the first point. turn is the angle class (see TURN_*), negative for turns to the left.
+
+*/
+struct TrackCue {
+    uint32_t distance;
+    int16_t angle;
+    int8_t turn;
+    uint8_t reserved;
+};
+
+#define TURN_SLIGHT 1
+#define TURN_NORMAL 2
+#define TURN_SHARP 3
+#define TURN_UTURN 4
+
+
+/*
+
+    GPX-Track. Points are stored as (x, y) pairs in local coordinates of the tile of their run.
 
 */
 struct GPXTrack {
 public:
-    int16_t* xList;
-    int16_t* yList;
-    uint64_t* tileIdList;
+    int16_t* points;
+    TrackRun* runs;
+    TrackCue* cues;
     uint32_t numNodes;
+    uint32_t numRuns;
+    uint32_t numCues;
     uint32_t nearestNodeId;
+
+    // Index after the last point of a run
+    uint32_t runEnd(uint32_t runId) {
+        return (runId + 1 < numRuns) ? runs[runId + 1].firstPoint : numNodes;
+    }
 };
 
-#endif
\ No newline at end of file
+
+/*
+
+    Binary track file compiled by gpx2simpletrack (see the converter's SimpleTrack.hpp).
+    The header is followed by numRuns TrackRun entries, numPoints delta-encoded (x, y) pairs and numCues TrackCue entries.
+
+*/
+namespace SimpleTrack {
+
+    const char MAGIC[] = "STTRACK1";
+
+    struct Header {
+        char magic[8];
+        uint32_t headerCrc;
+        uint32_t numPoints;
+        uint32_t numRuns;
+        uint32_t numCues;
+    };
+
+}
+
+#endif
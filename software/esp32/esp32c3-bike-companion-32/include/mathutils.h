@@ -55,4 +55,123 @@ void rotatePointInplace(int& ptxIn, int& ptyIn, int& ptxCenter, int& ptyCenter,
     rotatePoint(ptxIn, ptyIn, ptxInOld, ptyIn, ptxCenter, ptyCenter, mtxIn);
 };
 
+// Sine of 0 to 90 degrees in Q16 fixed point (65536 = 1.0)
+static const int32_t SIN_Q16[91] = {
+    0, 1144, 2287, 3430, 4572, 5712, 6850, 7987, 9121, 10252,
+    11380, 12505, 13626, 14742, 15855, 16962, 18064, 19161, 20252, 21336,
+    22415, 23486, 24550, 25607, 26656, 27697, 28729, 29753, 30767, 31772,
+    32768, 33754, 34729, 35693, 36647, 37590, 38521, 39441, 40348, 41243,
+    42126, 42995, 43852, 44695, 45525, 46341, 47143, 47930, 48703, 49461,
+    50203, 50931, 51643, 52339, 53020, 53684, 54332, 54963, 55578, 56175,
+    56756, 57319, 57865, 58393, 58903, 59396, 59870, 60326, 60764, 61183,
+    61584, 61966, 62328, 62672, 62997, 63303, 63589, 63856, 64104, 64332,
+    64540, 64729, 64898, 65048, 65177, 65287, 65376, 65446, 65496, 65526,
+    65536
+};
+
+// Sine of an angle in degrees in Q16 fixed point
+inline int32_t sinQ16(int degrees) {
+    degrees %= 360;
+    if(degrees < 0) degrees += 360;
+    if(degrees <= 90) return SIN_Q16[degrees];
+    if(degrees <= 180) return SIN_Q16[180 - degrees];
+    if(degrees <= 270) return -SIN_Q16[degrees - 180];
+    return -SIN_Q16[360 - degrees];
+}
+
+// Cosine of an angle in degrees in Q16 fixed point
+inline int32_t cosQ16(int degrees) {
+    return sinQ16(degrees + 90);
+}
+
+/*
+
+    Affine transform from local tile coordinates (mercator units relative to the lower left corner of a tile)
+    to screen coordinates in Q16 fixed point. Combines the translation to the center of the display, the scale
+    of the zoom level, the flip of the y-axis and the rotation by the heading (map rotates against it):
+
+        x' = c + A*(x - ox) - B*(y - oy)
+        y' = c - B*(x - ox) - A*(y - oy)
+
+    with A = scale*cos(heading), B = scale*sin(heading), c the display center and (ox, oy) the position of the
+    display center on the tile. Built once per tile and frame, so a vertex costs two 64-bit multiply-adds and
+    no float operations.
+
+*/
+struct ScreenTransform {
+    int32_t a, b;
+    int64_t tx, ty;
+
+    // scaleQ16 is screen pixels per mercator unit, sinQ16 and cosQ16 of the heading
+    void set(int32_t scaleQ16, int32_t sinHeadingQ16, int32_t cosHeadingQ16, int32_t offsetX, int32_t offsetY) {
+        a = ((int64_t) scaleQ16 * cosHeadingQ16) >> 16;
+        b = ((int64_t) scaleQ16 * sinHeadingQ16) >> 16;
+        tx = ((int64_t) DISPLAY_WIDTH_HALF << 16) - (int64_t) a*offsetX + (int64_t) b*offsetY;
+        ty = ((int64_t) DISPLAY_WIDTH_HALF << 16) + (int64_t) b*offsetX + (int64_t) a*offsetY;
+    }
+
+    // Transform a point in mercator units relative to the tile, rounded to the nearest pixel
+    inline void apply(int32_t x, int32_t y, int& xOut, int& yOut) const {
+        xOut = (int) ((tx + (int64_t) a*x - (int64_t) b*y + 0x8000) >> 16);
+        yOut = (int) ((ty - (int64_t) b*x - (int64_t) a*y + 0x8000) >> 16);
+    }
+};
+
+/*
+
+    Cohen-Sutherland line clipping against the rectangle [xMin, xMax] x [yMin, yMax]. The outcode of a point
+    has a bit for every side of the rectangle the point is beyond. A segment with both points beyond the same
+    side is outside, otherwise it is cut at the sides until both points are inside or it turns out to miss
+    the rectangle.
+
+*/
+const uint8_t CLIP_LEFT = 1;
+const uint8_t CLIP_RIGHT = 2;
+const uint8_t CLIP_BOTTOM = 4;
+const uint8_t CLIP_TOP = 8;
+
+inline uint8_t outCode(int x, int y, int xMin, int yMin, int xMax, int yMax) {
+    return (x < xMin ? CLIP_LEFT : 0) | (x > xMax ? CLIP_RIGHT : 0) | (y < yMin ? CLIP_BOTTOM : 0) | (y > yMax ? CLIP_TOP : 0);
+}
+
+// Quotient rounded to the nearest integer
+inline int64_t divRound(int64_t n, int64_t d) {
+    return ((n < 0) == (d < 0) ? n + d/2 : n - d/2) / d;
+}
+
+// Clip the segment from (x0, y0) to (x1, y1) in place. Returns false if no part of it is inside.
+inline bool clipLine(int& x0, int& y0, int& x1, int& y1, int xMin, int yMin, int xMax, int yMax) {
+    uint8_t code0 = outCode(x0, y0, xMin, yMin, xMax, yMax);
+    uint8_t code1 = outCode(x1, y1, xMin, yMin, xMax, yMax);
+    while(code0 | code1) {
+        if(code0 & code1) return false;
+        // Cut the point that is outside at the first side it is beyond, at the pixel nearest to the line
+        uint8_t code = code0 ? code0 : code1;
+        int x, y;
+        if(code & CLIP_TOP) {
+            x = x0 + divRound((int64_t) (x1 - x0) * (yMax - y0), y1 - y0);
+            y = yMax;
+        } else if(code & CLIP_BOTTOM) {
+            x = x0 + divRound((int64_t) (x1 - x0) * (yMin - y0), y1 - y0);
+            y = yMin;
+        } else if(code & CLIP_RIGHT) {
+            y = y0 + divRound((int64_t) (y1 - y0) * (xMax - x0), x1 - x0);
+            x = xMax;
+        } else {
+            y = y0 + divRound((int64_t) (y1 - y0) * (xMin - x0), x1 - x0);
+            x = xMin;
+        }
+        if(code == code0) {
+            x0 = x;
+            y0 = y;
+            code0 = outCode(x0, y0, xMin, yMin, xMax, yMax);
+        } else {
+            x1 = x;
+            y1 = y;
+            code1 = outCode(x1, y1, xMin, yMin, xMax, yMax);
+        }
+    }
+    return true;
+}
+
 #endif
\ No newline at end of file
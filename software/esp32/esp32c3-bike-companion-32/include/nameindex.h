@@ -0,0 +1,56 @@
+#ifndef _NAMEINDEX_H
+#define _NAMEINDEX_H
+
+#include <Arduino.h>
+
+
+/*
+
+    Name index created by the converter (see the converter's NameIndex.hpp). A directory with the first
+    search key of each block is followed by front-coded blocks of BLOCK_SIZE bytes. Search keys are names
+    with ASCII letters in lower case.
+
+*/
+namespace NameIndex {
+
+    const char MAGIC[] = "STNAMES1";
+    const uint16_t BLOCK_SIZE = 512;
+    const uint16_t KEY_SIZE = 32;
+    const uint16_t MAX_LENGTH = 63;
+
+    const uint8_t KIND_STREET = 0;
+    const uint8_t KIND_PLACE = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t headerCrc;
+        uint32_t numNames;
+        uint32_t numBlocks;
+        uint32_t reserved;
+    };
+
+    // Search result, position in local coordinates of the tile
+    struct Result {
+        char name[MAX_LENGTH + 1];
+        uint8_t kind;
+        uint32_t tileId;
+        int16_t x, y;
+    };
+
+    inline uint8_t lower(uint8_t c) {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    // Compares the search key of a name with a lower case prefix. 0 if the name starts with the prefix.
+    inline int comparePrefix(const char* name, uint8_t length, const char* prefix, size_t prefixLength) {
+        for(size_t i=0; i<prefixLength; i++) {
+            if(i >= length) return -1;
+            int diff = (int) lower(name[i]) - (int) (uint8_t) prefix[i];
+            if(diff) return diff;
+        }
+        return 0;
+    }
+
+}
+
+#endif
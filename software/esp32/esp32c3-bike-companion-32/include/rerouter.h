@@ -0,0 +1,49 @@
+#ifndef _REROUTER_H
+#define _REROUTER_H
+
+#include <Arduino.h>
+#include <routing.h>
+#include <sharedspisdcard.h>
+#include <geoposition.h>
+#include <gpxtrack.h>
+#include <simpletile.h>
+
+/*
+
+    Brings the rider back to the GPX track. The distance to the track is checked periodically. If the rider
+    left the track, a route to a point further along the track is computed on the routing graph and provided
+    as a track, so it can be drawn like the GPX track.
+
+*/
+class Rerouter {
+
+private:
+    bool _ready, _hasRoute;
+    uint8_t _offTrackChecks;
+    uint32_t _lastOnTrack;
+    unsigned long _tLastCheck, _tLastRoute;
+    int32_t* _pathX;
+    int32_t* _pathY;
+
+    Routing::Router _router;
+    SDPartitionSource _source;
+    SimpleTile::Header* _header;
+    GPXTrack* _track;
+    GPXTrack _route;
+
+    float distanceToTrack(GeoPosition& pos, uint32_t& nearest);
+    uint32_t rejoinPoint(uint32_t from);
+    void globalPoint(uint32_t pointId, int64_t* x, int64_t* y);
+    bool reroute(GeoPosition& pos);
+
+public:
+    Rerouter(SharedSPISDCard* sd);
+
+    bool initialize(SimpleTile::Header* header, GPXTrack* track);
+    // Returns true if the route changed
+    bool step(GeoPosition& pos);
+    bool hasRoute();
+    GPXTrack* route();
+};
+
+#endif
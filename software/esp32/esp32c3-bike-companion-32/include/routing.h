@@ -0,0 +1,432 @@
+#ifndef _ROUTING_H
+#define _ROUTING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+
+    Routing on the graph exported by the converter (see the converter's RoutingGraph.hpp).
+
+    This header does not depend on Arduino, so the host benchmark (software/cpp/bench/bench_reroute.cpp)
+    runs exactly the same code as the device. All memory is allocated once in initialize():
+
+        - a LRU cache of graph partitions, which are read on demand through a PartitionSource
+        - a node table (open addressing) and an open list (binary heap) of fixed capacity
+
+    The search is a weighted A* with the straight line distance as heuristic. A weight > 1 trades optimality
+    for a lot less expanded nodes. If the node table is full, the search fails instead of allocating more memory.
+
+*/
+namespace Routing {
+
+    const char MAGIC[] = "STGRAPH1";
+
+    struct Header {
+        char magic[8];
+        uint32_t headerCrc;
+        uint32_t numPartitions;
+        uint32_t numXPartitions;
+        uint32_t partitionSize;
+        int32_t originX;
+        int32_t originY;
+        uint32_t numNodes;
+        uint32_t numEdges;
+        uint32_t maxPartitionBytes;
+        uint32_t reserved;
+        uint8_t classCost[16];
+    };
+
+    struct Edge {
+        uint32_t partition;
+        uint16_t node;
+        uint16_t length;
+        uint8_t roadClass;
+        uint8_t flags;
+        uint16_t reserved;
+    };
+
+    /*
+        Source of the graph file, e.g. a file on the SD-card
+    */
+    class PartitionSource {
+    public:
+        virtual ~PartitionSource() {};
+        virtual bool read(uint32_t offset, void* buffer, uint32_t size) = 0;
+    };
+
+    /*
+        Partition loaded into a cache slot
+    */
+    struct Partition {
+        uint32_t id;
+        uint32_t numNodes;
+        uint32_t numEdges;
+        int32_t* coords;
+        uint32_t* firstEdge;
+        Edge* edges;
+        uint32_t lastUse;
+        uint8_t* data;
+    };
+
+    /*
+        Statistics of the last search
+    */
+    struct Stats {
+        uint32_t expanded;
+        uint32_t partitionLoads;
+        uint32_t bytesRead;
+    };
+
+    class Router {
+
+    public:
+        Stats stats;
+        // Weight of the heuristic
+        float heuristicWeight;
+
+        Router() : heuristicWeight(1.5f), _source(0), _slots(0), _numSlots(0), _nodes(0), _table(0), _heap(0),
+            _maxNodes(0), _tableSize(0), _heapSize(0), _clock(0) {
+            memset(&stats, 0, sizeof(Stats));
+        }
+
+        ~Router() {
+            release();
+        }
+
+        // Reads the header and allocates all memory. Returns false if the graph does not belong to the map.
+        bool initialize(PartitionSource* source, uint32_t mapCrc, uint8_t numSlots, uint32_t maxNodes) {
+            release();
+            _source = source;
+            if(!_source->read(0, &header, sizeof(Header)) || memcmp(header.magic, MAGIC, 8) != 0 || header.headerCrc != mapCrc) {
+                return false;
+            }
+            _partitionsOffset = sizeof(Header) + 4*(header.numPartitions + 1);
+
+            _numSlots = numSlots;
+            _slots = (Partition*) calloc(_numSlots, sizeof(Partition));
+            _maxNodes = maxNodes;
+            _tableSize = 1;
+            while(_tableSize < 2*_maxNodes) _tableSize <<= 1;
+            _nodes = (Node*) malloc(_maxNodes*sizeof(Node));
+            _table = (int32_t*) malloc(_tableSize*sizeof(int32_t));
+            _heap = (HeapItem*) malloc(2*_maxNodes*sizeof(HeapItem));
+            if(!_slots || !_nodes || !_table || !_heap) {
+                release();
+                return false;
+            }
+            for(uint8_t i=0; i<_numSlots; i++) {
+                _slots[i].id = UINT32_MAX;
+                _slots[i].data = (uint8_t*) malloc(header.maxPartitionBytes ? header.maxPartitionBytes : 1);
+                if(!_slots[i].data) {
+                    release();
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void release() {
+            if(_slots) {
+                for(uint8_t i=0; i<_numSlots; i++) free(_slots[i].data);
+            }
+            free(_slots);
+            free(_nodes);
+            free(_table);
+            free(_heap);
+            _slots = 0;
+            _nodes = 0;
+            _table = 0;
+            _heap = 0;
+            _numSlots = 0;
+        }
+
+        bool ready() {
+            return _slots != 0;
+        }
+
+        /*
+            Route between two points in global mercator coordinates. Start and goal are snapped to the nearest
+            graph node in their partition (or the neighbouring partitions). The route is written to pathX/pathY
+            from start to goal. Returns the number of points, 0 if no route was found or start and goal snap to
+            the same node.
+        */
+        uint32_t route(int32_t startX, int32_t startY, int32_t goalX, int32_t goalY, int32_t* pathX, int32_t* pathY, uint32_t maxPath) {
+            memset(&stats, 0, sizeof(Stats));
+            uint32_t startPartition = 0, goalPartition = 0;
+            uint16_t startNode = 0, goalNode = 0;
+            if(!nearestNode(startX, startY, startPartition, startNode) || !nearestNode(goalX, goalY, goalPartition, goalNode)) {
+                return 0;
+            }
+            // Start and goal snap to the same node, a single point is no route
+            if(startPartition == goalPartition && startNode == goalNode) return 0;
+            Partition* goal = partition(goalPartition, -1);
+            int32_t gx = goal->coords[2*goalNode];
+            int32_t gy = goal->coords[2*goalNode + 1];
+            // Meters per mercator unit at the goal. The cheapest class costs 1.0 per meter.
+            float scale = cos(atan(sinh(gy / 6378137.0f))) * minCost() * heuristicWeight;
+
+            for(uint32_t i=0; i<_tableSize; i++) _table[i] = -1;
+            _numNodes = 0;
+            _heapSize = 0;
+
+            Partition* start = partition(startPartition, -1);
+            int32_t s = insert(startPartition, startNode, start->coords[2*startNode], start->coords[2*startNode + 1]);
+            _nodes[s].g = 0;
+            _nodes[s].parent = -1;
+            push(s, heuristic(s, gx, gy, scale));
+
+            int32_t found = -1;
+            while(_heapSize) {
+                int32_t u = pop();
+                Node& nu = _nodes[u];
+                if(nu.closed) continue;
+                nu.closed = 1;
+                stats.expanded++;
+                if(nu.partition == goalPartition && nu.node == goalNode) {
+                    found = u;
+                    break;
+                }
+
+                Partition* p = partition(nu.partition, -1);
+                if(!p) continue;
+                int8_t slot = p - _slots;
+                uint32_t first = p->firstEdge[nu.node];
+                uint32_t last = p->firstEdge[nu.node + 1];
+                for(uint32_t e=first; e<last; e++) {
+                    // The partition of u stays in its slot while its edges are visited
+                    Edge edge = _slots[slot].edges[e];
+                    float g = _nodes[u].g + edge.length * header.classCost[edge.roadClass & 0x0F] * 0.1f;
+                    int32_t v = find(edge.partition, edge.node);
+                    if(v < 0) {
+                        Partition* target = partition(edge.partition, slot);
+                        if(!target) continue;
+                        v = insert(edge.partition, edge.node, target->coords[2*edge.node], target->coords[2*edge.node + 1]);
+                        // Node table is full
+                        if(v < 0) return 0;
+                    } else if(_nodes[v].closed || g >= _nodes[v].g) {
+                        continue;
+                    }
+                    _nodes[v].g = g;
+                    _nodes[v].parent = u;
+                    if(!push(v, g + heuristic(v, gx, gy, scale))) return 0;
+                }
+            }
+            if(found < 0) return 0;
+
+            // Path from goal to start, reversed afterwards
+            uint32_t n = 0;
+            for(int32_t v=found; v>=0 && n<maxPath; v=_nodes[v].parent) {
+                pathX[n] = _nodes[v].x;
+                pathY[n] = _nodes[v].y;
+                n++;
+            }
+            for(uint32_t i=0; i<n/2; i++) {
+                int32_t tx = pathX[i], ty = pathY[i];
+                pathX[i] = pathX[n-1-i];
+                pathY[i] = pathY[n-1-i];
+                pathX[n-1-i] = tx;
+                pathY[n-1-i] = ty;
+            }
+            return n;
+        }
+
+        /*
+            Nearest graph node to a point. Searches the partition of the point first and a neighbouring
+            partition only if its edge is closer to the point than the best node found so far.
+        */
+        bool nearestNode(int32_t x, int32_t y, uint32_t& partitionId, uint16_t& node) {
+            int64_t px = ((int64_t) x - header.originX) / (int64_t) header.partitionSize;
+            int64_t py = ((int64_t) y - header.originY) / (int64_t) header.partitionSize;
+            float best = -1;
+            nearestInPartition(px, py, x, y, best, partitionId, node);
+            for(int64_t dy=-1; dy<=1; dy++) {
+                for(int64_t dx=-1; dx<=1; dx++) {
+                    if(!dx && !dy) continue;
+                    if(best >= 0) {
+                        // Distance from the point to the partition rectangle
+                        int64_t left = header.originX + (px + dx)*(int64_t) header.partitionSize;
+                        int64_t bottom = header.originY + (py + dy)*(int64_t) header.partitionSize;
+                        float ex = dx < 0 ? (float) (x - (left + header.partitionSize)) : dx > 0 ? (float) (left - x) : 0;
+                        float ey = dy < 0 ? (float) (y - (bottom + header.partitionSize)) : dy > 0 ? (float) (bottom - y) : 0;
+                        if(ex*ex + ey*ey >= best) continue;
+                    }
+                    nearestInPartition(px + dx, py + dy, x, y, best, partitionId, node);
+                }
+            }
+            return best >= 0;
+        }
+
+        Header header;
+
+    private:
+        struct Node {
+            uint32_t partition;
+            uint16_t node;
+            uint8_t closed;
+            int32_t x, y;
+            float g;
+            int32_t parent;
+        };
+
+        struct HeapItem {
+            float f;
+            int32_t node;
+        };
+
+        PartitionSource* _source;
+        uint32_t _partitionsOffset;
+        Partition* _slots;
+        uint8_t _numSlots;
+        Node* _nodes;
+        int32_t* _table;
+        HeapItem* _heap;
+        uint32_t _maxNodes, _numNodes, _tableSize, _heapSize;
+        uint32_t _clock;
+
+        // Updates best (squared distance), partitionId and node with the nearest node of partition (px, py)
+        void nearestInPartition(int64_t px, int64_t py, int32_t x, int32_t y, float& best, uint32_t& partitionId, uint16_t& node) {
+            uint32_t numYPartitions = header.numPartitions / header.numXPartitions;
+            if(px < 0 || py < 0 || px >= header.numXPartitions || py >= numYPartitions) return;
+            uint32_t id = py*header.numXPartitions + px;
+            Partition* p = partition(id, -1);
+            if(!p) return;
+            for(uint32_t i=0; i<p->numNodes; i++) {
+                float ddx = (float) (p->coords[2*i] - x);
+                float ddy = (float) (p->coords[2*i + 1] - y);
+                float d = ddx*ddx + ddy*ddy;
+                if(best < 0 || d < best) {
+                    best = d;
+                    partitionId = id;
+                    node = i;
+                }
+            }
+        }
+
+        float minCost() {
+            uint8_t cost = 255;
+            for(uint8_t i=1; i<16; i++) {
+                if(header.classCost[i] && header.classCost[i] < cost) cost = header.classCost[i];
+            }
+            return cost * 0.1f;
+        }
+
+        float heuristic(int32_t v, int32_t gx, int32_t gy, float scale) {
+            float dx = (float) (_nodes[v].x - gx);
+            float dy = (float) (_nodes[v].y - gy);
+            return sqrtf(dx*dx + dy*dy) * scale;
+        }
+
+        int8_t slotOf(uint32_t id) {
+            for(uint8_t i=0; i<_numSlots; i++) {
+                if(_slots[i].id == id) return i;
+            }
+            return -1;
+        }
+
+        /*
+            Partition from the cache. On a miss the least recently used slot (except the pinned one) is replaced.
+            Returns 0 if the partition is empty or can not be read.
+        */
+        Partition* partition(uint32_t id, int8_t pinned) {
+            if(id >= header.numPartitions) return 0;
+            _clock++;
+            int8_t slot = slotOf(id);
+            if(slot >= 0) {
+                _slots[slot].lastUse = _clock;
+                return _slots[slot].numNodes ? &_slots[slot] : 0;
+            }
+            // Least recently used slot
+            slot = -1;
+            for(uint8_t i=0; i<_numSlots; i++) {
+                if(i == pinned) continue;
+                if(slot < 0 || _slots[i].lastUse < _slots[slot].lastUse) slot = i;
+            }
+            if(slot < 0) return 0;
+            Partition& p = _slots[slot];
+            uint32_t range[2];
+            if(!_source->read(sizeof(Header) + 4*id, range, 8)) return 0;
+            uint32_t size = range[1] - range[0];
+            p.id = id;
+            p.lastUse = _clock;
+            p.numNodes = 0;
+            p.numEdges = 0;
+            if(!size) return 0;
+            if(size > header.maxPartitionBytes || !_source->read(_partitionsOffset + range[0], p.data, size)) {
+                p.id = UINT32_MAX;
+                return 0;
+            }
+            stats.partitionLoads++;
+            stats.bytesRead += size + 8;
+            uint32_t* counts = (uint32_t*) p.data;
+            p.numNodes = counts[0];
+            p.numEdges = counts[1];
+            p.coords = (int32_t*) (p.data + 8);
+            p.firstEdge = (uint32_t*) (p.data + 8 + 8*p.numNodes);
+            p.edges = (Edge*) (p.data + 8 + 8*p.numNodes + 4*(p.numNodes + 1));
+            return &p;
+        }
+
+        uint32_t hash(uint32_t partition, uint16_t node) {
+            uint32_t h = partition * 2654435761u ^ (node * 40503u);
+            return (h ^ (h >> 15)) & (_tableSize - 1);
+        }
+
+        int32_t find(uint32_t partition, uint16_t node) {
+            for(uint32_t h=hash(partition, node); _table[h] >= 0; h=(h + 1) & (_tableSize - 1)) {
+                Node& n = _nodes[_table[h]];
+                if(n.partition == partition && n.node == node) return _table[h];
+            }
+            return -1;
+        }
+
+        int32_t insert(uint32_t partition, uint16_t node, int32_t x, int32_t y) {
+            if(_numNodes >= _maxNodes) return -1;
+            uint32_t h = hash(partition, node);
+            while(_table[h] >= 0) h = (h + 1) & (_tableSize - 1);
+            int32_t v = _numNodes++;
+            _table[h] = v;
+            Node& n = _nodes[v];
+            n.partition = partition;
+            n.node = node;
+            n.closed = 0;
+            n.x = x;
+            n.y = y;
+            n.parent = -1;
+            return v;
+        }
+
+        bool push(int32_t node, float f) {
+            if(_heapSize >= 2*_maxNodes) return false;
+            uint32_t i = _heapSize++;
+            while(i > 0 && _heap[(i - 1)/2].f > f) {
+                _heap[i] = _heap[(i - 1)/2];
+                i = (i - 1)/2;
+            }
+            _heap[i].f = f;
+            _heap[i].node = node;
+            return true;
+        }
+
+        int32_t pop() {
+            int32_t top = _heap[0].node;
+            HeapItem last = _heap[--_heapSize];
+            uint32_t i = 0;
+            while(2*i + 1 < _heapSize) {
+                uint32_t c = 2*i + 1;
+                if(c + 1 < _heapSize && _heap[c + 1].f < _heap[c].f) c++;
+                if(_heap[c].f >= last.f) break;
+                _heap[i] = _heap[c];
+                i = c;
+            }
+            _heap[i] = last;
+            return top;
+        }
+
+    };
+
+}
+
+#endif
@@ -95,7 +95,7 @@ private:
 
 public:
     ScreenCircleSpinner(uint16_t x, uint16_t y, uint16_t size, ScreenElement* centerElement, uint8_t thickness=2, uint8_t speed=1, u16_t tickoffset=0) : ScreenElement(x, y), 
-        _halfSize(size/2), _tick(tickoffset), _color(BLACK), _centerElement(centerElement), _isStatic(false), _centerVisible(false), _thickness(thickness), _speed(speed) {};
+        _tick(tickoffset), _halfSize(size/2), _color(BLACK), _isStatic(false), _centerVisible(false), _thickness(thickness), _speed(speed), _centerElement(centerElement) {};
 
     void draw(SharedSPIDisplay* display) {
         if(!_isStatic) {
@@ -145,7 +145,7 @@ class ScreenDoubleCircleSpinner : public ScreenElement {
 
 public:
     ScreenDoubleCircleSpinner(uint16_t x, uint16_t y, uint16_t size, ScreenElement* centerElement, uint8_t thickness=2, uint8_t speed=1, uint16_t offset=180) : ScreenElement(x, y), 
-        _halfSize(size/2), _tick(0), _color(BLACK), _isStatic(false), _centerVisible(false), _thickness(thickness), _speed(speed),
+        _tick(0), _halfSize(size/2), _color(BLACK), _isStatic(false), _centerVisible(false), _thickness(thickness), _speed(speed),
         _s1(x, y, size, centerElement, thickness, speed),
         _s2(x, y, size, &_s1, thickness, speed, offset) {        
 
@@ -4,28 +4,20 @@
 #include <Arduino.h>
 #include <sharedspidevice.h>
 #include <Adafruit_GFX.h>
-#include <Adafruit_SharpMem.h>
+#include <sharpmemdisplay.h>
 #include <globalconfig.h>
 
 /*
 
-    Wrapper class for the adafruit display.
+    Wrapper class for the Sharp memory display (see sharpmemdisplay.h).
     Includes extended functionality like drawing lines with a certain thickness.
 
 */
 
-/*******************************************************************************
- * Sequence of offsets for line thickening.
- * 
- * Determines offsets of additional parallel lines with respect 
- * to the original line.
- ******************************************************************************/
-const int thickness_offsets[6] = {1, -1, 2, -2, 3, -3};
-
 class SharedSPIDisplay : public SharedSPIDevice {
 
 private:
-    Adafruit_SharpMem disp;
+    SharpMemDisplay disp;
     float zoom;
     uint8_t _PIN_CS;
 
@@ -57,8 +49,9 @@ public:
      * 
      * Draws a line from p0=(x0, y0) to p1=(x1, y1) with a given thickness and color.
      * 
-     * The modification draws parallel lines to increase line thickness.
-     * The offset of the parallel line is determined by the thickness_offsets array.
+     * The modification draws parallel lines to increase line thickness, at the offsets
+     * 1, -1, 2, -2, 3, -3 from the original line. The line is rasterized straight into
+     * the framebuffer (see SharpMemDisplay::drawThickLine).
      * For thickness = 1, the algorithm is equivalent to the original bresenham algorithm
      *
      * @param x0 x coordinate of first point (p0)
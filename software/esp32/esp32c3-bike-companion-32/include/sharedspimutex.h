@@ -4,12 +4,18 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <sharedspidevice.h>
 /*
 
     Mutex-like lock to prevent multiple active SPI devices on same bus.
     Ensures that only one chip select is active at a time.
 
+    Devices are used by several tasks (the tile prefetch task reads from the SD-card while the main loop
+    refreshes the display), so every transfer runs under a recursive bus lock. Only call aquireSPI() with
+    the lock held (see SharedSPILock).
+
 */
 
 class SharedSPIMutex {
@@ -17,6 +23,7 @@ class SharedSPIMutex {
 private:
 
     std::vector<SharedSPIDevice*> spi_devices;
+    SemaphoreHandle_t _busLock = NULL;
 
 public:
     
@@ -39,8 +46,31 @@ public:
     int getNumberDevices() {
         return spi_devices.size();
     }
+
+    void lock() {
+        // Created on first use during setup, before any other task accesses the bus
+        if(!_busLock) _busLock = xSemaphoreCreateRecursiveMutex();
+        xSemaphoreTakeRecursive(_busLock, portMAX_DELAY);
+    };
+
+    void unlock() {
+        xSemaphoreGiveRecursive(_busLock);
+    };
 };
 
 extern SharedSPIMutex SMUTEX;
 
+/*
+
+    Holds the bus lock for the current scope
+
+*/
+class SharedSPILock {
+
+public:
+    SharedSPILock() { SMUTEX.lock(); };
+    ~SharedSPILock() { SMUTEX.unlock(); };
+
+};
+
 #endif
@@ -6,6 +6,8 @@
 #include <sharedspidevice.h>
 #include <simpletile.h>
 #include <gpxtrack.h>
+#include <nameindex.h>
+#include <routing.h>
 
 /*
 
@@ -14,7 +16,7 @@
 */
 class SharedSPISDCard : public SharedSPIDevice {
 
-    enum FileType {Map, GPXTrackIn, GPXTrackOut, None};
+    enum FileType {Map, GPXTrackIn, GPXTrackOut, TrackBin, Names, Graph, None};
 
 private:
     uint8_t _PIN_CS;
@@ -23,10 +25,25 @@ private:
     char* _mapPath;
     char* _gpxTrackInPath;
     char* _gpxTrackOutPath;
+    char* _trackBinPath;
+    char* _namesPath;
+    char* _graphPath;
     
     bool openFile(const char* path);
     bool openFile(FileType fileType);
     void closeFile();
+    uint64_t lowerBoundEntry(SimpleTile::Header& header, uint64_t tile_id, uint64_t lo, uint64_t hi);
+
+    // Sorted IDs of the stored tiles of a sparse map, NULL if the index is searched on the SD-card
+    uint32_t* _sparseIndex;
+    bool readSparseIndex(SimpleTile::Header& header);
+
+    // Contiguous map file on the raw SD-card (see resolveMapSectors)
+    bool _mapRaw;
+    uint8_t _mapDrive;
+    uint32_t _mapSector;
+    bool resolveMapSectors();
+    bool readMapRaw(uint64_t offset, uint64_t size, uint8_t* buffer);
 
 public:
     uint64_t read_bytes;
@@ -40,16 +57,49 @@ public:
     void setMapPath(const char* mapPath);
     void setGPXTrackInPath(const char* gpxTrackInPath);
     void setGPXTrackOutPath(const char* gpxTrackOutPath);
+    void setTrackBinPath(const char* trackBinPath);
+    void setNamesPath(const char* namesPath);
+    void setGraphPath(const char* graphPath);
 
     bool exists(const char* path);
 
-    // Map reading
-    bool readTile(SimpleTile::Header& header, int16_t* tile_node_buffer, uint64_t& tileSize, int tile_id);
+    // Map reading. Entries of a window of tiles are read first, so the caller can allocate buffers of the exact
+    // size and read tiles that follow each other in the file at once.
+    bool readTileEntries(SimpleTile::Header& header, uint64_t x0, uint64_t y0, uint16_t width, uint16_t height, uint64_t* entries);
+    bool readTileData(SimpleTile::Header& header, uint64_t tileOffset, uint64_t tileSize, int16_t* tile_node_buffer);
     bool readHeader(SimpleTile::Header& header);
     
     // Input GPX reading
     bool readGPX(SimpleTile::Header& header, GPXTrack& track);
+    // Binary track reading (compiled by gpx2simpletrack)
+    bool readTrack(SimpleTile::Header& header, GPXTrack& track);
+
+    // Prefix search in the name index. Returns the number of results.
+    uint16_t searchNames(SimpleTile::Header& header, const char* prefix, NameIndex::Result* results, uint16_t maxResults);
+
+    // Routing graph reading
+    bool readGraph(uint32_t offset, void* buffer, uint32_t size);
+
+
+};
+
+
+/*
+
+    Routing graph on the SD-card. Partitions are read on demand by the router.
+
+*/
+class SDPartitionSource : public Routing::PartitionSource {
+
+private:
+    SharedSPISDCard* _sd;
+
+public:
+    SDPartitionSource(SharedSPISDCard* sd) : _sd(sd) {};
 
+    bool read(uint32_t offset, void* buffer, uint32_t size) {
+        return _sd->readGraph(offset, buffer, size);
+    }
 
 };
 
@@ -0,0 +1,63 @@
+#ifndef _SHARPMEMDISPLAY_H
+#define _SHARPMEMDISPLAY_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Adafruit_GFX.h>
+
+/*
+
+    Driver of the Sharp memory LCD with the protocol of the Adafruit SHARP Memory Display library, which
+    keeps its framebuffer private. Owning the framebuffer lets lines be rasterized straight into it.
+
+    The framebuffer holds 1 bit per pixel (set = white), rows of width/8 bytes, the leftmost pixel of a
+    byte in its least significant bit. This is the order in which the bytes of a line are sent (LSB first).
+
+    refresh() only sends the lines that differ from the last sent frame, which is kept in a shadow buffer.
+    The panel keeps every line it is not sent. Without changes, only VCOM is toggled, which the panel needs
+    regularly to avoid a DC bias across the liquid crystal.
+
+    Thick lines are drawn like SharedSPIDisplay::draw_line always did: a Bresenham line with a brush of
+    thickness pixels across its minor axis. The brush covers the offsets lo..hi = -(thickness-1)/2..thickness/2
+    around the line, so thickness 2 covers 0..1 and thickness 6 covers -2..3. Steps of a x-major line on the
+    same row are merged into horizontal spans, which are written as byte masks and whole bytes to the rows of
+    the brush. Every step of a y-major line writes the brush as one 16-bit mask to its row.
+
+*/
+class SharpMemDisplay : public Adafruit_GFX {
+
+private:
+    SPIClass* _spi;
+    uint8_t _cs;
+    uint32_t _freq;
+    uint8_t _vcom;
+    uint8_t* _buffer;
+    // Line as sent: address, data and trailer
+    uint8_t* _line;
+    // Frame on the panel, valid after the first refresh
+    uint8_t* _sent;
+    bool _hasSent;
+    uint16_t _stride;
+
+    // Set (color != 0) or clear the pixels x0..x1 of the rows y0..y1, clipped to the display
+    void span(int x0, int x1, int y0, int y1, uint16_t color);
+    // Brush of mask (bits 0..thickness-1) at x on row y, clipped to the display
+    void brush(int x, int y, uint16_t mask, uint8_t thickness, uint16_t color);
+
+public:
+    SharpMemDisplay(SPIClass* spi, uint8_t cs, uint16_t width, uint16_t height, uint32_t freq = 2000000);
+
+    bool begin();
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    uint8_t getPixel(uint16_t x, uint16_t y);
+    void clearDisplay();
+    void clearDisplayBuffer();
+    void refresh();
+    uint8_t* getBuffer() { return _buffer; };
+
+    // Line from p0 to p1 with a brush of 1 to 7 pixels. With dashLength, the color toggles every dashLength pixels.
+    void drawThickLine(int x0, int y0, int x1, int y1, uint8_t thickness, uint16_t color, uint8_t dashLength = 0);
+
+};
+
+#endif
@@ -5,41 +5,76 @@
 #include <FS.h>
 
 
+#include <simpletileformat.h>
+
+
 /*
 
-    Definition of map header.
+    Definition of map header. The layout of the file is defined in simpletileformat.h, which is shared with
+    the converter (software/common/include).
+
+    Maps of version 2 start with MAGIC_V2, followed by the fields of version 1, flags and n_entries.
+    Sparse maps (FLAG_SPARSE) only store n_entries tiles and contain a sorted uint32 index of their IDs.
+    Every stored tile has a 64-bit entry with its offset, size and quantization shift.
+    Local coordinates of a tile with shift s are stored in units of 2^s, so tiles may exceed the int16 range.
 
 */
 namespace SimpleTile {
 
-    // Header struct for map meta-data
-    struct Header {
-        int64_t map_x;
-        int64_t map_y;
-        uint64_t map_width;
-        uint64_t map_height;
-        uint64_t n_x_tiles;
-        uint64_t tile_size;
-        uint64_t n_tiles;
-        uint64_t max_nodes;
-        uint64_t n_nodes;
-        uint64_t n_ways;
+    using SimpleTileFormat::MAGIC_V2;
+    using SimpleTileFormat::FLAG_SPARSE;
+    using SimpleTileFormat::entryOffset;
+    using SimpleTileFormat::entrySize;
+    using SimpleTileFormat::entryShift;
+    using SimpleTileFormat::packEntry;
+    using SimpleTileFormat::crc32;
+
+    // Header struct for map meta-data. The fields of version 1 are stored as in the file.
+    struct Header : public SimpleTileFormat::MapHeader {
+        // Version 2 only
+        uint64_t flags;
+        uint64_t n_entries;
+
+        // File layout, derived when the header is read
+        uint8_t version;
+        uint64_t index_offset;
+        uint64_t entries_offset;
+        uint64_t data_offset;
+
+        // Takes over the header parsed from the start of the file and derives the file layout
+        void setLayout(uint8_t fileVersion) {
+            version = fileVersion;
+            index_offset = version == 2 ? SimpleTileFormat::indexOffset() : 0;
+            entries_offset = SimpleTileFormat::entriesOffset(version, flags, n_entries);
+            data_offset = SimpleTileFormat::dataOffset(version, flags, n_entries);
+        }
+
+        // Position of the pointer (version 1) or entry (version 2) of a tile in the file
+        uint64_t entryPosition(uint64_t entryId) {
+            return entries_offset + sizeof(uint64_t)*entryId;
+        }
 
         void print() {
-            Serial.printf("map_X: %i\n", map_x);
-            Serial.printf("map_Y: %i\n", map_y);
-            Serial.printf("map_width: %i\n", map_width);
-            Serial.printf("map_height: %i\n", map_height);
-            Serial.printf("n_x_tiles: %i\n", n_x_tiles);
-            Serial.printf("tile_size: %i\n", tile_size);
-            Serial.printf("n_tiles: %i\n", n_tiles);
-            Serial.printf("max_nodes: %i\n", max_nodes);
-            Serial.printf("n_nodes: %i\n", n_nodes);
-            Serial.printf("n_ways: %i\n", n_ways);
+            Serial.printf("version: %i\n", version);
+            Serial.printf("map_X: %lld\n", (long long) map_x);
+            Serial.printf("map_Y: %lld\n", (long long) map_y);
+            Serial.printf("map_width: %llu\n", (unsigned long long) map_width);
+            Serial.printf("map_height: %llu\n", (unsigned long long) map_height);
+            Serial.printf("n_x_tiles: %llu\n", (unsigned long long) n_x_tiles);
+            Serial.printf("tile_size: %llu\n", (unsigned long long) tile_size);
+            Serial.printf("n_tiles: %llu\n", (unsigned long long) n_tiles);
+            Serial.printf("max_nodes: %llu\n", (unsigned long long) max_nodes);
+            Serial.printf("n_nodes: %llu\n", (unsigned long long) n_nodes);
+            Serial.printf("n_ways: %llu\n", (unsigned long long) n_ways);
+            Serial.printf("n_entries: %llu\n", (unsigned long long) n_entries);
+        }
+
+        // CRC32 of the version 1 fields. Sidecar files (tracks, name index) store it to identify their map.
+        uint32_t crc() {
+            return crc32(static_cast<SimpleTileFormat::MapHeader*>(this), sizeof(SimpleTileFormat::MapHeader));
         }
     };
 
 }
 
-
 #endif
\ No newline at end of file
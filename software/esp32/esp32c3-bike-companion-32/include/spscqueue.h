@@ -0,0 +1,47 @@
+#ifndef _SPSCQUEUE_H
+#define _SPSCQUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+
+    Lock-free queue between exactly one producer task and one consumer task. Holds at most N-1 items.
+    The producer only writes _head, the consumer only writes _tail. An item is written before _head is
+    published (release) and read after _head was observed (acquire), so the consumer never sees a
+    partially written item.
+
+*/
+template <typename T, uint16_t N>
+class SPSCQueue {
+
+private:
+    T _items[N];
+    std::atomic<uint16_t> _head;
+    std::atomic<uint16_t> _tail;
+
+public:
+    SPSCQueue() : _head(0), _tail(0) {};
+
+    // Producer. Returns false if the queue is full.
+    bool push(const T& item) {
+        uint16_t head = _head.load(std::memory_order_relaxed);
+        uint16_t next = (head + 1) % N;
+        if(next == _tail.load(std::memory_order_acquire)) return false;
+        _items[head] = item;
+        _head.store(next, std::memory_order_release);
+        return true;
+    };
+
+    // Consumer. Returns false if the queue is empty.
+    bool pop(T& item) {
+        uint16_t tail = _tail.load(std::memory_order_relaxed);
+        if(tail == _head.load(std::memory_order_acquire)) return false;
+        item = _items[tail];
+        _tail.store((tail + 1) % N, std::memory_order_release);
+        return true;
+    };
+
+};
+
+#endif
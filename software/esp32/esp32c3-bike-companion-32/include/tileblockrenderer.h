@@ -3,49 +3,125 @@
 
 #include <sharedspidisplay.h>
 #include <sharedspisdcard.h>
+#include <flashmap.h>
 #include <geoposition.h>
 #include <geopositionprovider.h>
+#include <spscqueue.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
 
 /*
 
     Map renderer. Renders a block of tiles to the display buffer.
 
+    Tiles are read by a prefetch task, so reading from SD never stalls a frame. The renderer owns the tile
+    cache: it assigns a slot and arena space of the tile's size to every tile it needs and sends a request
+    to the task, which reads the tile into the arena and sends it back. Tiles that follow each other in the
+    file are requested at once. A slot is not rendered or replaced while its tile is loading.
+
+    With a map in flash (see flashmap.h), slots point into the memory-mapped tile data instead of the arena.
+    Tiles are rendered in place, there is no arena, entry window or prefetch task.
+
 */
 
+// Request of tile data from the prefetch task. Sizes are in bytes.
+struct TileRequest {
+    uint32_t arenaOffset;
+    uint64_t tileOffset;
+    uint64_t tileSize;
+};
+
+// Tile data read by the prefetch task. Offset and size are counts of int16_t values.
+struct TileLoad {
+    uint32_t arenaOffset;
+    uint32_t size;
+    bool success;
+};
+
+// State of the entry window that is read by the prefetch task
+enum EntriesState : uint8_t {EntriesIdle, EntriesPending, EntriesLoaded, EntriesFailed};
+
 class TileBlockRenderer {
 
 private:
 
     bool _hasPositionProvider, _hasHeader, _hasTrackIn;
     float _zoomLevel, _zoomScale;
+    // Screen pixels per mercator unit and sine and cosine of the heading in Q16 fixed point
+    int32_t _scaleQ16, _sinHeading, _cosHeading;
     int _heading;
-    float* _rotMtxBuf;
     uint64_t* _renderTileIds;
-    int16_t* _renderTileData;
-    uint64_t* _renderTileSizes;
-    uint64_t _perTileBufferSize;    
-    uint64_t _centerTileId, _prevCenterTileId;
-    long long _prevCenterChangeTime, _prevTileUpdateTime;
+    int16_t* _renderTileSlots;
+    int16_t* _arena;
+    // Start of the tile data that slot offsets refer to: the arena or the map in flash
+    const int16_t* _tileBase;
+    uint32_t _arenaSize, _arenaUsed, _arenaLive;
+    bool _arenaFull;
+    uint64_t _fullCenterTileId;
+    uint64_t* _slotTileIds;
+    uint32_t* _slotOffsets;
+    uint32_t* _slotSizes;
+    uint8_t* _slotShifts;
+    uint32_t* _slotLastUse;
+    bool* _slotLoading;
+    uint16_t _numSlots, _numLoading;
+    uint32_t _cacheClock;
     int* _offsetDirectionMap;
 
+    // Entry window
+    uint64_t* _entries;
+    uint64_t* _nextEntries;
+    uint64_t _entriesX0, _entriesY0, _nextEntriesX0, _nextEntriesY0;
+    bool _hasEntries;
+    std::atomic<uint8_t> _entriesState;
+
+    // Prefetching
+    SPSCQueue<TileRequest, PREFETCH_QUEUE_SIZE> _requests;
+    SPSCQueue<TileLoad, PREFETCH_QUEUE_SIZE> _loads;
+    TaskHandle_t _prefetchTask;
+    SemaphoreHandle_t _prefetchWake;
+    uint64_t* _prefetchTileIds;
+    uint16_t _numPrefetch;
+    unsigned long _tLastPrediction;
+    int64_t _lastX, _lastY;
+    uint32_t _trackRun;
+
     SimpleTile::Header* _header;
     SharedSPISDCard* _sd;
+    FlashMap* _flashMap;
     SharedSPIDisplay* _display;
     GPXTrack* _track;
+    GPXTrack* _reroute;
     GeoPositionProvider* _positionProvider;
 
+    int32_t slotOf(uint64_t tileId);
+    int32_t allocate(uint32_t size);
+    void evict(uint16_t slot);
+    void compact();
+    int32_t freeSlot();
+    bool tileEntry(uint64_t tileId, uint64_t& entry);
+    bool updateEntries(LocalGeoPosition& center);
+    bool requestTiles(const uint64_t* tileIds, uint16_t n);
+    void collectLoads();
+    void loadTiles();
+    void predictTiles(LocalGeoPosition& center);
     void updateTileBuffer(LocalGeoPosition& center);
+    static void prefetchTask(void* renderer);
     void render(LocalGeoPosition& center);
-    void renderGPX(LocalGeoPosition& center);
+    void renderGPX(LocalGeoPosition& center, GPXTrack* track, uint8_t width);
 
-    bool isOnDisplay(int disp_LL_x, int disp_LL_y, int disp_UR_x, int disp_UR_y, int16_t x0, int16_t y0);
+    void drawSegment(int x0, int y0, int x1, int y1, uint8_t width);
 
 public:
     TileBlockRenderer();
 
-    bool initialize(SimpleTile::Header* mapHeader, SharedSPISDCard* sd, SharedSPIDisplay* display);
+    bool initialize(SimpleTile::Header* mapHeader, SharedSPISDCard* sd, SharedSPIDisplay* display,
+                    FlashMap* flashMap = NULL);
     void setPositionProvider(GeoPositionProvider* newPositionProvider);
     void setGPXTrackIn(GPXTrack* track);
+    void setReroute(GPXTrack* route);
     void setZoom(float newZoomLevel);
     bool step(bool holdOn=false);
 
@@ -0,0 +1,50 @@
+#ifndef _TURNCUES_H
+#define _TURNCUES_H
+
+#include <Arduino.h>
+#include <geoposition.h>
+#include <gpxtrack.h>
+#include <simpletile.h>
+
+/*
+
+    Follows the rider along the turn cues of a binary track. The position along the track is kept as a pointer
+    to the next track point, which is advanced by a few points per position, so no geometry has to be searched
+    while riding. Only if the rider is far away from that point, the nearest point of the full track is searched.
+
+*/
+class TurnCues {
+
+private:
+    bool _ready, _onTrack;
+    // Next track point ahead of the rider and the run it belongs to
+    uint32_t _next, _run;
+    // Next cue ahead of the rider
+    uint32_t _cue;
+    // Distance along the track of the next point and distance to the next cue in meters
+    float _along, _distance;
+    int64_t _prevX, _prevY, _nextX, _nextY;
+    unsigned long _tLastResync;
+
+    SimpleTile::Header* _header;
+    GPXTrack* _track;
+
+    void point(uint32_t pointId, int64_t* x, int64_t* y);
+    float segmentLength(int64_t x0, int64_t y0, int64_t x1, int64_t y1);
+    void seek(uint32_t pointId);
+    void resync(GeoPosition& pos);
+    void project(GeoPosition& pos, float& remaining, float& offTrack);
+
+public:
+    TurnCues();
+
+    bool initialize(SimpleTile::Header* header, GPXTrack* track);
+    void step(GeoPosition& pos);
+    // True if the rider is on the track and a turn lies ahead
+    bool hasNext();
+    // Next turn and distance to it in meters. Only valid if hasNext() is true.
+    TrackCue* next();
+    uint32_t distanceToNext();
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include <gnssmodule.h>
 #include <screens.h>
 #include <globalconfig.h>
+#include <turncues.h>
 
 /*
 
@@ -16,10 +17,10 @@
 
 class UIRenderer {
 
-    enum StatusBarElement {time, date, speed, heading, lat, lon, nsats, err};
+    enum StatusBarElement {time, date, speed, heading, lat, lon, nsats, turn, err};
 
 private:
-    bool _hasGNSS, _hasPositionProvider, _hasHeader, _hasDisplay, _hasTrackIn;
+    bool _hasGNSS, _hasPositionProvider, _hasHeader, _hasDisplay, _hasTrackIn, _hasTurnCues;
     unsigned long _tLastRender, _tLoopRender;
     char* _textBuffer;
 
@@ -31,6 +32,7 @@ private:
     SimpleTile::Header* _header;
     GeoPositionProvider* _posProvider;
     GPXTrack* _track;
+    TurnCues* _turnCues;
     TileBlockRenderer _mapRenderer;
 
     void renderBootScreen();
@@ -41,13 +43,15 @@ private:
 public:
     UIRenderer();
 
-    bool initializeMap(SharedSPISDCard* sd);
+    bool initializeMap(SharedSPISDCard* sd, FlashMap* flashMap = NULL);
     void setDisplay(SharedSPIDisplay* display);
     void setGNSS(GNSSModule* gnss);
     void setPositionProvider(GeoPositionProvider* positionProvider);
     void setScreen(Screen* newScreen);
     void setHeader(SimpleTile::Header* header);
     void setGPXTrackIn(GPXTrack* track);
+    void setReroute(GPXTrack* route);
+    void setTurnCues(TurnCues* turnCues);
     bool step();
     void delay(uint64_t milliseconds);
 };
@@ -0,0 +1,55 @@
+#ifndef _SIM_ADAFRUIT_GFX_H
+#define _SIM_ADAFRUIT_GFX_H
+
+#include <Arduino.h>
+
+/*
+
+    Drawing primitives with the interface of the Adafruit GFX library. Shapes are drawn pixel by pixel
+    through drawPixel() of the display. The simulator has no font, every character is drawn as the
+    outline of its 5x7 glyph cell, which keeps the layout of the text visible in the dumped frames.
+
+*/
+class Adafruit_GFX : public Print {
+
+public:
+    Adafruit_GFX(int16_t w, int16_t h);
+
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+    void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void fillScreen(uint16_t color);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+    void drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornername, uint16_t color);
+    void fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, int16_t delta, uint16_t color);
+    void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+    void fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color);
+
+    void setCursor(int16_t x, int16_t y) { _cursorX = x; _cursorY = y; };
+    void setTextSize(uint8_t s) { _textSize = s ? s : 1; };
+    void setTextColor(uint16_t c) { _textColor = c; };
+    void setTextColor(uint16_t c, uint16_t bg) { _textColor = c; };
+    void setTextWrap(bool w) { _wrap = w; };
+    void setRotation(uint8_t r) {};
+    void cp437(bool x = true) {};
+    void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint8_t size);
+
+    size_t write(uint8_t c);
+    using Print::write;
+
+    int16_t width() const { return _width; };
+    int16_t height() const { return _height; };
+
+protected:
+    int16_t _width, _height;
+    int16_t _cursorX, _cursorY;
+    uint8_t _textSize;
+    uint16_t _textColor;
+    bool _wrap;
+
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef _SIM_ARDUINO_H
+#define _SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+/*
+
+    Arduino core of the simulator. Only provides what the firmware uses. Time is virtual: it runs with
+    the wall clock while the firmware works, but delays return immediately and advance the clock instead
+    of sleeping (see simulator.h).
+
+*/
+
+using std::min;
+using std::max;
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+#define SERIAL_8N1 0x800001c
+
+// Pins of the Seeed XIAO ESP32C3
+enum { D0 = 2, D1 = 3, D2 = 4, D3 = 5, D4 = 6, D5 = 7, D6 = 21, D7 = 20, D8 = 8, D9 = 9, D10 = 10 };
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void sleep(unsigned int seconds);
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) {}
+inline int digitalRead(uint8_t pin) { return LOW; }
+
+
+/*
+
+    String with the part of the Arduino interface used by the firmware
+
+*/
+class String : public std::string {
+
+public:
+    String() {};
+    String(const char* s) : std::string(s) {};
+    String(const std::string& s) : std::string(s) {};
+
+    unsigned int length() const { return size(); };
+    int indexOf(const char* s, unsigned int from = 0) const {
+        size_t p = find(s, from);
+        return p == npos ? -1 : (int) p;
+    };
+    int indexOf(char c, unsigned int from = 0) const {
+        size_t p = find(c, from);
+        return p == npos ? -1 : (int) p;
+    };
+    String substring(unsigned int from, unsigned int to) const {
+        if(from > size()) return String();
+        return String(substr(from, to > from ? to - from : 0));
+    };
+    String substring(unsigned int from) const {
+        return substring(from, size());
+    };
+    void trim() {
+        size_t first = find_first_not_of(" \t\r\n");
+        if(first == npos) {
+            clear();
+            return;
+        }
+        *this = substr(first, find_last_not_of(" \t\r\n") - first + 1);
+    };
+    double toDouble() const { return atof(c_str()); };
+    float toFloat() const { return atof(c_str()); };
+    long toInt() const { return atol(c_str()); };
+
+};
+
+
+/*
+
+    Formatted output like the Arduino Print class. Subclasses implement write(uint8_t).
+
+*/
+class Print {
+
+public:
+    virtual ~Print() {};
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while(size--) n += write(*buffer++);
+        return n;
+    };
+    size_t write(const char* str) {
+        return str ? write((const uint8_t*) str, strlen(str)) : 0;
+    };
+
+    size_t print(const char* s) { return write(s); };
+    size_t print(const String& s) { return write((const uint8_t*) s.c_str(), s.length()); };
+    size_t print(char c) { return write((uint8_t) c); };
+    size_t print(int n) { return printf("%d", n); };
+    size_t print(unsigned int n) { return printf("%u", n); };
+    size_t print(long n) { return printf("%ld", n); };
+    size_t print(unsigned long n) { return printf("%lu", n); };
+    size_t print(long long n) { return printf("%lld", n); };
+    size_t print(unsigned long long n) { return printf("%llu", n); };
+    size_t print(double n, int digits = 2) { return printf("%.*f", digits, n); };
+
+    template <typename T>
+    size_t println(T value) { return print(value) + println(); };
+    size_t println() { return write((const uint8_t*) "\r\n", 2); };
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+};
+
+
+/*
+
+    Byte stream with the part of the Arduino interface used by the firmware
+
+*/
+class Stream : public Print {
+
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    size_t readBytes(char* buffer, size_t length) {
+        size_t n = 0;
+        int c;
+        while(n < length && (c = read()) >= 0) buffer[n++] = c;
+        return n;
+    };
+    String readStringUntil(char terminator) {
+        String s;
+        int c;
+        while((c = read()) >= 0 && c != terminator) s += (char) c;
+        return s;
+    };
+
+};
+
+
+/*
+
+    Serial console. Output goes to stdout, there is never any input.
+
+*/
+class SimSerial : public Stream {
+
+public:
+    void begin(unsigned long baud) {};
+    size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; };
+    using Print::write;
+    int available() { return 0; };
+    int read() { return -1; };
+    int peek() { return -1; };
+    operator bool() const { return true; };
+
+};
+
+extern SimSerial Serial;
+
+
+/*
+
+    UART of the GNSS module. Receives the NMEA sentences of the scripted ride (see gnss.cpp).
+
+*/
+class HardwareSerial : public Stream {
+
+public:
+    HardwareSerial(int uartNumber) {};
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+    size_t write(uint8_t c);
+    using Print::write;
+    int available();
+    int read();
+    int peek();
+
+};
+
+
+/*
+
+    Free heap of the device. Configurable, as the heap of the host is not a limit.
+
+*/
+class EspClass {
+
+public:
+    uint32_t getFreeHeap();
+
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _SIM_FS_H
+#define _SIM_FS_H
+
+#include <Arduino.h>
+#include <memory>
+
+/*
+
+    File system of the simulator. Files are regular files below Sim::config.sdRoot, every read is
+    counted in Sim::sd.
+
+*/
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+    class File : public Stream {
+
+    public:
+        File() {};
+        File(FILE* f);
+
+        size_t write(uint8_t c);
+        size_t write(const uint8_t* buffer, size_t size);
+        using Print::write;
+        int available();
+        int read();
+        int peek();
+        size_t read(uint8_t* buffer, size_t size);
+        size_t readBytes(char* buffer, size_t length);
+        String readStringUntil(char terminator);
+        bool seek(uint32_t pos);
+        size_t position() const;
+        size_t size() const;
+        void flush();
+        void close();
+        operator bool() const { return (bool) _file; };
+
+    private:
+        std::shared_ptr<FILE> _file;
+
+    };
+
+    class FS {
+
+    public:
+        File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+        bool exists(const char* path);
+        bool remove(const char* path);
+
+    };
+
+}
+
+using fs::File;
+using fs::FS;
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _SIM_MICRONMEA_H
+#define _SIM_MICRONMEA_H
+
+#include <Arduino.h>
+
+/*
+
+    NMEA parser with the interface of the MicroNMEA library. Only RMC (position, speed, course, time)
+    and GGA (number of satellites) sentences are evaluated, checksums are not verified.
+
+*/
+class MicroNMEA {
+
+public:
+    MicroNMEA(void* buffer, uint8_t len);
+
+    bool process(char c);
+
+    bool isValid() const { return _valid; };
+    long getLatitude() const { return _latitude; };
+    long getLongitude() const { return _longitude; };
+    // Thousandths of a knot
+    long getSpeed() const { return _speed; };
+    // Thousandths of a degree
+    long getCourse() const { return _course; };
+    uint8_t getNumSatellites() const { return _numSat; };
+    uint8_t getHour() const { return _hour; };
+    uint8_t getMinute() const { return _minute; };
+    uint8_t getSecond() const { return _second; };
+    uint8_t getDay() const { return _day; };
+    uint8_t getMonth() const { return _month; };
+    uint16_t getYear() const { return _year; };
+
+    // Appends the checksum to a sentence and sends it
+    static Stream& sendSentence(Stream& s, const char* sentence);
+
+private:
+    std::string _sentence;
+    bool _valid;
+    long _latitude, _longitude, _speed, _course;
+    uint8_t _numSat, _hour, _minute, _second, _day, _month;
+    uint16_t _year;
+
+    bool processSentence();
+
+};
+
+#endif
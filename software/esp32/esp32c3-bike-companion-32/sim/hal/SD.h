@@ -0,0 +1,27 @@
+#ifndef _SIM_SD_H
+#define _SIM_SD_H
+
+#include <FS.h>
+#include <SPI.h>
+
+/*
+
+    SD-card of the simulator, mounted from Sim::config.sdRoot
+
+*/
+namespace fs {
+
+    class SDFS : public FS {
+
+    public:
+        bool begin(uint8_t ssPin = D7, SPIClass& spi = SPI, uint32_t frequency = 4000000,
+            const char* mountpoint = "/sd", uint8_t max_files = 5, bool format_if_empty = false);
+        void end() {};
+
+    };
+
+}
+
+extern fs::SDFS SD;
+
+#endif
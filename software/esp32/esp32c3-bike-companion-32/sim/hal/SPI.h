@@ -0,0 +1,39 @@
+#ifndef _SIM_SPI_H
+#define _SIM_SPI_H
+
+#include <Arduino.h>
+
+/*
+
+    SPI bus of the simulator. The SD-card is simulated directly, so the only device that receives bytes
+    over the bus is the Sharp memory LCD (see display.cpp). A transaction is one command to the LCD.
+
+*/
+#define LSBFIRST 0
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+class SPISettings {
+
+public:
+    SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0) {};
+
+};
+
+class SPIClass {
+
+public:
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {};
+    void end() {};
+    void setFrequency(uint32_t freq) {};
+
+    void beginTransaction(SPISettings settings);
+    void endTransaction();
+    uint8_t transfer(uint8_t data);
+    void writeBytes(const uint8_t* data, uint32_t size);
+
+};
+
+extern SPIClass SPI;
+
+#endif
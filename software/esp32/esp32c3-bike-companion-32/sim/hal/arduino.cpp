@@ -0,0 +1,66 @@
+#include <Arduino.h>
+#include <simulator.h>
+
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+
+SimSerial Serial;
+EspClass ESP;
+
+namespace {
+
+    std::chrono::steady_clock::time_point& clockStart() {
+        // Function local, so the clock is valid during the static initialization of the firmware
+        static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    // Tasks read the clock from other threads
+    std::atomic<uint64_t> skipped(0);
+
+}
+
+uint64_t Sim::now() {
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - clockStart();
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + skipped;
+}
+
+void Sim::advance(uint64_t microseconds) {
+    skipped += microseconds;
+}
+
+unsigned long millis() {
+    // Wraps like on the device
+    return (uint32_t) (Sim::now() / 1000);
+}
+
+unsigned long micros() {
+    return (uint32_t) Sim::now();
+}
+
+void delay(uint32_t ms) {
+    Sim::advance((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    Sim::advance(us);
+}
+
+void sleep(unsigned int seconds) {
+    Sim::advance((uint64_t) seconds * 1000000);
+}
+
+size_t Print::printf(const char* format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if(n < 0) return 0;
+    return write((const uint8_t*) buffer, std::min<size_t>(n, sizeof(buffer) - 1));
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return Sim::config.freeHeap;
+}
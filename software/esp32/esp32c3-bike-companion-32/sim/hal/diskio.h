@@ -0,0 +1,21 @@
+#ifndef _SIM_DISKIO_H
+#define _SIM_DISKIO_H
+
+#include <ff.h>
+
+/*
+
+    Sector access to the FatFs volume of the simulator
+
+*/
+typedef enum {
+    RES_OK = 0,
+    RES_ERROR,
+    RES_WRPRT,
+    RES_NOTRDY,
+    RES_PARERR
+} DRESULT;
+
+DRESULT disk_read(BYTE pdrv, BYTE* buff, LBA_t sector, UINT count);
+
+#endif
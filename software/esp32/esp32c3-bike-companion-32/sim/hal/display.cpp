@@ -0,0 +1,237 @@
+#include <Adafruit_GFX.h>
+#include <SPI.h>
+#include <simulator.h>
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h) :
+    _width(w), _height(h), _cursorX(0), _cursorY(0), _textSize(1), _textColor(0), _wrap(true) {};
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    for(int16_t i=0; i<h; i++) drawPixel(x, y + i, color);
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    for(int16_t i=0; i<w; i++) drawPixel(x + i, y, color);
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for(int16_t i=0; i<h; i++) drawFastHLine(x, y + i, w, color);
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    drawFastHLine(x, y, w, color);
+    drawFastHLine(x, y + h - 1, w, color);
+    drawFastVLine(x, y, h, color);
+    drawFastVLine(x + w - 1, y, h, color);
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color) {
+    fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    while(true) {
+        drawPixel(x0, y0, color);
+        if(x0 == x1 && y0 == y1) break;
+        int e2 = 2*err;
+        if(e2 > dy) { err += dy; x0 += sx; }
+        if(e2 < dx) { err += dx; y0 += sy; }
+    }
+}
+
+// Quarter circles of the midpoint algorithm. Corners: 1 = upper left, 2 = upper right, 4 = lower right, 8 = lower left
+void Adafruit_GFX::drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornername, uint16_t color) {
+    int16_t f = 1 - r, ddF_x = 1, ddF_y = -2*r, x = 0, y = r;
+    while(x < y) {
+        if(f >= 0) {
+            y--;
+            ddF_y += 2;
+            f += ddF_y;
+        }
+        x++;
+        ddF_x += 2;
+        f += ddF_x;
+        if(cornername & 0x4) {
+            drawPixel(x0 + x, y0 + y, color);
+            drawPixel(x0 + y, y0 + x, color);
+        }
+        if(cornername & 0x2) {
+            drawPixel(x0 + x, y0 - y, color);
+            drawPixel(x0 + y, y0 - x, color);
+        }
+        if(cornername & 0x8) {
+            drawPixel(x0 - y, y0 + x, color);
+            drawPixel(x0 - x, y0 + y, color);
+        }
+        if(cornername & 0x1) {
+            drawPixel(x0 - y, y0 - x, color);
+            drawPixel(x0 - x, y0 - y, color);
+        }
+    }
+}
+
+// Filled halves of a circle. Corners: 1 = right half, 2 = left half
+void Adafruit_GFX::fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, int16_t delta, uint16_t color) {
+    int16_t f = 1 - r, ddF_x = 1, ddF_y = -2*r, x = 0, y = r;
+    int16_t px = x, py = y;
+    delta++;
+    while(x < y) {
+        if(f >= 0) {
+            y--;
+            ddF_y += 2;
+            f += ddF_y;
+        }
+        x++;
+        ddF_x += 2;
+        f += ddF_x;
+        if(x < (y + 1)) {
+            if(corners & 1) drawFastVLine(x0 + x, y0 - y, 2*y + delta, color);
+            if(corners & 2) drawFastVLine(x0 - x, y0 - y, 2*y + delta, color);
+        }
+        if(y != py) {
+            if(corners & 1) drawFastVLine(x0 + py, y0 - px, 2*px + delta, color);
+            if(corners & 2) drawFastVLine(x0 - py, y0 - px, 2*px + delta, color);
+            py = y;
+        }
+        px = x;
+    }
+}
+
+void Adafruit_GFX::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+    drawFastVLine(x0, y0 - r, 2*r + 1, color);
+    fillCircleHelper(x0, y0, r, 3, 0, color);
+}
+
+void Adafruit_GFX::fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color) {
+    // Sort by y
+    if(y0 > y1) { std::swap(y0, y1); std::swap(x0, x1); }
+    if(y1 > y2) { std::swap(y2, y1); std::swap(x2, x1); }
+    if(y0 > y1) { std::swap(y0, y1); std::swap(x0, x1); }
+
+    if(y0 == y2) {
+        int16_t a = std::min(x0, std::min(x1, x2));
+        int16_t b = std::max(x0, std::max(x1, x2));
+        drawFastHLine(a, y0, b - a + 1, color);
+        return;
+    }
+
+    // Spans between the long edge 0-2 and the short edges 0-1 and 1-2
+    for(int16_t y=y0; y<=y2; y++) {
+        int16_t a = x0 + (int32_t) (x2 - x0) * (y - y0) / (y2 - y0);
+        int16_t b;
+        if(y < y1 || y1 == y2) {
+            b = y1 == y0 ? x1 : x0 + (int32_t) (x1 - x0) * (y - y0) / (y1 - y0);
+        } else {
+            b = x1 + (int32_t) (x2 - x1) * (y - y1) / (y2 - y1);
+        }
+        if(a > b) std::swap(a, b);
+        drawFastHLine(a, y, b - a + 1, color);
+    }
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint8_t size) {
+    if(c == ' ') return;
+    drawRect(x, y, 5*size, 7*size, color);
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+    if(c == '\n') {
+        _cursorX = 0;
+        _cursorY += 8*_textSize;
+    } else if(c != '\r') {
+        if(_wrap && _cursorX + 6*_textSize > _width) {
+            _cursorX = 0;
+            _cursorY += 8*_textSize;
+        }
+        drawChar(_cursorX, _cursorY, c, _textColor, _textSize);
+        _cursorX += 6*_textSize;
+    }
+    return 1;
+}
+
+
+
+/*
+
+    Sharp memory LCD on the SPI bus. Decodes the commands of the firmware's driver: a write command is
+    followed by lines of address (1-based), data and a trailing 0x00 and ends with another 0x00, a clear
+    command is followed by 0x00. The panel keeps its memory, lines that are not written keep their content.
+    The memory is handed to the simulator as a frame at the end of every write command and of every display
+    command, which only toggles VCOM.
+
+*/
+namespace {
+
+    const uint16_t PANEL_WIDTH = 144;
+    const uint16_t PANEL_HEIGHT = 168;
+    const uint16_t PANEL_STRIDE = PANEL_WIDTH / 8;
+
+    enum PanelState {Command, Address, Data, Trailer, Done};
+
+    uint8_t panel[PANEL_STRIDE * PANEL_HEIGHT];
+    bool panelCleared = false;
+    PanelState state = Done;
+    // Write or display command in this transaction
+    bool refreshing = false;
+    uint8_t line = 0;
+    uint16_t position = 0;
+
+    void receive(uint8_t byte) {
+        switch(state) {
+            case Command:
+                refreshing = !(byte & 0x04);
+                if(!refreshing) memset(panel, 0xFF, sizeof(panel));
+                state = (byte & 0x01) ? Address : Done;
+                break;
+            case Address:
+                if(!byte) {
+                    state = Done;
+                    break;
+                }
+                line = byte - 1;
+                position = 0;
+                state = line < PANEL_HEIGHT ? Data : Done;
+                break;
+            case Data:
+                panel[line*PANEL_STRIDE + position++] = byte;
+                if(position == PANEL_STRIDE) {
+                    Sim::lcd.lines++;
+                    state = Trailer;
+                }
+                break;
+            case Trailer:
+                state = Address;
+                break;
+            case Done:
+                break;
+        }
+    }
+
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+    if(!panelCleared) {
+        memset(panel, 0xFF, sizeof(panel));
+        panelCleared = true;
+    }
+    state = Command;
+    refreshing = false;
+}
+
+void SPIClass::endTransaction() {
+    if(refreshing) Sim::onRefresh(panel, PANEL_WIDTH, PANEL_HEIGHT);
+    refreshing = false;
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    Sim::lcd.bytes++;
+    receive(data);
+    return 0;
+}
+
+void SPIClass::writeBytes(const uint8_t* data, uint32_t size) {
+    Sim::lcd.bytes += size;
+    for(uint32_t i=0; i<size; i++) receive(data[i]);
+}
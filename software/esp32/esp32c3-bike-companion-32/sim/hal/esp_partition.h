@@ -0,0 +1,46 @@
+#ifndef _SIM_ESP_PARTITION_H
+#define _SIM_ESP_PARTITION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+
+    Partition API of ESP-IDF 4.4. Only what the firmware uses to map the map partition. The partition
+    is a buffer of the size in partitions_flashmap.csv that holds the file given with --flash-map (see flash.cpp).
+
+*/
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_ANY = 0xff
+} esp_partition_subtype_t;
+
+typedef enum {
+    SPI_FLASH_MMAP_DATA,
+    SPI_FLASH_MMAP_INST
+} spi_flash_mmap_memory_t;
+
+typedef uint32_t spi_flash_mmap_handle_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    uint8_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label);
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             spi_flash_mmap_memory_t memory, const void** out_ptr, spi_flash_mmap_handle_t* out_handle);
+void esp_partition_munmap(spi_flash_mmap_handle_t handle);
+
+#endif
@@ -0,0 +1,130 @@
+#include <ff.h>
+#include <diskio.h>
+#include <simulator.h>
+
+#include <string.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <string>
+
+/*
+
+    FAT32 volume of the simulator. Every opened file gets a cluster chain from the next free cluster on.
+    The FAT sectors are generated from the chains, data sectors are read from the files of the SD-card
+    directory. With Sim::config.mapLayout == "fragmented", the chain of a file jumps over one cluster in
+    the middle of the file, with "vfs" there is no volume and f_open fails.
+
+*/
+namespace {
+
+    const uint16_t SECTOR = 512;
+    const uint16_t CLUSTER_SECTORS = 8;
+    const uint32_t CLUSTER = SECTOR * CLUSTER_SECTORS;
+
+    struct Chain {
+        std::string path;
+        uint32_t first;
+        uint32_t clusters;
+        // Index of the cluster that does not follow its predecessor, 0 for contiguous files
+        uint32_t gap;
+    };
+
+    FATFS volume = {FS_FAT32, 0, CLUSTER_SECTORS, SECTOR, 1 << 20, 32, 32 + (1 << 20) * 4 / SECTOR};
+    Chain chains[8];
+    uint8_t nChains = 0;
+    std::mutex mutex;
+
+    // Cluster of the index-th cluster of a chain
+    uint32_t clusterOf(const Chain& chain, uint32_t index) {
+        return chain.first + index + (chain.gap && index >= chain.gap ? 1 : 0);
+    }
+
+    // FAT entry of a cluster
+    uint32_t fatEntry(uint32_t cluster) {
+        for(uint8_t i=0; i<nChains; i++) {
+            const Chain& chain = chains[i];
+            for(uint32_t j=0; j<chain.clusters; j++) {
+                if(clusterOf(chain, j) != cluster) continue;
+                return j + 1 < chain.clusters ? clusterOf(chain, j + 1) : 0x0FFFFFFF;
+            }
+        }
+        return 0;
+    }
+
+    bool readData(uint32_t cluster, uint32_t sectorInCluster, BYTE* buff) {
+        memset(buff, 0, SECTOR);
+        for(uint8_t i=0; i<nChains; i++) {
+            const Chain& chain = chains[i];
+            for(uint32_t j=0; j<chain.clusters; j++) {
+                if(clusterOf(chain, j) != cluster) continue;
+                FILE* f = fopen(chain.path.c_str(), "rb");
+                if(!f) return false;
+                fseek(f, (uint64_t) j * CLUSTER + sectorInCluster * SECTOR, SEEK_SET);
+                size_t n = fread(buff, 1, SECTOR, f);
+                fclose(f);
+                Sim::sd.bytesRead += n;
+                return true;
+            }
+        }
+        return true;
+    }
+
+}
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(Sim::config.mapLayout == "vfs" || strncmp(path, "0:", 2)) return FR_NOT_READY;
+    std::string root = Sim::config.sdRoot;
+    if(!root.empty() && root[root.size() - 1] == '/') root.erase(root.size() - 1);
+    std::string hostPath = root + (path[2] == '/' ? "" : "/") + (path + 2);
+    struct stat st;
+    if(stat(hostPath.c_str(), &st) || !S_ISREG(st.st_mode)) return FR_NO_FILE;
+    Sim::sd.opens++;
+
+    Chain* chain = NULL;
+    for(uint8_t i=0; i<nChains; i++) {
+        if(chains[i].path == hostPath) chain = &chains[i];
+    }
+    if(!chain) {
+        if(nChains == sizeof(chains) / sizeof(Chain)) return FR_DENIED;
+        uint32_t next = 2;
+        for(uint8_t i=0; i<nChains; i++) {
+            next = std::max(next, clusterOf(chains[i], chains[i].clusters - 1) + 2);
+        }
+        chain = &chains[nChains++];
+        chain->path = hostPath;
+        chain->first = next;
+        chain->clusters = st.st_size ? (st.st_size + CLUSTER - 1) / CLUSTER : 1;
+        chain->gap = Sim::config.mapLayout == "fragmented" ? chain->clusters / 2 : 0;
+    }
+    fp->obj.fs = &volume;
+    fp->obj.sclust = chain->first;
+    fp->obj.objsize = st.st_size;
+    return FR_OK;
+}
+
+FRESULT f_close(FIL* fp) {
+    return FR_OK;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE* buff, LBA_t sector, UINT count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(pdrv != 0) return RES_NOTRDY;
+    Sim::sd.reads++;
+    for(UINT i=0; i<count; i++, sector++, buff += SECTOR) {
+        if(sector >= volume.database) {
+            uint32_t cluster = (sector - volume.database) / CLUSTER_SECTORS + 2;
+            if(!readData(cluster, (sector - volume.database) % CLUSTER_SECTORS, buff)) return RES_ERROR;
+        } else if(sector >= volume.fatbase) {
+            uint32_t firstEntry = (sector - volume.fatbase) * (SECTOR / 4);
+            for(uint32_t j=0; j<SECTOR / 4; j++) {
+                uint32_t entry = fatEntry(firstEntry + j);
+                memcpy(buff + 4*j, &entry, 4);
+            }
+            Sim::sd.bytesRead += SECTOR;
+        } else {
+            memset(buff, 0, SECTOR);
+        }
+    }
+    return RES_OK;
+}
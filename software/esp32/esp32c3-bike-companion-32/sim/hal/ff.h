@@ -0,0 +1,65 @@
+#ifndef _SIM_FF_H
+#define _SIM_FF_H
+
+#include <stdint.h>
+
+/*
+
+    FatFs of the simulator. Only what the firmware uses to find the sectors of the map file. The volume
+    is a FAT32 file system with 4 kB clusters that is generated from the SD-card directory (see fatfs.cpp).
+
+*/
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+typedef char TCHAR;
+typedef uint64_t FSIZE_t;
+typedef uint32_t LBA_t;
+
+#define FF_VOLUMES 2
+#define FF_MIN_SS 512
+#define FF_MAX_SS 4096
+
+#define FS_FAT12 1
+#define FS_FAT16 2
+#define FS_FAT32 3
+#define FS_EXFAT 4
+
+#define FA_READ 0x01
+
+typedef enum {
+    FR_OK = 0,
+    FR_DISK_ERR,
+    FR_INT_ERR,
+    FR_NOT_READY,
+    FR_NO_FILE,
+    FR_NO_PATH,
+    FR_INVALID_NAME,
+    FR_DENIED
+} FRESULT;
+
+typedef struct {
+    BYTE fs_type;
+    BYTE pdrv;
+    WORD csize;         // sectors per cluster
+    WORD ssize;         // bytes per sector
+    DWORD n_fatent;
+    LBA_t fatbase;
+    LBA_t database;
+} FATFS;
+
+typedef struct {
+    FATFS* fs;
+    DWORD sclust;       // first cluster
+    FSIZE_t objsize;
+} FFOBJID;
+
+typedef struct {
+    FFOBJID obj;
+} FIL;
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode);
+FRESULT f_close(FIL* fp);
+
+#endif
@@ -0,0 +1,57 @@
+#include <esp_partition.h>
+#include <simulator.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+/*
+
+    Map partition of the simulator. Without Sim::config.flashMap, the partition table has no map
+    partition. Otherwise the partition has the size in partitions_flashmap.csv, holds the file at its
+    start and is erased (0xFF) after it, like after flashing the map with esptool.py.
+
+*/
+namespace {
+
+    const uint32_t MAP_PARTITION_ADDRESS = 0x200000;
+    const uint32_t MAP_PARTITION_SIZE = 0x1F0000;
+
+    esp_partition_t partition = {ESP_PARTITION_TYPE_DATA, 0x40, MAP_PARTITION_ADDRESS, MAP_PARTITION_SIZE, "map"};
+    std::vector<uint8_t> flash;
+
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label) {
+    if(Sim::config.flashMap.empty() || type != partition.type) return NULL;
+    if(subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != partition.subtype) return NULL;
+    if(label && strcmp(label, partition.label)) return NULL;
+    return &partition;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             spi_flash_mmap_memory_t memory, const void** out_ptr, spi_flash_mmap_handle_t* out_handle) {
+    if(offset + size > partition->size) return ESP_FAIL;
+    if(flash.empty()) {
+        FILE* f = fopen(Sim::config.flashMap.c_str(), "rb");
+        if(!f) {
+            printf("Failed to open %s\n", Sim::config.flashMap.c_str());
+            return ESP_FAIL;
+        }
+        flash.assign(partition->size, 0xFF);
+        size_t n = fread(flash.data(), 1, flash.size(), f);
+        // The file does not fit into the partition
+        bool truncated = n == flash.size() && fgetc(f) != EOF;
+        fclose(f);
+        if(truncated) {
+            printf("%s is larger than the map partition (%u bytes)\n", Sim::config.flashMap.c_str(), partition->size);
+            flash.clear();
+            return ESP_FAIL;
+        }
+    }
+    *out_ptr = flash.data() + offset;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(spi_flash_mmap_handle_t handle) {}
@@ -0,0 +1,72 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct SimTask {
+    std::thread thread;
+};
+
+struct SimSemaphore {
+    // Binary semaphore
+    std::mutex mutex;
+    std::condition_variable available;
+    bool given;
+    // Recursive mutex
+    std::recursive_timed_mutex recursive;
+};
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameters,
+    UBaseType_t priority, TaskHandle_t* createdTask) {
+    SimTask* task = new SimTask;
+    task->thread = std::thread(function, parameters);
+    // Tasks run until the simulator exits
+    task->thread.detach();
+    if(createdTask) *createdTask = task;
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    SimSemaphore* semaphore = new SimSemaphore;
+    semaphore->given = false;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return xSemaphoreCreateBinary();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    if(ticks == portMAX_DELAY) {
+        semaphore->available.wait(lock, [semaphore] { return semaphore->given; });
+    } else if(!semaphore->available.wait_for(lock, std::chrono::milliseconds(ticks), [semaphore] { return semaphore->given; })) {
+        return pdFALSE;
+    }
+    semaphore->given = false;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    semaphore->given = true;
+    semaphore->available.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks) {
+    if(ticks == portMAX_DELAY) {
+        mutex->recursive.lock();
+        return pdTRUE;
+    }
+    return mutex->recursive.try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) {
+    mutex->recursive.unlock();
+    return pdTRUE;
+}
@@ -0,0 +1,26 @@
+#ifndef _SIM_FREERTOS_H
+#define _SIM_FREERTOS_H
+
+#include <stdint.h>
+
+/*
+
+    FreeRTOS of the simulator. Tasks are host threads, semaphores are built on the standard library.
+    Ticks are milliseconds of wall clock time.
+
+*/
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+#define tskIDLE_PRIORITY 0
+
+#endif
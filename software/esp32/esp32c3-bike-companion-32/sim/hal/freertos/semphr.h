@@ -0,0 +1,16 @@
+#ifndef _SIM_FREERTOS_SEMPHR_H
+#define _SIM_FREERTOS_SEMPHR_H
+
+#include <freertos/FreeRTOS.h>
+
+struct SimSemaphore;
+typedef SimSemaphore* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _SIM_FREERTOS_TASK_H
+#define _SIM_FREERTOS_TASK_H
+
+#include <freertos/FreeRTOS.h>
+
+struct SimTask;
+typedef SimTask* TaskHandle_t;
+
+// Starts a detached thread. Stack size and priority are ignored.
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameters,
+    UBaseType_t priority, TaskHandle_t* createdTask);
+
+#endif
@@ -0,0 +1,125 @@
+#include <FS.h>
+#include <SD.h>
+#include <SPI.h>
+#include <simulator.h>
+
+#include <sys/stat.h>
+
+fs::SDFS SD;
+SPIClass SPI;
+
+namespace {
+
+    std::string hostPath(const char* path) {
+        std::string root = Sim::config.sdRoot;
+        if(!root.empty() && root[root.size() - 1] == '/') root.erase(root.size() - 1);
+        return root + (path[0] == '/' ? "" : "/") + path;
+    }
+
+}
+
+fs::File::File(FILE* f) : _file(f, fclose) {
+    Sim::sd.opens++;
+}
+
+size_t fs::File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t fs::File::write(const uint8_t* buffer, size_t size) {
+    if(!_file) return 0;
+    return fwrite(buffer, 1, size, _file.get());
+}
+
+int fs::File::available() {
+    if(!_file) return 0;
+    return size() - position();
+}
+
+int fs::File::read() {
+    if(!_file) return -1;
+    Sim::sd.reads++;
+    int c = fgetc(_file.get());
+    if(c != EOF) Sim::sd.bytesRead++;
+    return c;
+}
+
+int fs::File::peek() {
+    if(!_file) return -1;
+    int c = fgetc(_file.get());
+    if(c != EOF) ungetc(c, _file.get());
+    return c;
+}
+
+size_t fs::File::read(uint8_t* buffer, size_t size) {
+    if(!_file) return 0;
+    Sim::sd.reads++;
+    size_t n = fread(buffer, 1, size, _file.get());
+    Sim::sd.bytesRead += n;
+    return n;
+}
+
+size_t fs::File::readBytes(char* buffer, size_t length) {
+    return read((uint8_t*) buffer, length);
+}
+
+String fs::File::readStringUntil(char terminator) {
+    String s;
+    if(!_file) return s;
+    Sim::sd.reads++;
+    int c;
+    while((c = fgetc(_file.get())) != EOF) {
+        Sim::sd.bytesRead++;
+        if(c == terminator) break;
+        s += (char) c;
+    }
+    return s;
+}
+
+bool fs::File::seek(uint32_t pos) {
+    if(!_file) return false;
+    if(pos != position()) Sim::sd.seeks++;
+    return !fseek(_file.get(), pos, SEEK_SET);
+}
+
+size_t fs::File::position() const {
+    if(!_file) return 0;
+    return ftell(_file.get());
+}
+
+size_t fs::File::size() const {
+    if(!_file) return 0;
+    struct stat st;
+    fflush(_file.get());
+    return fstat(fileno(_file.get()), &st) ? 0 : st.st_size;
+}
+
+void fs::File::flush() {
+    if(_file) fflush(_file.get());
+}
+
+void fs::File::close() {
+    _file.reset();
+}
+
+fs::File fs::FS::open(const char* path, const char* mode, const bool create) {
+    const char* hostMode = "rb";
+    if(!strcmp(mode, FILE_WRITE)) hostMode = "wb";
+    else if(!strcmp(mode, FILE_APPEND)) hostMode = "ab";
+    FILE* f = fopen(hostPath(path).c_str(), hostMode);
+    return f ? File(f) : File();
+}
+
+bool fs::FS::exists(const char* path) {
+    struct stat st;
+    return !stat(hostPath(path).c_str(), &st);
+}
+
+bool fs::FS::remove(const char* path) {
+    return !::remove(hostPath(path).c_str());
+}
+
+bool fs::SDFS::begin(uint8_t ssPin, SPIClass& spi, uint32_t frequency, const char* mountpoint, uint8_t max_files, bool format_if_empty) {
+    struct stat st;
+    return !stat(Sim::config.sdRoot.c_str(), &st) && S_ISDIR(st.st_mode);
+}
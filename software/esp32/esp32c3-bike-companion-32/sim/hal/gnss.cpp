@@ -0,0 +1,264 @@
+#include <Arduino.h>
+#include <MicroNMEA.h>
+#include <simulator.h>
+
+#include <vector>
+
+/*
+
+    Scripted ride of the GNSS module. The ride is a list of fixes, each a block of NMEA sentences.
+    Fix i is received by the UART at i / gnssRateHz seconds after the firmware opened it.
+
+        GPX track   the rider follows the track points at Sim::config.speedKph, RMC and GGA sentences
+                    are generated for every fix
+        NMEA log    recorded sentences are replayed, every RMC sentence starts a new fix
+
+*/
+namespace {
+
+    std::vector<std::string> fixes;
+    uint64_t period = 1000000;
+    uint64_t start = 0;
+    bool started = false;
+    size_t nReleased = 0;
+    std::string received;
+    size_t receivedPos = 0;
+
+    uint8_t checksum(const char* sentence) {
+        uint8_t cs = 0;
+        // Everything between $ and *
+        for(const char* c = sentence + 1; *c && *c != '*'; c++) cs ^= *c;
+        return cs;
+    }
+
+    std::string withChecksum(const std::string& sentence) {
+        char tail[8];
+        snprintf(tail, sizeof(tail), "*%02X\r\n", checksum(sentence.c_str()));
+        return sentence + tail;
+    }
+
+    // Degrees to NMEA ddmm.mmmm with hemisphere
+    std::string nmeaAngle(double degrees, int degreeDigits, char positive, char negative) {
+        char s[32];
+        double a = fabs(degrees);
+        int d = (int) a;
+        snprintf(s, sizeof(s), "%0*d%07.4f,%c", degreeDigits, d, (a - d)*60.0, degrees < 0 ? negative : positive);
+        return s;
+    }
+
+    std::string generateFix(double seconds, double lat, double lon, double speedKph, double course) {
+        char time[16], buffer[128];
+        uint32_t s = 12*3600 + (uint32_t) seconds;
+        snprintf(time, sizeof(time), "%02u%02u%02u.%03u", (s / 3600) % 24, (s / 60) % 60, s % 60,
+            (uint32_t) ((seconds - floor(seconds))*1000));
+        std::string position = nmeaAngle(lat, 2, 'N', 'S') + "," + nmeaAngle(lon, 3, 'E', 'W');
+        snprintf(buffer, sizeof(buffer), "$GPRMC,%s,A,%s,%.2f,%.2f,010624,,,A", time, position.c_str(), speedKph / 1.852, course);
+        std::string fix = withChecksum(buffer);
+        snprintf(buffer, sizeof(buffer), "$GPGGA,%s,%s,1,09,0.9,500.0,M,47.0,M,,", time, position.c_str());
+        return fix + withChecksum(buffer);
+    }
+
+    bool loadGPX(const std::string& data) {
+        std::vector<double> lats, lons;
+        size_t pos = 0;
+        while((pos = data.find("<trkpt", pos)) != std::string::npos) {
+            size_t end = data.find('>', pos);
+            std::string tag = data.substr(pos, end - pos);
+            size_t lat = tag.find("lat=\""), lon = tag.find("lon=\"");
+            if(lat != std::string::npos && lon != std::string::npos) {
+                lats.push_back(atof(tag.c_str() + lat + 5));
+                lons.push_back(atof(tag.c_str() + lon + 5));
+            }
+            pos = end;
+        }
+        if(lats.size() < 2) return false;
+
+        // Walk along the track with constant speed
+        const double R = 6378137.0;
+        double speed = Sim::config.speedKph / 3.6;
+        double step = speed * period * 1e-6;
+        double course = 0, walked = 0;
+        size_t segment = 0;
+        double segmentStart = 0;
+        for(uint64_t i=0; ; i++) {
+            double target = i*step;
+            double dx = 0, dy = 0, length = 0;
+            while(segment + 1 < lats.size()) {
+                dx = (lons[segment + 1] - lons[segment]) * DEG_TO_RAD * R * cos(lats[segment] * DEG_TO_RAD);
+                dy = (lats[segment + 1] - lats[segment]) * DEG_TO_RAD * R;
+                length = sqrt(dx*dx + dy*dy);
+                if(segmentStart + length >= target) break;
+                segmentStart += length;
+                segment++;
+            }
+            if(segment + 1 >= lats.size()) {
+                fixes.push_back(generateFix(i*period*1e-6, lats.back(), lons.back(), 0, course));
+                break;
+            }
+            if(length > 0) course = fmod(atan2(dx, dy) * RAD_TO_DEG + 360.0, 360.0);
+            double f = length > 0 ? (target - segmentStart) / length : 0;
+            walked = target;
+            fixes.push_back(generateFix(i*period*1e-6,
+                lats[segment] + f*(lats[segment + 1] - lats[segment]),
+                lons[segment] + f*(lons[segment + 1] - lons[segment]),
+                Sim::config.speedKph, course));
+        }
+        printf("[SIM] GPX ride with %u points, %.1f km in %u fixes\n", (unsigned) lats.size(), walked / 1000.0, (unsigned) fixes.size());
+        return true;
+    }
+
+    bool loadNMEA(const std::string& data) {
+        size_t pos = 0;
+        while(pos < data.size()) {
+            size_t end = data.find('\n', pos);
+            if(end == std::string::npos) end = data.size();
+            std::string line = data.substr(pos, end - pos);
+            pos = end + 1;
+            while(!line.empty() && (line[line.size() - 1] == '\r' || line[line.size() - 1] == ' ')) line.erase(line.size() - 1);
+            if(line.size() < 6 || line[0] != '$') continue;
+            if(fixes.empty() || line.compare(3, 3, "RMC") == 0) fixes.push_back(std::string());
+            fixes.back() += line + "\r\n";
+        }
+        printf("[SIM] NMEA ride with %u fixes\n", (unsigned) fixes.size());
+        return !fixes.empty();
+    }
+
+    void release() {
+        if(!started) return;
+        uint64_t now = Sim::now();
+        while(nReleased < fixes.size() && start + nReleased*period <= now) {
+            if(receivedPos) {
+                received.erase(0, receivedPos);
+                receivedPos = 0;
+            }
+            received += fixes[nReleased++];
+        }
+    }
+
+}
+
+bool Sim::loadRide() {
+    fixes.clear();
+    period = 1000000 / std::max<uint32_t>(Sim::config.gnssRateHz, 1);
+    FILE* f = fopen(Sim::config.ride.c_str(), "rb");
+    if(!f) {
+        printf("[SIM] Could not open ride %s\n", Sim::config.ride.c_str());
+        return false;
+    }
+    std::string data;
+    char buffer[4096];
+    size_t n;
+    while((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data.append(buffer, n);
+    fclose(f);
+
+    if(data.find("<trkpt") != std::string::npos) return loadGPX(data);
+    return loadNMEA(data);
+}
+
+bool Sim::rideFinished() {
+    release();
+    return started && nReleased == fixes.size() && receivedPos == received.size();
+}
+
+uint64_t Sim::rideEnd() {
+    return start + fixes.size()*period;
+}
+
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) {
+    if(started) return;
+    start = Sim::now();
+    started = true;
+}
+
+// Configuration sentences of the firmware are ignored
+size_t HardwareSerial::write(uint8_t c) {
+    return 1;
+}
+
+int HardwareSerial::available() {
+    release();
+    return received.size() - receivedPos;
+}
+
+int HardwareSerial::read() {
+    return available() ? (uint8_t) received[receivedPos++] : -1;
+}
+
+int HardwareSerial::peek() {
+    return available() ? (uint8_t) received[receivedPos] : -1;
+}
+
+
+MicroNMEA::MicroNMEA(void* buffer, uint8_t len) :
+    _valid(false), _latitude(0), _longitude(0), _speed(0), _course(0),
+    _numSat(0), _hour(0), _minute(0), _second(0), _day(0), _month(0), _year(0) {};
+
+bool MicroNMEA::process(char c) {
+    if(c == '$') {
+        _sentence = "$";
+        return false;
+    }
+    if(_sentence.empty()) return false;
+    if(c == '\r' || c == '\n') {
+        bool processed = processSentence();
+        _sentence.clear();
+        return processed;
+    }
+    _sentence += c;
+    return false;
+}
+
+bool MicroNMEA::processSentence() {
+    std::string s = _sentence.substr(0, _sentence.find('*'));
+    std::vector<std::string> fields;
+    size_t pos = 0, end;
+    while((end = s.find(',', pos)) != std::string::npos) {
+        fields.push_back(s.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    fields.push_back(s.substr(pos));
+    if(fields[0].size() != 6) return false;
+
+    // Degrees and minutes to millionths of a degree
+    struct Angle {
+        static long parse(const std::string& value, const std::string& hemisphere) {
+            double v = atof(value.c_str());
+            double degrees = floor(v / 100.0);
+            long a = lround((degrees + (v - degrees*100.0) / 60.0) * 1e6);
+            return (hemisphere == "S" || hemisphere == "W") ? -a : a;
+        }
+    };
+
+    std::string type = fields[0].substr(3);
+    if(type == "RMC" && fields.size() >= 10) {
+        _valid = fields[2] == "A";
+        if(fields[1].size() >= 6) {
+            _hour = atoi(fields[1].substr(0, 2).c_str());
+            _minute = atoi(fields[1].substr(2, 2).c_str());
+            _second = atoi(fields[1].substr(4, 2).c_str());
+        }
+        if(_valid) {
+            _latitude = Angle::parse(fields[3], fields[4]);
+            _longitude = Angle::parse(fields[5], fields[6]);
+            _speed = lround(atof(fields[7].c_str()) * 1000.0);
+            _course = lround(atof(fields[8].c_str()) * 1000.0);
+        }
+        if(fields[9].size() == 6) {
+            _day = atoi(fields[9].substr(0, 2).c_str());
+            _month = atoi(fields[9].substr(2, 2).c_str());
+            _year = 2000 + atoi(fields[9].substr(4, 2).c_str());
+        }
+        return true;
+    }
+    if(type == "GGA" && fields.size() >= 8) {
+        _numSat = atoi(fields[7].c_str());
+        return true;
+    }
+    return false;
+}
+
+Stream& MicroNMEA::sendSentence(Stream& s, const char* sentence) {
+    s.print(withChecksum(sentence).c_str());
+    return s;
+}
@@ -0,0 +1,66 @@
+#ifndef _SIMULATOR_H
+#define _SIMULATOR_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+/*
+
+    Interface between the stub HAL and the simulator runtime (simmain.cpp).
+
+    Clock:  virtual time in microseconds. It advances with the wall clock while the firmware works
+            and by the requested time on delay(), delayMicroseconds() and sleep(), which return
+            immediately. The time the firmware spends on a frame is therefore measured on the host,
+            while everything that waits for the clock (frame pacing, GNSS updates, tile prediction)
+            behaves as on the device.
+    SD:     every file operation of the SD stub and every sector read of the FatFs volume (fatfs.cpp) is
+            counted. Tasks of the firmware are threads (see freertos.cpp), so the counters are atomic.
+    LCD:    every byte the display driver sends and every line it writes to the panel is counted.
+    Flash:  the map partition is memory-mapped, reads are not counted.
+    Frames: every refresh of the display hands the framebuffer to the runtime.
+
+*/
+namespace Sim {
+
+    struct Config {
+        std::string sdRoot;         // directory that is mounted as the SD-card
+        std::string ride;           // GPX track or NMEA log that the GNSS module replays
+        double speedKph;            // speed along a GPX ride
+        uint32_t gnssRateHz;        // fixes per second of a GPX ride, NMEA logs use one fix per RMC sentence
+        uint32_t freeHeap;          // value of ESP.getFreeHeap()
+        std::string mapLayout;      // FatFs volume of the SD-card: "contiguous", "fragmented" or "vfs" (none)
+        std::string flashMap;       // map file in the flash partition, empty for no map partition
+    };
+
+    struct SDCounters {
+        std::atomic<uint64_t> bytesRead;    // bytes returned by read calls, including peeked bytes once read
+        std::atomic<uint64_t> reads;        // number of read calls
+        std::atomic<uint64_t> seeks;        // number of seeks that changed the position
+        std::atomic<uint64_t> opens;        // number of opened files
+    };
+
+    struct DisplayCounters {
+        std::atomic<uint64_t> bytes;        // bytes sent to the LCD, including commands and trailers
+        std::atomic<uint64_t> lines;        // lines written to the panel
+    };
+
+    extern Config config;
+    extern SDCounters sd;
+    extern DisplayCounters lcd;
+
+    // Virtual time
+    uint64_t now();
+    void advance(uint64_t microseconds);
+
+    // GNSS ride. Loaded before setup(), the first fix is received when the firmware opens the UART.
+    bool loadRide();
+    bool rideFinished();
+    uint64_t rideEnd();
+
+    // Called on every refresh of the display with the memory of the panel (bit set = white, LSB first)
+    void onRefresh(const uint8_t* buffer, uint16_t width, uint16_t height);
+
+}
+
+#endif
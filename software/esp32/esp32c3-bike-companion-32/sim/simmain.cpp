@@ -0,0 +1,390 @@
+#include <Arduino.h>
+#include <simulator.h>
+#include <sharpmemdisplay.h>
+#include <globalconfig.h>
+#include <geoposition.h>
+#include <simpletileformat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+/*
+
+    Linux build of the firmware. Runs setup() and loop() of src/main.cpp against the stub HAL in sim/hal:
+    the SD-card is a directory, the display a framebuffer and the GNSS module replays a ride. The simulation
+    ends when the ride is over, the time of every frame and the SD-card traffic is reported.
+
+    With --bench-lines, the simulator instead draws random thick and dashed lines with the span rasterizer of
+    the display driver and pixel by pixel as the firmware did before, and compares time and result.
+
+    With --test-long-track, the simulator writes an empty map and a straight track of two points that are
+    several tile blocks apart into a directory and rides along the middle of the track. Neither point of
+    the segment is on a tile in view, the track has to be drawn in every frame anyway.
+
+*/
+void setup();
+void loop();
+
+Sim::Config Sim::config = {"", "", 20.0, 1, 250000, "contiguous", ""};
+Sim::SDCounters Sim::sd;
+Sim::DisplayCounters Sim::lcd;
+
+namespace {
+
+    struct Frame {
+        uint64_t time;              // virtual time of the refresh in us
+        uint64_t renderTime;        // wall clock time since the previous refresh in us
+        uint64_t bytesRead, reads, seeks;
+        uint64_t lcdBytes, lcdLines;
+    };
+
+    std::vector<Frame> frames;
+    // Frames rendered during setup
+    size_t nSetupFrames = 0;
+    bool setupDone = false;
+
+    double maxSeconds = 7200;
+    std::string pbmDir, csvPath;
+    uint32_t pbmEvery = 60;
+
+    // Check of --test-long-track: ride frames and ride frames with the track on the map
+    bool testTrack = false;
+    uint32_t trackFrames = 0, trackFramesDrawn = 0;
+
+    std::chrono::steady_clock::time_point lastRefresh = std::chrono::steady_clock::now();
+    // SD counters at the previous refresh
+    uint64_t lastBytesRead = 0, lastReads = 0, lastSeeks = 0;
+    // LCD counters at the previous refresh
+    uint64_t lastLcdBytes = 0, lastLcdLines = 0;
+
+    void writePBM(const uint8_t* buffer, uint16_t width, uint16_t height, size_t frame) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/frame_%06u.pbm", pbmDir.c_str(), (unsigned) frame);
+        FILE* f = fopen(path, "wb");
+        if(!f) return;
+        fprintf(f, "P4\n%u %u\n", width, height);
+        // Rows are padded to full bytes, bits are MSB first and a set bit is black
+        std::vector<uint8_t> row((width + 7) / 8);
+        for(uint16_t y=0; y<height; y++) {
+            std::fill(row.begin(), row.end(), 0);
+            for(uint16_t x=0; x<width; x++) {
+                uint32_t bit = y*width + x;
+                if(!((buffer[bit / 8] >> (bit & 7)) & 1)) row[x / 8] |= 0x80 >> (x & 7);
+            }
+            fwrite(row.data(), 1, row.size(), f);
+        }
+        fclose(f);
+    }
+
+    // Thick line pixel by pixel through drawPixel(), the rasterizer the span rasterizer replaced
+    const int thicknessOffsets[6] = {1, -1, 2, -2, 3, -3};
+
+    void drawLinePixels(SharpMemDisplay& disp, int x0, int y0, int x1, int y1, uint8_t thickness, uint16_t color,
+                        uint8_t dashLength) {
+        int dx =  abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        int err = dx + dy, e2;
+        uint8_t cnt = 0;
+        bool yMajor = dx < -dy;
+        while(true) {
+            if(dashLength) {
+                ++cnt %= dashLength;
+                if(!cnt) color = !color;
+            }
+            disp.drawPixel(x0, y0, color);
+            for(int i=0; i<thickness-1; i++) {
+                if(yMajor) disp.drawPixel(x0+thicknessOffsets[i], y0, color);
+                else disp.drawPixel(x0, y0+thicknessOffsets[i], color);
+            }
+            if(x0 == x1 && y0 == y1) break;
+            e2 = 2 * err;
+            if(e2 > dy) { err += dy; x0 += sx; }
+            if(e2 < dx) { err += dx; y0 += sy; }
+        }
+    }
+
+    int benchLines(uint32_t n) {
+        SharpMemDisplay spans(&SPI, DISPLAY_CS, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+        SharpMemDisplay pixels(&SPI, DISPLAY_CS, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+        spans.begin();
+        pixels.begin();
+        // Map ways (2), track (6) and route (3) with points up to a few pixels off the map, every 8th line dashed
+        struct Line { int x0, y0, x1, y1; uint8_t thickness, dashLength; uint16_t color; };
+        std::vector<Line> lines(n);
+        srand(1);
+        const uint8_t thicknesses[4] = {2, 2, 6, 3};
+        for(uint32_t i=0; i<n; i++) {
+            lines[i].x0 = rand() % (DISPLAY_WIDTH + 6) - 3;
+            lines[i].y0 = rand() % (DISPLAY_WIDTH + 6) - 3;
+            lines[i].x1 = rand() % (DISPLAY_WIDTH + 6) - 3;
+            lines[i].y1 = rand() % (DISPLAY_WIDTH + 6) - 3;
+            lines[i].thickness = thicknesses[i % 4];
+            lines[i].dashLength = i % 8 == 7 ? 5 : 0;
+            lines[i].color = i % 16 == 15 ? WHITE : BLACK;
+        }
+
+        uint64_t timeSpans = 0, timePixels = 0;
+        uint32_t different = 0;
+        const uint32_t frame = 100;
+        for(uint32_t i=0; i<n; i+=frame) {
+            spans.clearDisplayBuffer();
+            pixels.clearDisplayBuffer();
+            uint32_t end = std::min(n, i + frame);
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            for(uint32_t k=i; k<end; k++) {
+                spans.drawThickLine(lines[k].x0, lines[k].y0, lines[k].x1, lines[k].y1, lines[k].thickness,
+                                    lines[k].color, lines[k].dashLength);
+            }
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            for(uint32_t k=i; k<end; k++) {
+                drawLinePixels(pixels, lines[k].x0, lines[k].y0, lines[k].x1, lines[k].y1, lines[k].thickness,
+                               lines[k].color, lines[k].dashLength);
+            }
+            std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+            timeSpans += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            timePixels += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+            if(memcmp(spans.getBuffer(), pixels.getBuffer(), DISPLAY_WIDTH/8 * DISPLAY_HEIGHT)) different++;
+        }
+        printf("Lines: \t\t\t\t%u in frames of %u\n", (unsigned) n, (unsigned) frame);
+        printf("Pixel by pixel: \t\t%.1f ns per line\n", (double) timePixels / n);
+        printf("Spans: \t\t\t\t%.1f ns per line, %.1fx faster\n", (double) timeSpans / n,
+            timeSpans ? (double) timePixels / timeSpans : 0.0);
+        printf("Frames with different pixels: \t%u\n", (unsigned) different);
+        return different ? 1 : 0;
+    }
+
+    void writeTrackGPX(const std::string& path, int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+        FILE* f = fopen(path.c_str(), "w");
+        if(!f) return;
+        GeoPosition p0(x0, y0), p1(x1, y1);
+        // The firmware only reads indented trkpt lines
+        fprintf(f, "<gpx>\n <trk>\n  <trkseg>\n");
+        fprintf(f, "   <trkpt lat=\"%.7f\" lon=\"%.7f\"></trkpt>\n", p0.lat(), p0.lon());
+        fprintf(f, "   <trkpt lat=\"%.7f\" lon=\"%.7f\"></trkpt>\n", p1.lat(), p1.lon());
+        fprintf(f, "  </trkseg>\n </trk>\n</gpx>\n");
+        fclose(f);
+    }
+
+    /*
+        Map without ways and a track from the west to the east end of it. The ride covers the middle fifth of
+        the track, which is more than a block of 3 x 3 tiles away from both points.
+    */
+    bool writeLongTrackTest(const std::string& dir) {
+        mkdir(dir.c_str(), 0755);
+        const uint64_t tileSize = 1000, nXTiles = 20, nYTiles = 3;
+        GeoPosition origin(48.1, 11.5);
+
+        SimpleTileFormat::MapHeader header;
+        memset(&header, 0, sizeof(header));
+        header.map_x = origin.x();
+        header.map_y = origin.y();
+        header.map_width = nXTiles*tileSize;
+        header.map_height = nYTiles*tileSize;
+        header.n_x_tiles = nXTiles;
+        header.tile_size = tileSize;
+        header.n_tiles = nXTiles*nYTiles;
+        FILE* f = fopen((dir + "/map.bin").c_str(), "wb");
+        if(!f) {
+            printf("Failed to write %s/map.bin\n", dir.c_str());
+            return false;
+        }
+        fwrite(&header, sizeof(header), 1, f);
+        // Every tile is empty
+        std::vector<uint64_t> pointers(header.n_tiles, 0);
+        fwrite(pointers.data(), sizeof(uint64_t), pointers.size(), f);
+        fclose(f);
+
+        int64_t y = header.map_y + header.map_height/2 + tileSize/3;
+        int64_t xStart = header.map_x + tileSize/2, xEnd = header.map_x + header.map_width - tileSize/2;
+        writeTrackGPX(dir + "/track.gpx", xStart, y, xEnd, y);
+        writeTrackGPX(dir + "/ride.gpx", xStart + 2*(xEnd - xStart)/5, y, xStart + 3*(xEnd - xStart)/5, y);
+        return true;
+    }
+
+    // Black pixels on the map, apart from the position marker and the border of the status bar
+    bool mapHasTrack(const uint8_t* buffer, uint16_t width) {
+        const int marker = 2*POSITION_MARKER_SIZE + 1;
+        for(int y=0; y<DISPLAY_WIDTH - 3; y++) {
+            for(int x=0; x<DISPLAY_WIDTH; x++) {
+                if(abs(x - DISPLAY_WIDTH_HALF) <= marker && abs(y - DISPLAY_WIDTH_HALF) <= marker) continue;
+                uint32_t bit = y*width + x;
+                if(!((buffer[bit / 8] >> (bit & 7)) & 1)) return true;
+            }
+        }
+        return false;
+    }
+
+    uint64_t percentile(std::vector<uint64_t>& sorted, double p) {
+        if(sorted.empty()) return 0;
+        return sorted[std::min<size_t>(sorted.size() - 1, (size_t) (p * sorted.size()))];
+    }
+
+    void finish() {
+        fflush(stdout);
+        printf("\n-------------------------------- Simulation\n");
+        if(!csvPath.empty()) {
+            FILE* f = fopen(csvPath.c_str(), "w");
+            if(f) {
+                fprintf(f, "frame,time_ms,render_us,bytes_read,reads,seeks,lcd_bytes,lcd_lines,setup\n");
+                for(size_t i=0; i<frames.size(); i++) {
+                    fprintf(f, "%u,%.1f,%llu,%llu,%llu,%llu,%llu,%llu,%d\n", (unsigned) i, frames[i].time / 1000.0,
+                        (unsigned long long) frames[i].renderTime, (unsigned long long) frames[i].bytesRead,
+                        (unsigned long long) frames[i].reads, (unsigned long long) frames[i].seeks,
+                        (unsigned long long) frames[i].lcdBytes, (unsigned long long) frames[i].lcdLines, i < nSetupFrames);
+                }
+                fclose(f);
+            }
+        }
+        if(!setupDone) {
+            printf("Setup did not finish within %.0f s\n", maxSeconds);
+            fflush(stdout);
+            _Exit(1);
+        }
+
+        uint64_t setupBytes = 0;
+        for(size_t i=0; i<nSetupFrames; i++) setupBytes += frames[i].bytesRead;
+
+        std::vector<uint64_t> renderTimes, bytes;
+        uint64_t totalBytes = 0, totalReads = 0, totalSeeks = 0, framesWithReads = 0;
+        uint64_t lcdBytes = 0, lcdLines = 0;
+        for(size_t i=nSetupFrames; i<frames.size(); i++) {
+            lcdBytes += frames[i].lcdBytes;
+            lcdLines += frames[i].lcdLines;
+            renderTimes.push_back(frames[i].renderTime);
+            bytes.push_back(frames[i].bytesRead);
+            totalBytes += frames[i].bytesRead;
+            totalReads += frames[i].reads;
+            totalSeeks += frames[i].seeks;
+            if(frames[i].reads) framesWithReads++;
+        }
+        std::sort(renderTimes.begin(), renderTimes.end());
+        std::sort(bytes.begin(), bytes.end());
+        uint64_t sum = 0;
+        for(uint64_t t : renderTimes) sum += t;
+        size_t n = renderTimes.size();
+
+        printf("Setup: \t\t\t\t%u frames, %llu bytes read\n", (unsigned) nSetupFrames, (unsigned long long) setupBytes);
+        printf("Ride: \t\t\t\t%u frames in %.1f s\n", (unsigned) n,
+            n ? (frames.back().time - frames[nSetupFrames].time) / 1e6 : 0.0);
+        printf("Frame time (host): \t\tmean %.1f us, p50 %llu us, p95 %llu us, p99 %llu us, max %llu us\n",
+            n ? (double) sum / n : 0.0, (unsigned long long) percentile(renderTimes, 0.5),
+            (unsigned long long) percentile(renderTimes, 0.95), (unsigned long long) percentile(renderTimes, 0.99),
+            (unsigned long long) (n ? renderTimes.back() : 0));
+        printf("Bytes read: \t\t\t%llu in %llu reads and %llu seeks, %llu frames with reads\n",
+            (unsigned long long) totalBytes, (unsigned long long) totalReads, (unsigned long long) totalSeeks,
+            (unsigned long long) framesWithReads);
+        printf("Bytes read per frame: \t\tmean %.1f, p99 %llu, max %llu\n", n ? (double) totalBytes / n : 0.0,
+            (unsigned long long) percentile(bytes, 0.99), (unsigned long long) (n ? bytes.back() : 0));
+        printf("LCD per frame: \t\t\tmean %.1f of %u lines, %.1f bytes, %.1f us at %u Hz\n",
+            n ? (double) lcdLines / n : 0.0, (unsigned) DISPLAY_HEIGHT, n ? (double) lcdBytes / n : 0.0,
+            n ? lcdBytes * 8e6 / SPI_FREQ / n : 0.0, (unsigned) SPI_FREQ);
+        if(testTrack) {
+            printf("Track drawn: \t\t\t%u of %u frames\n", (unsigned) trackFramesDrawn, (unsigned) trackFrames);
+            fflush(stdout);
+            _Exit(trackFrames && trackFramesDrawn == trackFrames ? 0 : 1);
+        }
+        // Tasks of the firmware are still running, so the process ends without destructing globals
+        fflush(stdout);
+        _Exit(0);
+    }
+
+}
+
+void Sim::onRefresh(const uint8_t* buffer, uint16_t width, uint16_t height) {
+    std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+    Frame frame;
+    frame.time = Sim::now();
+    frame.renderTime = std::chrono::duration_cast<std::chrono::microseconds>(t - lastRefresh).count();
+    uint64_t bytesRead = sd.bytesRead, reads = sd.reads, seeks = sd.seeks;
+    frame.bytesRead = bytesRead - lastBytesRead;
+    frame.reads = reads - lastReads;
+    frame.seeks = seeks - lastSeeks;
+    uint64_t lcdBytes = lcd.bytes, lcdLines = lcd.lines;
+    frame.lcdBytes = lcdBytes - lastLcdBytes;
+    frame.lcdLines = lcdLines - lastLcdLines;
+    frames.push_back(frame);
+    if(!setupDone) nSetupFrames = frames.size();
+
+    if(testTrack && setupDone) {
+        trackFrames++;
+        if(mapHasTrack(buffer, width)) trackFramesDrawn++;
+    }
+
+    if(!pbmDir.empty() && pbmEvery && (frames.size() - 1) % pbmEvery == 0) {
+        writePBM(buffer, width, height, frames.size() - 1);
+    }
+
+    if(frame.time > maxSeconds*1e6 || (rideFinished() && frame.time > rideEnd() + 1000000)) {
+        finish();
+    }
+
+    lastBytesRead = bytesRead;
+    lastReads = reads;
+    lastSeeks = seeks;
+    lastLcdBytes = lcdBytes;
+    lastLcdLines = lcdLines;
+    // Writing the frame is not part of the next frame
+    lastRefresh = std::chrono::steady_clock::now();
+}
+
+int main(int argc, char *argv[]) {
+
+    if(argc == 3 && std::string(argv[1]) == "--bench-lines") return benchLines(atoi(argv[2]));
+    if(argc == 3 && std::string(argv[1]) == "--test-long-track") {
+        if(!writeLongTrackTest(argv[2])) return 1;
+        testTrack = true;
+        Sim::config.sdRoot = argv[2];
+        Sim::config.ride = Sim::config.sdRoot + "/ride.gpx";
+        if(!Sim::loadRide()) return 1;
+        setup();
+        setupDone = true;
+        while(true) {
+            loop();
+        }
+    }
+
+    if(argc < 2) {
+        printf("Usage: bike-companion-sim --bench-lines N\n"
+               "       bike-companion-sim --test-long-track DIR\n"
+               "       bike-companion-sim SD_ROOT [--ride GPX_OR_NMEA_FILE] [--speed KPH] [--rate HZ] [--heap BYTES]\n"
+               "                          [--seconds MAX_SECONDS] [--pbm DIR] [--pbm-every N] [--csv FILE]\n"
+               "                          [--map-layout contiguous|fragmented|vfs] [--flash-map MAP_FILE]\n");
+        return 1;
+    }
+
+    Sim::config.sdRoot = argv[1];
+    Sim::config.ride = Sim::config.sdRoot + "/track.gpx";
+    for(int i=2; i<argc; i++) {
+        std::string arg = argv[i];
+        if(i + 1 >= argc) {
+            printf("Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if(arg == "--ride") Sim::config.ride = value;
+        else if(arg == "--speed") Sim::config.speedKph = atof(value);
+        else if(arg == "--rate") Sim::config.gnssRateHz = atoi(value);
+        else if(arg == "--heap") Sim::config.freeHeap = atoi(value);
+        else if(arg == "--seconds") maxSeconds = atof(value);
+        else if(arg == "--pbm") pbmDir = value;
+        else if(arg == "--pbm-every") pbmEvery = atoi(value);
+        else if(arg == "--csv") csvPath = value;
+        else if(arg == "--map-layout") Sim::config.mapLayout = value;
+        else if(arg == "--flash-map") Sim::config.flashMap = value;
+        else {
+            printf("Unknown option %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    if(!Sim::loadRide()) return 1;
+
+    setup();
+    setupDone = true;
+    while(true) {
+        loop();
+    }
+}
@@ -1,6 +1,6 @@
 #include <constgeoposition.h>
 
-ConstGeoPosition::ConstGeoPosition(GeoPosition& geoPosition, uint16_t heading) : _constPosition(geoPosition), _heading(heading), GeoPositionProvider() {
+ConstGeoPosition::ConstGeoPosition(GeoPosition& geoPosition, uint16_t heading) : GeoPositionProvider(), _constPosition(geoPosition), _heading(heading) {
     ready = true;
 };
 
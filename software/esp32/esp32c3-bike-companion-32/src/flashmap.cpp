@@ -0,0 +1,65 @@
+#include <flashmap.h>
+#include <serialutils.h>
+#include <globalconfig.h>
+
+#include <algorithm>
+
+FlashMap::FlashMap() : _data(NULL), _header(NULL) {}
+
+bool FlashMap::initialize(SimpleTile::Header& header) {
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                                FLASH_MAP_PARTITION);
+    if(!partition) return false;
+
+    const void* data;
+    if(esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &data, &_handle) != ESP_OK) {
+        sout.warn() <= "Failed to map the map partition";
+        return false;
+    }
+    _data = (const uint8_t*) data;
+
+    // An erased partition holds no map
+    bool erased = *(const uint64_t*) _data == UINT64_MAX;
+    uint8_t version = erased ? 0 : SimpleTileFormat::parseHeader(_data, partition->size, header, header.flags, header.n_entries);
+    if(version != 2) {
+        if(!erased) sout.err() <= "Map in flash must be of version 2";
+        esp_partition_munmap(_handle);
+        _data = NULL;
+        return false;
+    }
+    header.setLayout(version);
+
+    // Every tile must lie within the partition
+    bool complete = header.data_offset <= partition->size;
+    const uint64_t* entries = (const uint64_t*) (_data + header.entries_offset);
+    for(uint64_t i=0; i<header.n_entries && complete; i++) {
+        complete = header.data_offset + SimpleTile::entryOffset(entries[i]) + SimpleTile::entrySize(entries[i]) <= partition->size;
+    }
+    if(!complete) {
+        sout.err() <= "Map in flash exceeds the partition";
+        esp_partition_munmap(_handle);
+        _data = NULL;
+        return false;
+    }
+
+    _header = &header;
+    sout.info() << "Map in flash partition with " << header.n_entries <= " tiles";
+    return true;
+}
+
+uint64_t FlashMap::tileEntry(uint64_t tileId) {
+    if(tileId >= _header->n_tiles) return 0;
+    const uint64_t* entries = (const uint64_t*) (_data + _header->entries_offset);
+    if(!(_header->flags & SimpleTile::FLAG_SPARSE)) {
+        return tileId < _header->n_entries ? entries[tileId] : 0;
+    }
+    // Sparse maps only store the tiles in the sorted index
+    const uint32_t* index = (const uint32_t*) (_data + _header->index_offset);
+    const uint32_t* pos = std::lower_bound(index, index + _header->n_entries, (uint32_t) tileId);
+    if(pos == index + _header->n_entries || *pos != tileId) return 0;
+    return entries[pos - index];
+}
+
+const int16_t* FlashMap::tileData() {
+    return (const int16_t*) (_data + _header->data_offset);
+}
@@ -70,7 +70,7 @@ double GeoPosition::lat() { return _lat; };
 double GeoPosition::lon() { return _lon; };
 
 LocalGeoPosition::LocalGeoPosition(GeoPosition& globalPos, SimpleTile::Header* mapHeader)
-    : _header(mapHeader), GeoPosition(globalPos) {
+    : GeoPosition(globalPos), _header(mapHeader) {
 
     // calculate tileID
     _tileId = getTileID(globalPos, mapHeader);
@@ -84,7 +84,7 @@ LocalGeoPosition::LocalGeoPosition(GeoPosition& globalPos, SimpleTile::Header* m
 
 
 LocalGeoPosition::LocalGeoPosition(int64_t xGlobal, int64_t yGlobal, SimpleTile::Header* mapHeader)
-    : _header(mapHeader), GeoPosition(xGlobal, yGlobal) {
+    : GeoPosition(xGlobal, yGlobal), _header(mapHeader) {
 
     // calculate tileID
     _tileId = getTileID(*this, mapHeader);
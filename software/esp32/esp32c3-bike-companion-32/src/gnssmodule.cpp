@@ -3,7 +3,7 @@
 #include <uirenderer.h>
 
 GNSSModule::GNSSModule(uint8_t uartNumber)
-    : gps(uartNumber), nmea(messageBuffer, sizeof(messageBuffer)), GeoPositionProvider() {};
+    : GeoPositionProvider(), nmea(messageBuffer, sizeof(messageBuffer)), gps(uartNumber) {};
 
 void GNSSModule::initialize() {
     gps.begin(115200, SERIAL_8N1, -1, -1);
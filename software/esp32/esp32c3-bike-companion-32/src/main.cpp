@@ -4,12 +4,12 @@
 #include <SPI.h>
 #include <MicroNMEA.h>
 #include <Adafruit_GFX.h>
-#include <Adafruit_SharpMem.h>
 
 #include <gnssmodule.h>
 #include <sharedspisdcard.h>
 #include <sharedspidisplay.h>
 #include <sharedspimutex.h>
+#include <flashmap.h>
 #include <simpletile.h>
 #include <constgeoposition.h>
 #include <tileblockrenderer.h>
@@ -17,6 +17,8 @@
 #include <serialutils.h>
 #include <globalconfig.h>
 #include <interppositionprovider.h>
+#include <rerouter.h>
+#include <turncues.h>
 
 /*
 
@@ -40,8 +42,12 @@ ConstGeoPosition mockPosProvider(currPos, currHeading);
 
 SharedSPIDisplay display(DISPLAY_CS);
 SharedSPISDCard sdcard(SDCARD_CS);
+// Map in the flash partition, used instead of the map on the SD-card if present
+FlashMap flashMap;
 GNSSModule gnss(0);
 GPXTrack track;
+Rerouter rerouter(&sdcard);
+TurnCues turnCues;
 
 InterpPositionProvider ipos(&gnss, ((float) GNSS_MIN_UPDATE_TIME_MS) / ((float) TARGET_FRAME_TIME_MS));
 
@@ -49,6 +55,34 @@ InterpPositionProvider ipos(&gnss, ((float) GNSS_MIN_UPDATE_TIME_MS) / ((float)
 const char binary_path[] = "/map.bin";
 // Path to gpx-track file on SD-card
 const char gpx_path[] = "/track.gpx";
+// Path to binary track compiled by gpx2simpletrack. Preferred over the gpx-track if it matches the map.
+const char track_path[] = "/track.trk";
+// Path to name index created by the converter (--names)
+const char names_path[] = "/names.idx";
+// Path to routing graph created by the converter (--graph)
+const char graph_path[] = "/graph.bin";
+
+// Maximum number of results of a name search
+#define MAX_NAME_RESULTS 8
+NameIndex::Result nameResults[MAX_NAME_RESULTS];
+
+/*
+    Name search over serial. Every line is a prefix, all matching streets and places are printed.
+*/
+void handleNameSearch() {
+  if(!Serial.available()) return;
+  String prefix = Serial.readStringUntil('\n');
+  prefix.trim();
+  if(!prefix.length()) return;
+
+  long t_start = millis();
+  uint16_t n = sdcard.searchNames(header, prefix.c_str(), nameResults, MAX_NAME_RESULTS);
+  sout.info() << n << " results for \"" << prefix << "\" in " << (millis() - t_start) <= "ms";
+  for(uint16_t i=0; i<n; i++) {
+    sout << (nameResults[i].kind == NameIndex::KIND_PLACE ? "Place:  " : "Street: ") << nameResults[i].name
+      << " (tile " << nameResults[i].tileId << ", " << nameResults[i].x << ", " << nameResults[i].y <= ")";
+  }
+}
 
 void setup() {
   sleep(2);
@@ -64,11 +98,15 @@ void setup() {
   sdcard.initialize();
   sdcard.setMapPath(binary_path);
   sdcard.setGPXTrackInPath(gpx_path);
-  while(!sdcard.readHeader(header)) {
+  sdcard.setTrackBinPath(track_path);
+  sdcard.setNamesPath(names_path);
+  sdcard.setGraphPath(graph_path);
+  bool hasFlashMap = flashMap.initialize(header);
+  while(!hasFlashMap && !sdcard.readHeader(header)) {
     UIRENDERER.delay(100);
   }
   UIRENDERER.step();
-  if(sdcard.readGPX(header, track)) {
+  if(sdcard.readTrack(header, track) || sdcard.readGPX(header, track)) {
     UIRENDERER.setGPXTrackIn(&track);
     BOOTSCREEN.trackOK = true;
   } else {
@@ -78,7 +116,7 @@ void setup() {
   }
   UIRENDERER.setHeader(&header);
   UIRENDERER.setGNSS(&gnss);
-  if(!UIRENDERER.initializeMap(&sdcard)){
+  if(!UIRENDERER.initializeMap(&sdcard, hasFlashMap ? &flashMap : NULL)){
     // Map could not be initialized due to insufficient memory. Setup stops.
     BOOTSCREEN.mapOK = -1;
     while(1) {
@@ -87,6 +125,13 @@ void setup() {
   } else {
     BOOTSCREEN.mapOK = true;
   }
+  // Rerouting is optional and only initialized if there is enough memory left after the map buffer
+  if(BOOTSCREEN.trackOK > 0 && rerouter.initialize(&header, &track)) {
+    UIRENDERER.setReroute(rerouter.route());
+  }
+  if(BOOTSCREEN.trackOK > 0 && turnCues.initialize(&header, &track)) {
+    UIRENDERER.setTurnCues(&turnCues);
+  }
   UIRENDERER.setPositionProvider(&ipos);
   
   // Setup was successful. Render some more frames of the bootscreen to show it.
@@ -108,5 +153,13 @@ void loop() {
   // mockPosProvider.changeHeading(currHeading);
 
   UIRENDERER.step();
+  handleNameSearch();
+
+  // Follow the turns of the track and route back to the track if the rider left it
+  GeoPosition pos;
+  if(ipos.isReady() && ipos.getPosition(pos)) {
+    turnCues.step(pos);
+    rerouter.step(pos);
+  }
 
 }
\ No newline at end of file
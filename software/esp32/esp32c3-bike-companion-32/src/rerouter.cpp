@@ -0,0 +1,174 @@
+#include <rerouter.h>
+#include <serialutils.h>
+#include <globalconfig.h>
+
+Rerouter::Rerouter(SharedSPISDCard* sd)
+    : _ready(false), _hasRoute(false), _offTrackChecks(0), _lastOnTrack(0), _tLastCheck(0), _tLastRoute(0), _source(sd) {
+}
+
+bool Rerouter::initialize(SimpleTile::Header* header, GPXTrack* track) {
+    _header = header;
+    _track = track;
+
+    // Memory of the router: node table, hash table, heap and partition cache. Estimated before allocating.
+    Routing::Header graphHeader;
+    if(!_source.read(0, &graphHeader, sizeof(Routing::Header))) {
+        sout.warn() <= "No routing graph found. Rerouting disabled.";
+        return false;
+    }
+    uint32_t nAlloc = ROUTE_MAX_NODES*(24 + 16 + 16) + ROUTE_CACHE_SLOTS*graphHeader.maxPartitionBytes
+        + ROUTE_MAX_POINTS*(2*sizeof(int32_t) + 2*sizeof(int16_t) + sizeof(TrackRun));
+    if((nAlloc + MIN_FREE_HEAP) > ESP.getFreeHeap()) {
+        sout.err() << "Insufficient memory for rerouting. " << ESP.getFreeHeap() << "bytes avaiable, "
+                    << (nAlloc + MIN_FREE_HEAP) <= "bytes required.";
+        return false;
+    }
+    if(!_router.initialize(&_source, header->crc(), ROUTE_CACHE_SLOTS, ROUTE_MAX_NODES)) {
+        sout.warn() <= "Routing graph does not match map. Rerouting disabled.";
+        return false;
+    }
+    _router.heuristicWeight = ROUTE_HEURISTIC_WEIGHT;
+
+    _pathX = new int32_t[ROUTE_MAX_POINTS];
+    _pathY = new int32_t[ROUTE_MAX_POINTS];
+    _route.points = new int16_t[2*ROUTE_MAX_POINTS];
+    _route.runs = new TrackRun[ROUTE_MAX_POINTS];
+    _route.numNodes = 0;
+    _route.numRuns = 0;
+    _route.cues = NULL;
+    _route.numCues = 0;
+    _route.nearestNodeId = 0;
+
+    sout.info() << "Initialized routing graph with " << _router.header.numNodes << " nodes and " 
+                << _router.header.numEdges <= " edges";
+    _ready = true;
+    return true;
+}
+
+void Rerouter::globalPoint(uint32_t pointId, int64_t* x, int64_t* y) {
+    // Find run of the point. Runs are sorted by their first point.
+    uint32_t lo = 0, hi = _track->numRuns;
+    while(hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if(_track->runs[mid].firstPoint <= pointId) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    LocalGeoPosition::getTileLL(_track->runs[lo].tileId, _header, x, y);
+    *x += _track->points[2*pointId];
+    *y += _track->points[2*pointId + 1];
+}
+
+/*
+    Distance in meters to the nearest track point on the tiles around the position
+*/
+float Rerouter::distanceToTrack(GeoPosition& pos, uint32_t& nearest) {
+    uint64_t tileId = LocalGeoPosition::getTileID(pos, _header);
+    int64_t col = tileId % _header->n_x_tiles;
+    int64_t row = tileId / _header->n_x_tiles;
+    int64_t tileX, tileY;
+    float best = -1;
+    for(uint32_t r=0; r<_track->numRuns; r++) {
+        uint64_t runTile = _track->runs[r].tileId;
+        if(abs((int64_t) (runTile % _header->n_x_tiles) - col) > 1 || abs((int64_t) (runTile / _header->n_x_tiles) - row) > 1) continue;
+        LocalGeoPosition::getTileLL(runTile, _header, &tileX, &tileY);
+        for(uint32_t p=_track->runs[r].firstPoint; p<_track->runEnd(r); p++) {
+            float dx = tileX + _track->points[2*p] - pos.x();
+            float dy = tileY + _track->points[2*p + 1] - pos.y();
+            float d = dx*dx + dy*dy;
+            if(best < 0 || d < best) {
+                best = d;
+                nearest = p;
+            }
+        }
+    }
+    // Mercator units to meters
+    return best < 0 ? -1 : sqrt(best) * cos(pos.lat() * DEG_TO_RAD);
+}
+
+/*
+    Track point ROUTE_REJOIN_DISTANCE meters after the given point
+*/
+uint32_t Rerouter::rejoinPoint(uint32_t from) {
+    // Meters per mercator unit
+    float scale = 1.0 / cosh(_header->map_y / R_EARTH);
+    int64_t x0, y0, x1, y1;
+    globalPoint(from, &x0, &y0);
+    float distance = 0;
+    uint32_t p = from;
+    while(p + 1 < _track->numNodes && distance < ROUTE_REJOIN_DISTANCE) {
+        globalPoint(p + 1, &x1, &y1);
+        distance += sqrt((float) ((x1 - x0)*(x1 - x0) + (y1 - y0)*(y1 - y0))) * scale;
+        x0 = x1;
+        y0 = y1;
+        p++;
+    }
+    return p;
+}
+
+bool Rerouter::reroute(GeoPosition& pos) {
+    int64_t goalX, goalY;
+    globalPoint(rejoinPoint(_lastOnTrack), &goalX, &goalY);
+
+    long t_start = millis();
+    uint32_t n = _router.route(pos.x(), pos.y(), goalX, goalY, _pathX, _pathY, ROUTE_MAX_POINTS);
+    sout.info() << "Reroute: " << n << " points, " << _router.stats.expanded << " nodes, "
+                << _router.stats.partitionLoads << " partitions loaded in " << (millis() - t_start) <= "ms";
+    if(n < 2) return false;
+
+    // Convert route into a track with runs per tile
+    _route.numRuns = 0;
+    for(uint32_t i=0; i<n; i++) {
+        uint64_t tileId = LocalGeoPosition::getTileID(_pathX[i], _pathY[i], _header->map_x, _header->map_y, _header->tile_size, _header->n_x_tiles);
+        if(!_route.numRuns || _route.runs[_route.numRuns-1].tileId != tileId) {
+            _route.runs[_route.numRuns].tileId = tileId;
+            _route.runs[_route.numRuns].firstPoint = i;
+            _route.numRuns++;
+        }
+        int64_t tileX, tileY;
+        LocalGeoPosition::getTileLL(tileId, _header, &tileX, &tileY);
+        _route.points[2*i] = _pathX[i] - tileX;
+        _route.points[2*i + 1] = _pathY[i] - tileY;
+    }
+    _route.numNodes = n;
+    return true;
+}
+
+bool Rerouter::step(GeoPosition& pos) {
+    if(!_ready || !_track->numNodes) return false;
+    if(millis() - _tLastCheck < ROUTE_CHECK_INTERVAL_MS) return false;
+    _tLastCheck = millis();
+
+    uint32_t nearest;
+    float distance = distanceToTrack(pos, nearest);
+    if(distance >= 0 && distance < ROUTE_OFF_TRACK_DISTANCE) {
+        // Back on track
+        _lastOnTrack = nearest;
+        _offTrackChecks = 0;
+        if(_hasRoute) {
+            _hasRoute = false;
+            _route.numNodes = 0;
+            _route.numRuns = 0;
+            return true;
+        }
+        return false;
+    }
+
+    // Require two consecutive checks off track to ignore single bad fixes
+    if(_offTrackChecks < 2) _offTrackChecks++;
+    if(_offTrackChecks < 2) return false;
+    if(_hasRoute && millis() - _tLastRoute < ROUTE_MIN_INTERVAL_MS) return false;
+    _tLastRoute = millis();
+    _hasRoute = reroute(pos);
+    return _hasRoute;
+}
+
+bool Rerouter::hasRoute() {
+    return _hasRoute;
+}
+
+GPXTrack* Rerouter::route() {
+    return &_route;
+}
@@ -9,7 +9,7 @@
 #include <serialutils.h>
 
 SharedSPIDisplay::SharedSPIDisplay(uint8_t PIN_CS) : 
-    _PIN_CS(PIN_CS), disp(&SPI, PIN_CS, DISPLAY_WIDTH, DISPLAY_HEIGHT, SPI_FREQ), SharedSPIDevice() {
+    SharedSPIDevice(), disp(&SPI, PIN_CS, DISPLAY_WIDTH, DISPLAY_HEIGHT, SPI_FREQ), _PIN_CS(PIN_CS) {
 
     // Setup chip selector pin
     pinMode(PIN_CS, OUTPUT);
@@ -37,6 +37,7 @@ void SharedSPIDisplay::disableCS() {
 };
 
 void SharedSPIDisplay::initialize() {
+    SharedSPILock lock;
     SMUTEX.aquireSPI(this);
     while(!disp.begin()) {
         delay(100);
@@ -51,6 +52,7 @@ void SharedSPIDisplay::initialize() {
 }
 
 void SharedSPIDisplay::newPage() {
+    SharedSPILock lock;
     SMUTEX.aquireSPI(this);
     clearDisplay();
     disp.setTextSize(1);
@@ -60,6 +62,7 @@ void SharedSPIDisplay::newPage() {
 }
 
 void SharedSPIDisplay::clearDisplay() { 
+    SharedSPILock lock;
     SMUTEX.aquireSPI(this);
     disp.clearDisplay();
 }
@@ -72,7 +75,8 @@ void SharedSPIDisplay::clearDisplayBuffer() {
 }
 
 void SharedSPIDisplay::drawCenterMarker() {
-    SMUTEX.aquireSPI(this);
+    // Does not write anything to the display so
+    // we dont need SPI bus access
     int16_t x0, y0, x1, y1, x2, y2;
     x0 = DISPLAY_WIDTH_HALF - POSITION_MARKER_SIZE;
     y0 = DISPLAY_WIDTH_HALF + POSITION_MARKER_SIZE;
@@ -84,7 +88,8 @@ void SharedSPIDisplay::drawCenterMarker() {
 };
 
 void SharedSPIDisplay::drawStatusBar(const char* statusStr) {
-    SMUTEX.aquireSPI(this);
+    // Does not write anything to the display so
+    // we dont need SPI bus access
     disp.fillRect(0, DISPLAY_WIDTH, DISPLAY_WIDTH, DISPLAY_HEIGHT-DISPLAY_WIDTH, WHITE);
     draw_line(0, DISPLAY_WIDTH, DISPLAY_WIDTH, DISPLAY_WIDTH, 4, BLACK);
     disp.setTextSize(2);
@@ -95,6 +100,7 @@ void SharedSPIDisplay::drawStatusBar(const char* statusStr) {
 };
 
 void SharedSPIDisplay::refresh() {
+    SharedSPILock lock;
     SMUTEX.aquireSPI(this);
     disp.refresh();
 }
@@ -124,7 +130,8 @@ void SharedSPIDisplay::drawPixel(int16_t x, int16_t y, uint16_t color) {
 }
 
 void SharedSPIDisplay::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
-    SMUTEX.aquireSPI(this);
+    // Does not write anything to the display so
+    // we dont need SPI bus access
     disp.fillCircle(x0, y0, r, color);
 }
 
@@ -136,82 +143,19 @@ void SharedSPIDisplay::write(const char* str, bool hold) {
     disp.setTextColor(BLACK);
     disp.write(str);
     if(!hold) {
-        SMUTEX.aquireSPI(this);
-        disp.refresh();
+        refresh();
     }
 }
 
 void SharedSPIDisplay::draw_line(int x0, int y0, int x1, int y1, uint8_t thickness, uint16_t color) {
     // Does not write anything to the display so
     // we dont need SPI bus access
-    int dx =  abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
-    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
-    int err = dx + dy, e2;
-
-    if(dx < -dy) {
-        while (1) {
-        disp.drawPixel(x0, y0, color);
-        for(int i=0; i<thickness-1; i++) {
-            disp.drawPixel(x0+thickness_offsets[i], y0, color);
-        }
-        if (x0 == x1 && y0 == y1) break;
-        e2 = 2 * err;
-        if (e2 > dy) { err += dy; x0 += sx; }
-        if (e2 < dx) { err += dx; y0 += sy; }
-        }
-    } else {
-        while (1) {
-        disp.drawPixel(x0, y0, color);
-        for(int i=0; i<thickness-1; i++) {
-            disp.drawPixel(x0, y0+thickness_offsets[i], color);
-        }
-        if (x0 == x1 && y0 == y1) break;
-        e2 = 2 * err;
-        if (e2 > dy) { err += dy; x0 += sx; }
-        if (e2 < dx) { err += dx; y0 += sy; }
-        }
-    }
-
+    disp.drawThickLine(x0, y0, x1, y1, thickness, color);
 }
 
 
 void SharedSPIDisplay::draw_dashedline(int x0, int y0, int x1, int y1, uint8_t thickness, uint8_t dashLength, uint16_t color) {
     // Does not write anything to the display so
     // we dont need SPI bus access
-    int dx =  abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
-    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
-    int err = dx + dy, e2;
-
-    uint8_t cnt = 0;
-
-    if(dx < -dy) {
-        while (1) {
-        ++cnt %= dashLength;
-        if(!cnt) color = !color;
-
-        disp.drawPixel(x0, y0, color);
-        for(int i=0; i<thickness-1; i++) {
-            disp.drawPixel(x0+thickness_offsets[i], y0, color);
-        }
-        if (x0 == x1 && y0 == y1) break;
-        e2 = 2 * err;
-        if (e2 > dy) { err += dy; x0 += sx; }
-        if (e2 < dx) { err += dx; y0 += sy; }
-        }
-    } else {
-        while (1) {
-        ++cnt %= dashLength;
-        if(!cnt) color = !color;
-
-        disp.drawPixel(x0, y0, color);
-        for(int i=0; i<thickness-1; i++) {
-            disp.drawPixel(x0, y0+thickness_offsets[i], color);
-        }
-        if (x0 == x1 && y0 == y1) break;
-        e2 = 2 * err;
-        if (e2 > dy) { err += dy; x0 += sx; }
-        if (e2 < dx) { err += dx; y0 += sy; }
-        }
-    }
-
-}
\ No newline at end of file
+    disp.drawThickLine(x0, y0, x1, y1, thickness, color, dashLength);
+}
@@ -3,7 +3,10 @@
 #include <uirenderer.h>
 #include <screens.h>
 #include <SD.h>
+#include <ff.h>
+#include <diskio.h>
 #include <serialutils.h>
+#include <globalconfig.h>
 
 SharedSPISDCard::SharedSPISDCard(uint8_t PIN_CS) : _PIN_CS(PIN_CS) {
     // Setup chip selector pin
@@ -12,11 +15,14 @@ SharedSPISDCard::SharedSPISDCard(uint8_t PIN_CS) : _PIN_CS(PIN_CS) {
     disableCS();
 
     read_bytes = 0;
+    _mapRaw = false;
+    _sparseIndex = NULL;
 
     SMUTEX.registerDevice(this);
 }
 
 void SharedSPISDCard::initialize() {
+    SharedSPILock lock;
     SMUTEX.aquireSPI(this);
     bool success = false;
     while(1) {
@@ -69,6 +75,18 @@ bool SharedSPISDCard::openFile(FileType fileType) {
                 success = openFile(_gpxTrackOutPath);
                 break;
 
+            case TrackBin:
+                success = openFile(_trackBinPath);
+                break;
+
+            case Names:
+                success = openFile(_namesPath);
+                break;
+
+            case Graph:
+                success = openFile(_graphPath);
+                break;
+
             default:
                 sout.warn() <= "Tryied to open unknown filetype";
                 break;
@@ -84,6 +102,7 @@ bool SharedSPISDCard::openFile(FileType fileType) {
 }
 
 bool SharedSPISDCard::exists(const char* path) {
+    SharedSPILock lock;
     SMUTEX.aquireSPI(this);
     return SD.exists(path);
 };
@@ -94,60 +113,268 @@ void SharedSPISDCard::closeFile() {
 };
 
 bool SharedSPISDCard::readHeader(SimpleTile::Header& header) {
+    SharedSPILock lock;
     if(!openFile(Map)) return false;
 
-    if(file.available()) {
-        file.readBytes((char*) &(header.map_x), 8);
-        file.readBytes((char*) &(header.map_y), 8);
-        file.readBytes((char*) &(header.map_width), 8);
-        file.readBytes((char*) &(header.map_height), 8);
-        file.readBytes((char*) &(header.n_x_tiles), 8);
-        file.readBytes((char*) &(header.tile_size), 8);
-        file.readBytes((char*) &(header.n_tiles), 8);
-        file.readBytes((char*) &(header.max_nodes), 8);
-        file.readBytes((char*) &(header.n_nodes), 8);
-        file.readBytes((char*) &(header.n_ways), 8);
-    } else {
+    // The header of both versions is read at once. Version 1 maps may be shorter than the header of version 2.
+    uint8_t raw[sizeof(SimpleTileFormat::MapHeaderV2)];
+    file.seek(0);
+    size_t n = file.read(raw, sizeof(raw));
+    uint8_t version = SimpleTileFormat::parseHeader(raw, n, header, header.flags, header.n_entries);
+    if(!version) {
+        sout.err() <= "Map has no valid header";
         return false;
     }
+    header.setLayout(version);
+
+    readSparseIndex(header);
+    if(SDCARD_RAW_MAP_READS) resolveMapSectors();
 
     return true;
 }
 
-bool SharedSPISDCard::readTile(SimpleTile::Header& header, int16_t* tile_node_buffer, uint64_t& tileSize, int tile_id) {
-    if(!openFile(Map)) {
-        sout.warn() <= "Failed to read tile";
+/*
+    Keep the tile index of a sparse map in memory if it is small enough, which is the case for corridor maps.
+    Otherwise every row of the entry window costs two binary searches with a seek and a read per probe.
+*/
+bool SharedSPISDCard::readSparseIndex(SimpleTile::Header& header) {
+    free(_sparseIndex);
+    _sparseIndex = NULL;
+    if(header.version != 2 || !(header.flags & SimpleTile::FLAG_SPARSE) || !header.n_entries) return false;
+    if(header.n_entries*sizeof(uint32_t) > SPARSE_INDEX_MAX_BYTES) {
+        sout.info() <= "Sparse tile index is searched on the SD-card";
         return false;
     }
 
-    // Get pointer and size of tile
-    uint64_t ptr_tile, ptr_next_tile;
+    _sparseIndex = (uint32_t*) malloc(header.n_entries*sizeof(uint32_t));
+    if(!_sparseIndex) {
+        sout.warn() <= "Not enough memory for the sparse tile index, it is searched on the SD-card";
+        return false;
+    }
+    file.seek(header.index_offset);
+    if(file.readBytes((char*) _sparseIndex, header.n_entries*sizeof(uint32_t)) != header.n_entries*sizeof(uint32_t)) {
+        sout.warn() <= "Failed to read the sparse tile index";
+        free(_sparseIndex);
+        _sparseIndex = NULL;
+        return false;
+    }
+    sout.info() << "Sparse tile index of " << (uint32_t) header.n_entries <= " tiles is kept in memory";
+    return true;
+}
+
+/*
+    Find the sectors of the map file. The cluster chain is followed through the FAT once. If every cluster
+    follows the previous one, tile data is read by sector with multi-block reads straight into the tile
+    buffer, without the cluster chain walks and the buffer of the file system. Fragmented files, exFAT and
+    sector sizes other than 512 bytes are read through the file system.
+*/
+bool SharedSPISDCard::resolveMapSectors() {
+    SharedSPILock lock;
+    SMUTEX.aquireSPI(this);
+    _mapRaw = false;
+
+    // The SD-card is the first volume of FatFs that holds the map
+    FIL fil;
+    char path[64];
+    uint8_t drive;
+    for(drive=0; drive<FF_VOLUMES; drive++) {
+        snprintf(path, sizeof(path), "%u:%s", drive, _mapPath);
+        if(f_open(&fil, path, FA_READ) == FR_OK) break;
+    }
+    if(drive == FF_VOLUMES) {
+        sout.info() <= "Map is read through the file system";
+        return false;
+    }
 
-    // Move reader to tile pointer
-    file.seek(sizeof(uint64_t)*(10 + tile_id));
-    // Read tile pointer
-    file.readBytes((char *) &ptr_tile, sizeof(uint64_t));
-    // Read next tile pointer (if it is not the last tile)
-    if(tile_id < header.n_tiles) {
-        file.readBytes((char *) &ptr_next_tile, sizeof(uint64_t));
+    FATFS* fs = fil.obj.fs;
+    uint32_t cluster = fil.obj.sclust;
+    uint64_t clusterBytes = (uint64_t) fs->csize * 512;
+    uint32_t nClusters = (fil.obj.objsize + clusterBytes - 1) / clusterBytes;
+    bool contiguous = (fs->fs_type == FS_FAT16 || fs->fs_type == FS_FAT32) && cluster >= 2;
+#if FF_MAX_SS != FF_MIN_SS
+    contiguous &= fs->ssize == 512;
+#endif
+
+    // FAT entries are 2 (FAT16) or 4 (FAT32) bytes
+    uint8_t entryBytes = fs->fs_type == FS_FAT32 ? 4 : 2;
+    uint8_t fat[512];
+    LBA_t fatSector = 0;
+    for(uint32_t i=1; i<nClusters && contiguous; i++) {
+        LBA_t sector = fs->fatbase + (uint64_t) cluster * entryBytes / 512;
+        if(sector != fatSector) {
+            if(disk_read(drive, fat, sector, 1) != RES_OK) {
+                contiguous = false;
+                break;
+            }
+            fatSector = sector;
+        }
+        uint32_t next = 0;
+        memcpy(&next, fat + (cluster * entryBytes) % 512, entryBytes);
+        if(entryBytes == 4) next &= 0x0FFFFFFF;
+        contiguous = next == cluster + 1;
+        cluster = next;
+    }
+
+    if(contiguous) {
+        _mapDrive = drive;
+        _mapSector = fs->database + (LBA_t) (fil.obj.sclust - 2) * fs->csize;
+        _mapRaw = true;
+        sout.info() << "Map is read by sector from sector " <= _mapSector;
     } else {
-        ptr_next_tile = file.size();
+        sout.info() <= "Map is fragmented, it is read through the file system";
     }
-    tileSize = ptr_next_tile - ptr_tile;
+    f_close(&fil);
+    return _mapRaw;
+}
 
-    // Move reader to start of tile
-    file.seek(sizeof(uint64_t)*(10 + header.n_tiles) + ptr_tile);
-    // Read tile
-    file.readBytes((char *) tile_node_buffer, tileSize);
+/*
+    Read size bytes at offset of the map file by sector. Whole sectors are read into the buffer at once,
+    only the partial sectors at the start and the end go through a sector buffer.
+*/
+bool SharedSPISDCard::readMapRaw(uint64_t offset, uint64_t size, uint8_t* buffer) {
+    SharedSPILock lock;
+    SMUTEX.aquireSPI(this);
+    uint8_t block[512];
+    LBA_t sector = _mapSector + offset / 512;
+    uint16_t skip = offset % 512;
+    if(skip) {
+        if(disk_read(_mapDrive, block, sector, 1) != RES_OK) return false;
+        uint16_t n = min(size, (uint64_t) (512 - skip));
+        memcpy(buffer, block + skip, n);
+        buffer += n;
+        size -= n;
+        sector++;
+    }
+    if(size >= 512) {
+        UINT count = size / 512;
+        if(disk_read(_mapDrive, buffer, sector, count) != RES_OK) return false;
+        buffer += count * 512;
+        size -= count * 512;
+        sector += count;
+    }
+    if(size) {
+        if(disk_read(_mapDrive, block, sector, 1) != RES_OK) return false;
+        memcpy(buffer, block, size);
+    }
+    return true;
+}
+
+/*
+    Position of the first stored tile with an ID of at least tile_id in the entry table of a version 2 map,
+    which is known to be in [lo, hi]. Sparse maps are searched with a binary search over the tile index in
+    memory, or on the SD-card if it is too large.
+*/
+uint64_t SharedSPISDCard::lowerBoundEntry(SimpleTile::Header& header, uint64_t tile_id, uint64_t lo, uint64_t hi) {
+    if(!(header.flags & SimpleTile::FLAG_SPARSE)) {
+        return min(tile_id, header.n_entries);
+    }
+    uint32_t id;
+    while(lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if(_sparseIndex) {
+            id = _sparseIndex[mid];
+        } else {
+            file.seek(header.index_offset + 4*mid);
+            file.readBytes((char*) &id, 4);
+        }
+        if(id < tile_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+    Entries (see SimpleTile::packEntry) of the tiles in a window of width x height tiles with the lower left
+    tile at (x0, y0), row by row. Every row of the window is contiguous in the file and read at once.
+    Tiles outside of the map and tiles that are not stored in a sparse map are empty (entry 0).
+*/
+bool SharedSPISDCard::readTileEntries(SimpleTile::Header& header, uint64_t x0, uint64_t y0, uint16_t width, uint16_t height, uint64_t* entries) {
+    SharedSPILock lock;
+    if(!openFile(Map)) {
+        sout.warn() <= "Failed to read tile entries";
+        return false;
+    }
+    memset(entries, 0, width*height*sizeof(uint64_t));
+    if(x0 >= header.n_x_tiles || width > TILE_ENTRY_WINDOW) return true;
+    uint16_t n = min((uint64_t) width, header.n_x_tiles - x0);
+    // Entries of a sparse row or pointers of version 1 maps, with the pointer of the next tile for the size of the last one
+    uint64_t pointers[TILE_ENTRY_WINDOW + 1];
+    uint32_t idBuffer[TILE_ENTRY_WINDOW];
+
+    // Bounds of the stored tiles of the previous row, so every row is searched in few entries of the index
+    uint64_t prevEnd = 0;
+    uint64_t hi = 0;
+    for(uint16_t row=0; row<height; row++) {
+        uint64_t first = (y0 + row) * header.n_x_tiles + x0;
+        if(first >= header.n_tiles) break;
+        uint16_t count = min((uint64_t) n, header.n_tiles - first);
+        uint64_t* rowEntries = entries + row*width;
+
+        if(header.version == 2 && (header.flags & SimpleTile::FLAG_SPARSE)) {
+            // Stored tiles of the row
+            uint64_t lo = lowerBoundEntry(header, first, hi, min(header.n_entries, hi + first - prevEnd));
+            hi = lowerBoundEntry(header, first + count, lo, min(header.n_entries, lo + count));
+            prevEnd = first + count;
+            if(lo == hi) continue;
+            const uint32_t* ids = idBuffer;
+            if(_sparseIndex) {
+                ids = _sparseIndex + lo;
+            } else {
+                file.seek(header.index_offset + 4*lo);
+                file.readBytes((char*) idBuffer, 4*(hi - lo));
+            }
+            file.seek(header.entryPosition(lo));
+            file.readBytes((char*) pointers, sizeof(uint64_t)*(hi - lo));
+            for(uint16_t i=0; i<hi-lo; i++) {
+                rowEntries[ids[i] - first] = pointers[i];
+            }
+        } else if(header.version == 2) {
+            file.seek(header.entryPosition(first));
+            file.readBytes((char*) rowEntries, sizeof(uint64_t)*count);
+        } else {
+            file.seek(header.entryPosition(first));
+            if(first + count < header.n_tiles) {
+                file.readBytes((char*) pointers, sizeof(uint64_t)*(count + 1));
+            } else {
+                file.readBytes((char*) pointers, sizeof(uint64_t)*count);
+                pointers[count] = file.size() - header.data_offset;
+            }
+            // Tiles of version 1 maps consist of coordinate pairs, so offsets and sizes are multiples of 4
+            for(uint16_t i=0; i<count; i++) {
+                rowEntries[i] = SimpleTile::packEntry(pointers[i], pointers[i+1] - pointers[i], 0);
+            }
+        }
+    }
 
     return true;
 }
 
+bool SharedSPISDCard::readTileData(SimpleTile::Header& header, uint64_t tileOffset, uint64_t tileSize, int16_t* tile_node_buffer) {
+    SharedSPILock lock;
+    if(_mapRaw) return readMapRaw(header.data_offset + tileOffset, tileSize, (uint8_t*) tile_node_buffer);
+    if(!openFile(Map)) {
+        sout.warn() <= "Failed to read tile";
+        return false;
+    }
+    if(!tileSize) return true;
+
+    // Move reader to start of tile
+    file.seek(header.data_offset + tileOffset);
+    // Read tile
+    return file.readBytes((char *) tile_node_buffer, tileSize) == tileSize;
+}
+
 void SharedSPISDCard::setMapPath(const char* mapPath) {
+    SharedSPILock lock;
     // Update path
     free(_mapPath);
     _mapPath = new char[strlen(mapPath)];
     strcpy(_mapPath, mapPath);
+    // Sectors are resolved with the next header
+    _mapRaw = false;
     // Reload file if it is open
     if(_currFileType == FileType::Map) {
         closeFile();
@@ -156,6 +383,7 @@ void SharedSPISDCard::setMapPath(const char* mapPath) {
 };
 
 void SharedSPISDCard::setGPXTrackInPath(const char* gpxTrackInPath) {
+    SharedSPILock lock;
     // Update path
     free(_gpxTrackInPath);
     _gpxTrackInPath = new char[strlen(gpxTrackInPath)];
@@ -168,6 +396,7 @@ void SharedSPISDCard::setGPXTrackInPath(const char* gpxTrackInPath) {
 };
 
 void SharedSPISDCard::setGPXTrackOutPath(const char* gpxTrackOutPath) {
+    SharedSPILock lock;
     // Update path
     free(_gpxTrackOutPath);
     _gpxTrackOutPath = new char[strlen(gpxTrackOutPath)];
@@ -179,9 +408,210 @@ void SharedSPISDCard::setGPXTrackOutPath(const char* gpxTrackOutPath) {
     }
 };
 
+void SharedSPISDCard::setTrackBinPath(const char* trackBinPath) {
+    SharedSPILock lock;
+    // Update path
+    free(_trackBinPath);
+    _trackBinPath = new char[strlen(trackBinPath) + 1];
+    strcpy(_trackBinPath, trackBinPath);
+    // Reload file if it is open
+    if(_currFileType == FileType::TrackBin) {
+        closeFile();
+        openFile(_trackBinPath);
+    }
+};
+
+/*
+    Reads a binary track with a single read. Runs and points are used directly from the read buffer,
+    only the delta-encoded points are decoded in place.
+*/
+bool SharedSPISDCard::readTrack(SimpleTile::Header& header, GPXTrack& track) {
+    SharedSPILock lock;
+    if(!openFile(TrackBin)) {
+        return false;
+    }
+
+    size_t fileSize = file.size();
+    if(fileSize < sizeof(SimpleTrack::Header)) {
+        sout.warn() <= "Binary track is too small.";
+        return false;
+    }
+    if((fileSize + MIN_FREE_HEAP) > ESP.getFreeHeap()) {
+        sout.err() << "Insufficient memory for binary track. " << fileSize <= "bytes required.";
+        return false;
+    }
+    uint8_t* buffer = (uint8_t*) malloc(fileSize);
+    if(file.read(buffer, fileSize) != fileSize) {
+        sout.err() <= "Failed to read binary track.";
+        free(buffer);
+        return false;
+    }
+    read_bytes += fileSize;
+
+    SimpleTrack::Header* trackHeader = (SimpleTrack::Header*) buffer;
+    // The track has to be compiled for the current map
+    if(memcmp(trackHeader->magic, SimpleTrack::MAGIC, 8) != 0 || trackHeader->headerCrc != header.crc()
+        || fileSize < sizeof(SimpleTrack::Header) + trackHeader->numRuns*sizeof(TrackRun) + trackHeader->numPoints*2*sizeof(int16_t)
+            + trackHeader->numCues*sizeof(TrackCue)) {
+        sout.warn() <= "Binary track does not match map.";
+        free(buffer);
+        return false;
+    }
+
+    track.numNodes = trackHeader->numPoints;
+    track.numRuns = trackHeader->numRuns;
+    track.runs = (TrackRun*) (buffer + sizeof(SimpleTrack::Header));
+    track.points = (int16_t*) (buffer + sizeof(SimpleTrack::Header) + track.numRuns*sizeof(TrackRun));
+    track.numCues = trackHeader->numCues;
+    track.cues = (TrackCue*) (track.points + 2*track.numNodes);
+    track.nearestNodeId = 0;
+
+    // Decode differences within each run
+    for(uint32_t r=0; r<track.numRuns; r++) {
+        for(uint32_t p=track.runs[r].firstPoint + 1; p<track.runEnd(r); p++) {
+            track.points[2*p] += track.points[2*p-2];
+            track.points[2*p+1] += track.points[2*p-1];
+        }
+    }
+
+    sout.info() << "Initialized binary track with " << track.numNodes << " nodes, " << track.numRuns << " runs and "
+                << track.numCues <= " turn cues";
+    return true;
+}
+
+void SharedSPISDCard::setNamesPath(const char* namesPath) {
+    SharedSPILock lock;
+    // Update path
+    free(_namesPath);
+    _namesPath = new char[strlen(namesPath) + 1];
+    strcpy(_namesPath, namesPath);
+    // Reload file if it is open
+    if(_currFileType == FileType::Names) {
+        closeFile();
+        openFile(_namesPath);
+    }
+};
+
+/*
+    Prefix search in the name index. The block of the first match is found with a binary search over the
+    directory, afterwards blocks are read one by one until a name does not match anymore. Only the search
+    keys of the directory and the scanned blocks are read from the SD-card.
+*/
+uint16_t SharedSPISDCard::searchNames(SimpleTile::Header& header, const char* prefix, NameIndex::Result* results, uint16_t maxResults) {
+    SharedSPILock lock;
+    if(!openFile(Names)) {
+        return 0;
+    }
+
+    NameIndex::Header namesHeader;
+    file.seek(0);
+    if(file.read((uint8_t*) &namesHeader, sizeof(NameIndex::Header)) != sizeof(NameIndex::Header)
+        || memcmp(namesHeader.magic, NameIndex::MAGIC, 8) != 0 || namesHeader.headerCrc != header.crc()) {
+        sout.warn() <= "Name index does not match map.";
+        return 0;
+    }
+    uint32_t directoryOffset = sizeof(NameIndex::Header);
+    uint32_t blocksOffset = directoryOffset + namesHeader.numBlocks*NameIndex::KEY_SIZE;
+    blocksOffset = ((blocksOffset + NameIndex::BLOCK_SIZE - 1) / NameIndex::BLOCK_SIZE) * NameIndex::BLOCK_SIZE;
+
+    // Search key of the prefix, truncated and zero padded like the directory keys
+    size_t prefixLength = min(strlen(prefix), (size_t) NameIndex::MAX_LENGTH);
+    char query[NameIndex::MAX_LENGTH + 1] = {0};
+    for(size_t i=0; i<prefixLength; i++) {
+        query[i] = NameIndex::lower(prefix[i]);
+    }
+
+    // Last block whose first key is smaller than the prefix. All matches start in this block or later.
+    char key[NameIndex::KEY_SIZE];
+    int32_t lo = 0;
+    int32_t hi = namesHeader.numBlocks - 1;
+    uint32_t block = 0;
+    while(lo <= hi) {
+        int32_t mid = (lo + hi) / 2;
+        file.seek(directoryOffset + mid*NameIndex::KEY_SIZE);
+        file.read((uint8_t*) key, NameIndex::KEY_SIZE);
+        if(memcmp(key, query, NameIndex::KEY_SIZE) < 0) {
+            block = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    uint8_t buffer[NameIndex::BLOCK_SIZE];
+    char name[NameIndex::MAX_LENGTH + 1];
+    uint16_t n = 0;
+    for(; block<namesHeader.numBlocks && n<maxResults; block++) {
+        file.seek(blocksOffset + block*NameIndex::BLOCK_SIZE);
+        if(file.read(buffer, NameIndex::BLOCK_SIZE) != NameIndex::BLOCK_SIZE) break;
+        read_bytes += NameIndex::BLOCK_SIZE;
+
+        uint16_t pos = 0;
+        uint8_t length = 0;
+        while(pos + 2 <= NameIndex::BLOCK_SIZE && n < maxResults) {
+            uint8_t shared = buffer[pos];
+            uint8_t suffix = buffer[pos + 1];
+            // End of block
+            if(!shared && !suffix) break;
+            memcpy(name + shared, buffer + pos + 2, suffix);
+            length = shared + suffix;
+            name[length] = 0;
+            pos += 2 + suffix;
+
+            int cmp = NameIndex::comparePrefix(name, length, query, prefixLength);
+            if(cmp > 0) {
+                // Names are sorted, so no further names can match
+                return n;
+            }
+            if(cmp == 0) {
+                NameIndex::Result& result = results[n++];
+                memcpy(result.name, name, length + 1);
+                result.kind = buffer[pos];
+                memcpy(&result.tileId, buffer + pos + 1, 4);
+                memcpy(&result.x, buffer + pos + 5, 2);
+                memcpy(&result.y, buffer + pos + 7, 2);
+            }
+            pos += 9;
+        }
+    }
+    return n;
+}
+
+void SharedSPISDCard::setGraphPath(const char* graphPath) {
+    SharedSPILock lock;
+    // Update path
+    free(_graphPath);
+    _graphPath = new char[strlen(graphPath) + 1];
+    strcpy(_graphPath, graphPath);
+    // Reload file if it is open
+    if(_currFileType == FileType::Graph) {
+        closeFile();
+        openFile(_graphPath);
+    }
+};
+
+bool SharedSPISDCard::readGraph(uint32_t offset, void* buffer, uint32_t size) {
+    SharedSPILock lock;
+    if(!openFile(Graph)) {
+        return false;
+    }
+    if(!file.seek(offset) || file.read((uint8_t*) buffer, size) != size) {
+        return false;
+    }
+    read_bytes += size;
+    return true;
+}
+
 bool SharedSPISDCard::readGPX(SimpleTile::Header& header, GPXTrack& track) {
+    SharedSPILock lock;
     // TODO: This is horrible
 
+    // Track points are stored in local tile coordinates, which only fit into int16 for small tiles
+    if(header.tile_size > INT16_MAX) {
+        sout.err() <= "GPX tracks need a map with a tile size of at most 32767";
+        return false;
+    }
+
     if(!openFile(GPXTrackIn)) {
         sout.warn() <= "Failed to read GPX file.";
         return false;
@@ -198,10 +628,13 @@ bool SharedSPISDCard::readGPX(SimpleTile::Header& header, GPXTrack& track) {
         }
     };
 
-    // Allocate memory for track data
-    track.tileIdList = new uint64_t[n_nodes];
-    track.xList = new int16_t[n_nodes];
-    track.yList = new int16_t[n_nodes];
+    // Allocate memory for track data. Runs are allocated for the worst case of one run per node and shrunk afterwards.
+    track.points = new int16_t[2*n_nodes];
+    track.runs = (TrackRun*) malloc(n_nodes*sizeof(TrackRun));
+    track.numRuns = 0;
+    // Turn cues are only compiled into binary tracks
+    track.cues = NULL;
+    track.numCues = 0;
 
 
     double lat, lon;
@@ -244,15 +677,21 @@ bool SharedSPISDCard::readGPX(SimpleTile::Header& header, GPXTrack& track) {
             pos.updatePosition(lat, lon);
             LocalGeoPosition locPos(pos, &header);
 
-            track.tileIdList[i] = locPos.getTileID();
-            track.xList[i] = locPos.xLocal();
-            track.yList[i] = locPos.yLocal();
+            // Start a new run if the tile changes
+            if(!track.numRuns || track.runs[track.numRuns-1].tileId != locPos.tileId()) {
+                track.runs[track.numRuns].tileId = locPos.tileId();
+                track.runs[track.numRuns].firstPoint = i;
+                track.numRuns++;
+            }
+            track.points[2*i] = locPos.xLocal();
+            track.points[2*i+1] = locPos.yLocal();
             
             i++;   
         }
     };
 
     track.numNodes = n_nodes;
+    track.runs = (TrackRun*) realloc(track.runs, (track.numRuns ? track.numRuns : 1)*sizeof(TrackRun));
     
     sout.info() << "Initialized GPX-Track with " << n_nodes <= " nodes";
     // Read all nodes. For each node we get the tile. 
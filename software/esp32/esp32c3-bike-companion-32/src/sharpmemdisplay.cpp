@@ -0,0 +1,189 @@
+#include <sharpmemdisplay.h>
+
+// Command bits, LSB first
+#define SHARPMEM_BIT_WRITECMD 0x01
+#define SHARPMEM_BIT_VCOM 0x02
+#define SHARPMEM_BIT_CLEAR 0x04
+
+SharpMemDisplay::SharpMemDisplay(SPIClass* spi, uint8_t cs, uint16_t width, uint16_t height, uint32_t freq)
+    : Adafruit_GFX(width, height), _spi(spi), _cs(cs), _freq(freq), _vcom(SHARPMEM_BIT_VCOM), _buffer(NULL),
+      _line(NULL), _sent(NULL), _hasSent(false), _stride(width / 8) {}
+
+bool SharpMemDisplay::begin() {
+    // Chip select of the display is active high
+    pinMode(_cs, OUTPUT);
+    digitalWrite(_cs, LOW);
+    _vcom = SHARPMEM_BIT_VCOM;
+    if(!_buffer) _buffer = new uint8_t[_stride * _height];
+    if(!_line) _line = new uint8_t[_stride + 2];
+    if(!_sent) _sent = new uint8_t[_stride * _height];
+    if(!_buffer || !_line || !_sent) return false;
+    // The content of the panel is unknown, so the first refresh sends every line
+    _hasSent = false;
+    clearDisplayBuffer();
+    return true;
+}
+
+void SharpMemDisplay::drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if(x < 0 || x >= _width || y < 0 || y >= _height) return;
+    uint8_t* b = _buffer + y*_stride + (x >> 3);
+    if(color) {
+        *b |= 1 << (x & 7);
+    } else {
+        *b &= ~(1 << (x & 7));
+    }
+}
+
+uint8_t SharpMemDisplay::getPixel(uint16_t x, uint16_t y) {
+    if(x >= _width || y >= _height) return 0;
+    return (_buffer[y*_stride + (x >> 3)] >> (x & 7)) & 1;
+}
+
+// Clears the buffer and the display with the clear command instead of sending a white frame
+void SharpMemDisplay::clearDisplay() {
+    clearDisplayBuffer();
+    memset(_sent, 0xFF, _stride * _height);
+    _hasSent = true;
+    uint8_t command[2] = {(uint8_t) (_vcom | SHARPMEM_BIT_CLEAR), 0x00};
+    _spi->beginTransaction(SPISettings(_freq, LSBFIRST, SPI_MODE0));
+    digitalWrite(_cs, HIGH);
+    _spi->writeBytes(command, 2);
+    _vcom ^= SHARPMEM_BIT_VCOM;
+    digitalWrite(_cs, LOW);
+    _spi->endTransaction();
+}
+
+void SharpMemDisplay::clearDisplayBuffer() {
+    memset(_buffer, 0xFF, _stride * _height);
+}
+
+/*
+    Send the lines of the framebuffer that changed since the last refresh. Every line is sent as its address
+    (1-based), the data and a trailing 0x00, the write command ends with another 0x00. Without changed lines,
+    the display command (no write bit) toggles VCOM.
+*/
+void SharpMemDisplay::refresh() {
+    bool writing = false;
+    _spi->beginTransaction(SPISettings(_freq, LSBFIRST, SPI_MODE0));
+    digitalWrite(_cs, HIGH);
+    for(uint16_t y=0; y<_height; y++) {
+        uint8_t* row = _buffer + y*_stride;
+        uint8_t* sent = _sent + y*_stride;
+        if(_hasSent && !memcmp(row, sent, _stride)) continue;
+        if(!writing) {
+            _spi->transfer(_vcom | SHARPMEM_BIT_WRITECMD);
+            writing = true;
+        }
+        _line[0] = y + 1;
+        memcpy(_line + 1, row, _stride);
+        _line[_stride + 1] = 0x00;
+        _spi->writeBytes(_line, _stride + 2);
+        memcpy(sent, row, _stride);
+    }
+    if(writing) {
+        _spi->transfer(0x00);
+    } else {
+        uint8_t command[2] = {_vcom, 0x00};
+        _spi->writeBytes(command, 2);
+    }
+    _vcom ^= SHARPMEM_BIT_VCOM;
+    _hasSent = true;
+    digitalWrite(_cs, LOW);
+    _spi->endTransaction();
+}
+
+void SharpMemDisplay::span(int x0, int x1, int y0, int y1, uint16_t color) {
+    if(x0 < 0) x0 = 0;
+    if(x1 >= _width) x1 = _width - 1;
+    if(y0 < 0) y0 = 0;
+    if(y1 >= _height) y1 = _height - 1;
+    if(x0 > x1 || y0 > y1) return;
+    uint8_t first = x0 >> 3, last = x1 >> 3;
+    uint8_t firstMask = 0xFF << (x0 & 7);
+    uint8_t lastMask = 0xFF >> (7 - (x1 & 7));
+    if(first == last) firstMask &= lastMask;
+    for(uint8_t* row = _buffer + y0*_stride; row <= _buffer + y1*_stride; row += _stride) {
+        if(color) {
+            row[first] |= firstMask;
+            if(first != last) {
+                memset(row + first + 1, 0xFF, last - first - 1);
+                row[last] |= lastMask;
+            }
+        } else {
+            row[first] &= ~firstMask;
+            if(first != last) {
+                memset(row + first + 1, 0x00, last - first - 1);
+                row[last] &= ~lastMask;
+            }
+        }
+    }
+}
+
+void SharpMemDisplay::brush(int x, int y, uint16_t mask, uint8_t thickness, uint16_t color) {
+    if(y < 0 || y >= _height) return;
+    // The brush is at most 7 pixels, so it covers at most two bytes. Near the border, it is clipped per pixel.
+    if(x < 0 || x + thickness > _width) {
+        span(x, x + thickness - 1, y, y, color);
+        return;
+    }
+    uint8_t* b = _buffer + y*_stride + (x >> 3);
+    uint16_t m = mask << (x & 7);
+    if(color) {
+        b[0] |= m;
+        if(m >> 8) b[1] |= m >> 8;
+    } else {
+        b[0] &= ~m;
+        if(m >> 8) b[1] &= ~(m >> 8);
+    }
+}
+
+void SharpMemDisplay::drawThickLine(int x0, int y0, int x1, int y1, uint8_t thickness, uint16_t color, uint8_t dashLength) {
+    int dx =  abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy, e2;
+    int lo = -((thickness - 1) / 2), hi = thickness / 2;
+    uint16_t mask = (1 << thickness) - 1;
+    uint8_t cnt = 0;
+
+    if(dx < -dy) {
+        // y-major: horizontal brush on every row
+        while(true) {
+            if(dashLength) {
+                ++cnt %= dashLength;
+                if(!cnt) color = !color;
+            }
+            brush(x0 + lo, y0, mask, thickness, color);
+            if(x0 == x1 && y0 == y1) break;
+            e2 = 2 * err;
+            if(e2 > dy) { err += dy; x0 += sx; }
+            if(e2 < dx) { err += dx; y0 += sy; }
+        }
+    } else {
+        // x-major: steps on the same row and with the same color form a span, drawn on the rows of the brush
+        int runStart = x0, runY = y0;
+        uint16_t runColor = color;
+        if(dashLength) {
+            ++cnt %= dashLength;
+            if(!cnt) color = !color;
+            runColor = color;
+        }
+        while(true) {
+            if(x0 == x1 && y0 == y1) break;
+            int x = x0;
+            e2 = 2 * err;
+            if(e2 > dy) { err += dy; x0 += sx; }
+            if(e2 < dx) { err += dx; y0 += sy; }
+            if(dashLength) {
+                ++cnt %= dashLength;
+                if(!cnt) color = !color;
+            }
+            if(y0 != runY || color != runColor) {
+                span(min(runStart, x), max(runStart, x), runY + lo, runY + hi, runColor);
+                runStart = x0;
+                runY = y0;
+                runColor = color;
+            }
+        }
+        span(min(runStart, x0), max(runStart, x0), runY + lo, runY + hi, runColor);
+    }
+}
@@ -4,49 +4,111 @@
 #include <globalconfig.h>
 
 TileBlockRenderer::TileBlockRenderer()
-    : _hasPositionProvider(false), _hasHeader(false), _hasTrackIn(false) {
+    : _hasPositionProvider(false), _hasHeader(false), _hasTrackIn(false), _reroute(NULL) {
 
     /*
-        Tile buffer layout for RENDER_TILES_PER_DIM=3.
+        Tile block layout for RENDER_TILES_PER_DIM=3.
         The current position is always on the center tile (here with index 4). 
         _renderTileIds[0] gives the tileId of the lower left tile.
-        _renderTileSizes[0] gives the data size (count of int16_t values) of the lower left tile.
+        _renderTileSlots[0] gives the slot of the tile cache that holds the data of the lower left tile,
+        or -1 while the tile is not loaded yet.
 
         | 6 | 7 | 8 |
         -------------
         | 3 | 4 | 5 |
         -------------
         | 0 | 1 | 2 |
+
+        Each slot of the cache holds one tile. For every slot, _slotTileIds gives the tileId, _slotOffsets
+        the position of its data in the arena, _slotSizes the data size (both counts of int16_t values) and
+        _slotShifts the quantization shift of the tile (coordinates in units of 2^shift). Tiles stay in the
+        cache until they are the least recently used tiles and a new tile needs their slot or arena space,
+        so moving the block never copies tile data.
+
+        The position and size of the tile data in the map file is taken from a window of
+        TILE_ENTRY_WINDOW x TILE_ENTRY_WINDOW tile entries around the center, which the task reads row by row.
+        Tile data is allocated at the end of the arena. Evicted tiles leave holes. When the end is reached,
+        least recently used tiles are evicted until the new tile fits and the arena is compacted.
+        _slotLoading is set from the request of a tile until the prefetch task has read it. Only the
+        renderer changes the slot metadata, the task only writes the tile data of requested slots.
+
+        With a map in flash, _slotOffsets refer to the mapped tile data. Every tile is available at once:
+        the entry is looked up in the mapped index, no data is copied and slots are never loading.
     
     */
     // Store tile IDs currently in view
     _renderTileIds = new uint64_t[N_RENDER_TILES] {0};
-    // Array to store tile size for each tile
-    _renderTileSizes = new uint64_t[N_RENDER_TILES] {0};
-    
-    // Initialize previous center tile ID
-    _prevCenterTileId = 0;
-
-    // Initialize previous tile update time.
-    _prevTileUpdateTime = -TILE_UPDATE_DEBOUNCE_MS;
+    // Store cache slot of each tile in view
+    _renderTileSlots = new int16_t[N_RENDER_TILES];
+    for(uint8_t i=0; i<N_RENDER_TILES; i++) {
+        _renderTileSlots[i] = -1;
+    }
+    _numSlots = 0;
+    _flashMap = NULL;
+    _numLoading = 0;
+    _arenaSize = 0;
+    _arenaUsed = 0;
+    _arenaLive = 0;
+    _arenaFull = false;
+    _cacheClock = 0;
+    _hasEntries = false;
+    _entriesState = EntriesIdle;
+
+    // Tiles predicted to come into view
+    _prefetchTileIds = new uint64_t[N_RENDER_TILES + PREFETCH_TRACK_TILES];
+    _numPrefetch = 0;
+    _prefetchTask = NULL;
+    _prefetchWake = NULL;
+    _tLastPrediction = 0;
+    // No previous position yet
+    _lastX = INT64_MIN;
+    _lastY = INT64_MIN;
+    _trackRun = 0;
     
     _heading = 0;
-    _rotMtxBuf = new float[4];
+    _sinHeading = 0;
+    _cosHeading = 1 << 16;
     _zoomLevel = DETAULT_ZOOM_LEVEL;
 }
 
-bool TileBlockRenderer::initialize(SimpleTile::Header* mapHeader, SharedSPISDCard* sd, SharedSPIDisplay* display) {
+bool TileBlockRenderer::initialize(SimpleTile::Header* mapHeader, SharedSPISDCard* sd, SharedSPIDisplay* display,
+                                   FlashMap* flashMap) {
     _header = mapHeader;
     _sd = sd;
     _display = display;
+    _flashMap = flashMap;
     _zoomScale = ((float) _zoomLevel) * ((float) DISPLAY_WIDTH / (float) (_header->tile_size));
-    // Allocate buffer for tile data.
-    // A tile can have at most mapHeader.max_nodes nodes, each consisting of 2 16-bit numbers.
-    // Since we load at maximum N_RENDER_TILES tiles, we need size for max_nodes*max_tiles*2 16-bit numbers.
-    // Get maximum number of coordinates in each tile
-    _perTileBufferSize = _header->max_nodes * 2;
-    // Calculate memory required for buffer
-    int n_alloc = _perTileBufferSize * N_RENDER_TILES * sizeof(int16_t);
+    _scaleQ16 = _zoomScale * 65536;
+    _numSlots = TILE_CACHE_MAX_TILES;
+    uint32_t slotBytes = sizeof(uint64_t) + 3*sizeof(uint32_t) + sizeof(uint8_t) + sizeof(bool);
+
+    // Tiles of a map in flash are rendered in place, only the slot metadata is allocated
+    if(_flashMap) {
+        if((slotBytes * _numSlots + MIN_FREE_HEAP) > ESP.getFreeHeap()) {
+            sout.err() <= "Insufficient memory for tile cache.";
+            return false;
+        }
+        _tileBase = _flashMap->tileData();
+        _slotTileIds = new uint64_t[_numSlots];
+        _slotOffsets = new uint32_t[_numSlots] {0};
+        _slotSizes = new uint32_t[_numSlots] {0};
+        _slotShifts = new uint8_t[_numSlots] {0};
+        _slotLastUse = new uint32_t[_numSlots] {0};
+        _slotLoading = new bool[_numSlots] {false};
+        for(uint16_t i=0; i<_numSlots; i++) {
+            _slotTileIds[i] = UINT64_MAX;
+        }
+        sout.info() << "Tiles are rendered from flash, cache for up to " << _numSlots <= " tiles";
+        _hasHeader = true;
+        return true;
+    }
+
+    // Allocate the tile cache.
+    // A tile can have at most mapHeader.max_nodes nodes, each consisting of 2 16-bit numbers. The arena must
+    // hold at least the largest tile, the spare heap is used for more tiles.
+    uint32_t maxTileSize = _header->max_nodes * 2;
+    uint32_t entryBytes = 2 * TILE_ENTRY_WINDOW*TILE_ENTRY_WINDOW * sizeof(uint64_t);
+    uint32_t n_alloc = slotBytes * TILE_CACHE_MAX_TILES + maxTileSize * sizeof(int16_t) + entryBytes;
     // Check if there is enough memory available
     if ((n_alloc + MIN_FREE_HEAP) > ESP.getFreeHeap()) {
         // Not enough memory available. Print log and return error
@@ -54,12 +116,37 @@ bool TileBlockRenderer::initialize(SimpleTile::Header* mapHeader, SharedSPISDCar
                     << ESP.getFreeHeap() << "bytes avaiable, "
                     << (n_alloc + MIN_FREE_HEAP) <= "bytes required.";
         return false;
-    } else {
-        // Enough memory avaiable. Initialize buffer and return success
-        _renderTileData = new int16_t[_perTileBufferSize * N_RENDER_TILES] {0};
-        _hasHeader = true;
-        return true;
     }
+    // Enough memory avaiable. Size the arena from the heap that is left and initialize the cache.
+    uint32_t spare = ESP.getFreeHeap() - n_alloc - MIN_FREE_HEAP;
+    spare = spare > TILE_CACHE_HEAP_RESERVE ? spare - TILE_CACHE_HEAP_RESERVE : 0;
+    _arenaSize = min(maxTileSize + spare / (uint32_t) sizeof(int16_t),
+                     max(maxTileSize, (uint32_t) (TILE_CACHE_MAX_BYTES / sizeof(int16_t))));
+    _arena = new int16_t[_arenaSize];
+    _tileBase = _arena;
+    _slotTileIds = new uint64_t[_numSlots];
+    _slotOffsets = new uint32_t[_numSlots] {0};
+    _slotSizes = new uint32_t[_numSlots] {0};
+    _slotShifts = new uint8_t[_numSlots] {0};
+    _slotLastUse = new uint32_t[_numSlots] {0};
+    _slotLoading = new bool[_numSlots] {false};
+    _entries = new uint64_t[TILE_ENTRY_WINDOW*TILE_ENTRY_WINDOW];
+    _nextEntries = new uint64_t[TILE_ENTRY_WINDOW*TILE_ENTRY_WINDOW];
+    for(uint16_t i=0; i<_numSlots; i++) {
+        _slotTileIds[i] = UINT64_MAX;
+    }
+    sout.info() << "Tile cache with " << (_arenaSize * sizeof(int16_t)) << " bytes for up to "
+                << _numSlots <= " tiles";
+
+    // Start the prefetch task. Without it, requested tiles are read on the next frame.
+    _prefetchWake = xSemaphoreCreateBinary();
+    if(!_prefetchWake || xTaskCreate(prefetchTask, "prefetch", PREFETCH_TASK_STACK, this,
+                                     PREFETCH_TASK_PRIORITY, &_prefetchTask) != pdPASS) {
+        sout.warn() <= "Failed to start prefetch task, tiles are read on render";
+        _prefetchTask = NULL;
+    }
+    _hasHeader = true;
+    return true;
     
 }
 
@@ -73,81 +160,400 @@ void TileBlockRenderer::setGPXTrackIn(GPXTrack* track) {
     _hasTrackIn = true;
 }
 
+void TileBlockRenderer::setReroute(GPXTrack* route) {
+    _reroute = route;
+}
+
 void TileBlockRenderer::setZoom(float newZoomLevel) {
     if(!_hasHeader) return;
     _zoomLevel = newZoomLevel;
     _zoomScale = ((float) _zoomLevel) * ((float) DISPLAY_WIDTH / (float) (_header->tile_size));
+    _scaleQ16 = _zoomScale * 65536;
 };
 
+int32_t TileBlockRenderer::slotOf(uint64_t tileId) {
+    for(uint16_t i=0; i<_numSlots; i++) {
+        if(_slotTileIds[i] == tileId) return i;
+    }
+    return -1;
+}
+
+/*
+    Remove the tile of a slot from the cache. Its data becomes a hole in the arena.
+*/
+void TileBlockRenderer::evict(uint16_t slot) {
+    if(_slotTileIds[slot] == UINT64_MAX) return;
+    if(!_flashMap) _arenaLive -= _slotSizes[slot];
+    _slotTileIds[slot] = UINT64_MAX;
+    _slotSizes[slot] = 0;
+}
+
+/*
+    Move the data of all cached tiles to the start of the arena, in the order of their position.
+    Must not run while a tile is loading, as the task writes to the arena.
+*/
+void TileBlockRenderer::compact() {
+    uint32_t end = 0;
+    while(true) {
+        // Cached tile with the lowest position that was not moved yet
+        int32_t next = -1;
+        for(uint16_t i=0; i<_numSlots; i++) {
+            if(_slotTileIds[i] == UINT64_MAX || !_slotSizes[i] || _slotOffsets[i] < end) continue;
+            if(next < 0 || _slotOffsets[i] < _slotOffsets[next]) next = i;
+        }
+        if(next < 0) break;
+        if(_slotOffsets[next] != end) {
+            memmove(_arena + end, _arena + _slotOffsets[next], _slotSizes[next] * sizeof(int16_t));
+            _slotOffsets[next] = end;
+        }
+        end += _slotSizes[next];
+    }
+    _arenaUsed = end;
+}
+
+/*
+    Allocate size int16_t values in the arena. Returns the position or -1 if tiles are loading while the
+    arena needs to be compacted or if the arena is full of tiles that are used on this update (_arenaFull).
+*/
+int32_t TileBlockRenderer::allocate(uint32_t size) {
+    if(_arenaUsed + size > _arenaSize) {
+        if(_numLoading) return -1;
+        while(_arenaLive + size > _arenaSize) {
+            int32_t lru = -1;
+            for(uint16_t i=0; i<_numSlots; i++) {
+                if(_slotTileIds[i] == UINT64_MAX || !_slotSizes[i] || _slotLastUse[i] == _cacheClock) continue;
+                if(lru < 0 || _slotLastUse[i] < _slotLastUse[lru]) lru = i;
+            }
+            if(lru < 0) {
+                _arenaFull = true;
+                return -1;
+            }
+            evict(lru);
+        }
+        compact();
+    }
+    int32_t offset = _arenaUsed;
+    _arenaUsed += size;
+    _arenaLive += size;
+    return offset;
+}
+
+/*
+    Empty slot or least recently used slot that is neither loading nor used on this update. The slot is
+    emptied and marked as used, so it is not returned again on this update.
+*/
+int32_t TileBlockRenderer::freeSlot() {
+    int32_t slot = -1;
+    for(uint16_t i=0; i<_numSlots; i++) {
+        if(_slotLoading[i] || _slotLastUse[i] == _cacheClock) continue;
+        if(_slotTileIds[i] == UINT64_MAX) {
+            slot = i;
+            break;
+        }
+        if(slot < 0 || _slotLastUse[i] < _slotLastUse[slot]) slot = i;
+    }
+    if(slot >= 0) {
+        evict(slot);
+        _slotLastUse[slot] = _cacheClock;
+    }
+    return slot;
+}
+
+/*
+    Entry of a tile from the entry window or the map in flash. Returns false if the tile is outside of the window.
+*/
+bool TileBlockRenderer::tileEntry(uint64_t tileId, uint64_t& entry) {
+    if(_flashMap) {
+        entry = _flashMap->tileEntry(tileId);
+        return true;
+    }
+    if(!_hasEntries) return false;
+    uint64_t x = tileId % _header->n_x_tiles;
+    uint64_t y = tileId / _header->n_x_tiles;
+    if(x < _entriesX0 || x >= _entriesX0 + TILE_ENTRY_WINDOW || y < _entriesY0 || y >= _entriesY0 + TILE_ENTRY_WINDOW) {
+        return false;
+    }
+    entry = _entries[(y - _entriesY0)*TILE_ENTRY_WINDOW + x - _entriesX0];
+    return true;
+}
+
+/*
+    Keep the entry window around the center. A new window is read by the prefetch task as soon as the block
+    around the center plus one ring of tiles is no longer inside the current one, and swapped in once it is
+    read. Returns true if a new window was requested.
+*/
+bool TileBlockRenderer::updateEntries(LocalGeoPosition& center) {
+    if(_flashMap) return false;
+    uint8_t state = _entriesState.load(std::memory_order_acquire);
+    if(state == EntriesLoaded) {
+        uint64_t* entries = _entries;
+        _entries = _nextEntries;
+        _nextEntries = entries;
+        _entriesX0 = _nextEntriesX0;
+        _entriesY0 = _nextEntriesY0;
+        _hasEntries = true;
+    }
+    // A failed window is requested again
+    if(state != EntriesPending) _entriesState.store(EntriesIdle, std::memory_order_relaxed);
+    if(state == EntriesPending || center.tileId() >= _header->n_tiles) return false;
+
+    uint64_t nX = _header->n_x_tiles;
+    uint64_t nY = _header->n_y_tiles();
+    uint64_t x = center.tileId() % nX;
+    uint64_t y = center.tileId() / nX;
+    uint64_t r = RENDER_TILES_PER_DIM_HALF + 1;
+    if(_hasEntries
+       && (x > r ? x - r : 0) >= _entriesX0 && min(x + r, nX - 1) < _entriesX0 + TILE_ENTRY_WINDOW
+       && (y > r ? y - r : 0) >= _entriesY0 && min(y + r, nY - 1) < _entriesY0 + TILE_ENTRY_WINDOW) {
+        return false;
+    }
+    // Window centered on the center tile, moved inside the map
+    _nextEntriesX0 = min(x > TILE_ENTRY_WINDOW/2 ? x - TILE_ENTRY_WINDOW/2 : 0, nX > TILE_ENTRY_WINDOW ? nX - TILE_ENTRY_WINDOW : 0);
+    _nextEntriesY0 = min(y > TILE_ENTRY_WINDOW/2 ? y - TILE_ENTRY_WINDOW/2 : 0, nY > TILE_ENTRY_WINDOW ? nY - TILE_ENTRY_WINDOW : 0);
+    _entriesState.store(EntriesPending, std::memory_order_release);
+    return true;
+}
+
+/*
+    Request the tiles of a list from the prefetch task that are neither cached nor loading. Tiles that follow
+    each other in the list and in the file, like the tiles of a block row, get consecutive arena space and are
+    read at once. Tiles outside of the entry window are skipped. Returns true if tiles were requested.
+*/
+bool TileBlockRenderer::requestTiles(const uint64_t* tileIds, uint16_t n) {
+    bool requested = false;
+    uint64_t entry;
+    uint16_t i = 0;
+    while(i < n) {
+        int32_t cached = slotOf(tileIds[i]);
+        if(cached >= 0) {
+            _slotLastUse[cached] = _cacheClock;
+            i++;
+            continue;
+        }
+        if(!tileEntry(tileIds[i], entry)) {
+            i++;
+            continue;
+        }
+        // Empty tiles need no data, tiles in flash are rendered in place
+        if(!SimpleTile::entrySize(entry) || _flashMap) {
+            int32_t slot = freeSlot();
+            if(slot < 0) return requested;
+            _slotTileIds[slot] = tileIds[i];
+            _slotOffsets[slot] = SimpleTile::entryOffset(entry) / sizeof(int16_t);
+            _slotSizes[slot] = SimpleTile::entrySize(entry) / sizeof(int16_t);
+            _slotShifts[slot] = SimpleTile::entryShift(entry);
+            i++;
+            continue;
+        }
+        // Both queues hold at most PREFETCH_QUEUE_SIZE-1 items
+        if(_numLoading >= PREFETCH_QUEUE_SIZE - 1) return requested;
+
+        // Run of missing tiles with data that follows each other in the file
+        uint64_t runEntries[RENDER_TILES_PER_DIM];
+        runEntries[0] = entry;
+        uint16_t runLength = 1;
+        uint64_t tileOffset = SimpleTile::entryOffset(entry);
+        uint64_t end = tileOffset + SimpleTile::entrySize(entry);
+        while(i + runLength < n && runLength < RENDER_TILES_PER_DIM && slotOf(tileIds[i + runLength]) < 0
+              && tileEntry(tileIds[i + runLength], entry) && SimpleTile::entrySize(entry)
+              && SimpleTile::entryOffset(entry) == end) {
+            runEntries[runLength++] = entry;
+            end += SimpleTile::entrySize(entry);
+        }
+        int32_t slots[RENDER_TILES_PER_DIM];
+        for(uint16_t k=0; k<runLength; k++) {
+            slots[k] = freeSlot();
+            if(slots[k] < 0) {
+                runLength = k;
+                break;
+            }
+        }
+        if(!runLength) return requested;
+        end = SimpleTile::entryOffset(runEntries[runLength - 1]) + SimpleTile::entrySize(runEntries[runLength - 1]);
+        // Entries give sizes in bytes
+        int32_t offset = allocate((end - tileOffset) / sizeof(int16_t));
+        if(offset < 0) return requested;
+
+        uint32_t position = offset;
+        for(uint16_t k=0; k<runLength; k++) {
+            _slotTileIds[slots[k]] = tileIds[i + k];
+            _slotOffsets[slots[k]] = position;
+            _slotSizes[slots[k]] = SimpleTile::entrySize(runEntries[k]) / sizeof(int16_t);
+            _slotShifts[slots[k]] = SimpleTile::entryShift(runEntries[k]);
+            _slotLoading[slots[k]] = true;
+            position += _slotSizes[slots[k]];
+        }
+        TileRequest request = {(uint32_t) offset, tileOffset, end - tileOffset};
+        _requests.push(request);
+        _numLoading++;
+        requested = true;
+        i += runLength;
+    }
+    return requested;
+}
+
+/*
+    Take over the tiles the prefetch task has read. A load covers all slots with data in its part of the arena.
+*/
+void TileBlockRenderer::collectLoads() {
+    TileLoad load;
+    while(_loads.pop(load)) {
+        for(uint16_t i=0; i<_numSlots; i++) {
+            if(!_slotLoading[i] || _slotOffsets[i] < load.arenaOffset || _slotOffsets[i] >= load.arenaOffset + load.size) {
+                continue;
+            }
+            _slotLoading[i] = false;
+            // Draw nothing and retry on the next update
+            if(!load.success) evict(i);
+        }
+        _numLoading--;
+    }
+}
+
+/*
+    Read the requested entry window and all requested tiles. Runs in the prefetch task.
+*/
+void TileBlockRenderer::loadTiles() {
+    if(_entriesState.load(std::memory_order_acquire) == EntriesPending) {
+        bool success = _sd->readTileEntries(*_header, _nextEntriesX0, _nextEntriesY0,
+                                            TILE_ENTRY_WINDOW, TILE_ENTRY_WINDOW, _nextEntries);
+        _entriesState.store(success ? EntriesLoaded : EntriesFailed, std::memory_order_release);
+    }
+    TileRequest request;
+    TileLoad load;
+    while(_requests.pop(request)) {
+        load.arenaOffset = request.arenaOffset;
+        load.size = request.tileSize / sizeof(int16_t);
+        load.success = _sd->readTileData(*_header, request.tileOffset, request.tileSize, _arena + request.arenaOffset);
+        _loads.push(load);
+    }
+}
+
+void TileBlockRenderer::prefetchTask(void* renderer) {
+    TileBlockRenderer* self = (TileBlockRenderer*) renderer;
+    while(true) {
+        xSemaphoreTake(self->_prefetchWake, portMAX_DELAY);
+        self->loadTiles();
+    }
+}
+
+/*
+    Predict the tiles that come into view next: the block around the position PREFETCH_LOOKAHEAD_MS ahead
+    (from heading and the speed since the last prediction) and the next PREFETCH_TRACK_TILES tiles of
+    the GPX track after the run the rider is on.
+*/
+void TileBlockRenderer::predictTiles(LocalGeoPosition& center) {
+    unsigned long t = millis();
+    if(_lastX != INT64_MIN && (t - _tLastPrediction) < PREFETCH_INTERVAL_MS) return;
+
+    _numPrefetch = 0;
+
+    if(_lastX != INT64_MIN && t > _tLastPrediction) {
+        // Speed in mercator units per ms
+        float dx = center.x() - _lastX;
+        float dy = center.y() - _lastY;
+        float ahead = sqrt(dx*dx + dy*dy) / (t - _tLastPrediction) * PREFETCH_LOOKAHEAD_MS;
+        // Heading is clockwise from north
+        int64_t x = center.x() + (int64_t) (ahead * sin(_heading*DEG_TO_RAD));
+        int64_t y = center.y() + (int64_t) (ahead * cos(_heading*DEG_TO_RAD));
+        if(x >= _header->map_x && x < _header->map_x + (int64_t) _header->map_width
+           && y >= _header->map_y && y < _header->map_y + (int64_t) _header->map_height) {
+            LocalGeoPosition predicted(x, y, _header);
+            if(predicted.tileId() != center.tileId()) {
+                predicted.getTileBlock(_prefetchTileIds);
+                _numPrefetch = N_RENDER_TILES;
+            }
+        }
+    }
+    _lastX = center.x();
+    _lastY = center.y();
+    _tLastPrediction = t;
+
+    if(!_hasTrackIn || !_track->numRuns) return;
+    // Run on the center tile, searched forward from the last one so the rider's progress is kept on loops
+    uint32_t run = UINT32_MAX;
+    for(uint32_t i=0; i<_track->numRuns; i++) {
+        uint32_t ridx = (_trackRun + i) % _track->numRuns;
+        if(_track->runs[ridx].tileId == center.tileId()) {
+            run = ridx;
+            break;
+        }
+    }
+    if(run == UINT32_MAX) return;
+    _trackRun = run;
+    uint16_t nTrackTiles = 0;
+    for(uint32_t ridx=run+1; ridx<_track->numRuns && nTrackTiles<PREFETCH_TRACK_TILES; ridx++) {
+        uint64_t tileId = _track->runs[ridx].tileId;
+        bool inView = false;
+        for(uint8_t i=0; i<N_RENDER_TILES; i++) {
+            inView |= _renderTileIds[i] == tileId;
+        }
+        if(inView || (nTrackTiles && _prefetchTileIds[_numPrefetch-1] == tileId)) continue;
+        _prefetchTileIds[_numPrefetch++] = tileId;
+        nTrackTiles++;
+    }
+}
+
+/*
+    Assign a cache slot to every tile of the block around the new center and request the missing tiles
+    from the prefetch task, followed by the predicted tiles. Tiles in view may replace predicted tiles,
+    but not the other way round. Tiles that are still loading are not rendered.
+*/
 void TileBlockRenderer::updateTileBuffer(LocalGeoPosition& center) {
 
-    uint8_t c_curr, r_curr;
-    int8_t idx_curr, idx_old, c_old, r_old;
+    collectLoads();
 
     // Get tile IDs around new center
     center.getTileBlock(_renderTileIds);
 
+    _cacheClock++;
 
-    // Find out in which direction we moved
-
-    // Column shift (number of tiles to the right)
-    int8_t cshift = (center.tileId() % _header->n_x_tiles) - (_prevCenterTileId % _header->n_x_tiles);
-    // Row shift (number of tiles up)
-    int8_t rshift = (center.tileId() / _header->n_x_tiles) - (_prevCenterTileId / _header->n_x_tiles);
-    
-    if(abs(cshift) >= RENDER_TILES_PER_DIM || abs(rshift) >= RENDER_TILES_PER_DIM) {
-        // Complete buffer reload required
+    // If the arena was full of the tiles around the same center, the missing tiles would not fit again.
+    // Nothing is requested until the center moves to another tile.
+    bool full = _arenaFull && _fullCenterTileId == center.tileId();
+    _arenaFull = false;
 
-        // Overwrite complete buffer with zeros
-        memset(_renderTileData, 0, _perTileBufferSize * N_RENDER_TILES);
-        // Load all tiles
-        for(uint8_t i=0; i<N_RENDER_TILES; i++) {
-            _sd->readTile(*_header, _renderTileData + _perTileBufferSize*i, _renderTileSizes[i], _renderTileIds[i]);
+    // Mark cached tiles as used first, so they are not replaced by the tiles that need to be loaded
+    for(uint8_t i=0; i<N_RENDER_TILES; i++) {
+        int32_t slot = slotOf(_renderTileIds[i]);
+        if(slot >= 0) _slotLastUse[slot] = _cacheClock;
+    }
+    bool requested = false;
+    if(updateEntries(center)) {
+        if(_prefetchTask) {
+            requested = true;
+        } else {
+            loadTiles();
+            updateEntries(center);
         }
-    } else {
-        // Some tiles can be reused. Find out which tiles we can keep and which we need to load from SD
-        // Iterate over columns (c) and rows (r) of new block.
-        for(uint8_t c=0; c<RENDER_TILES_PER_DIM; c++) {
-            for(uint8_t r=0; r<RENDER_TILES_PER_DIM; r++) {
-                // Reverse iteration order based on shift direction. 
-                // This avoids writing new data to a tile before copying its data.
-                if(cshift < 0) {
-                    c_curr = RENDER_TILES_PER_DIM - c - 1;
-                } else {
-                    c_curr = c;
-                }
-                if(rshift < 0) {
-                    r_curr = RENDER_TILES_PER_DIM - r - 1;
-                } else {
-                    r_curr = r;
-                }
+    }
+    // Block rows are contiguous in the file, so each row is read at once
+    if(!full) requested |= requestTiles(_renderTileIds, N_RENDER_TILES);
 
-                // Determine index of current tile
-                idx_curr = c_curr+r_curr*RENDER_TILES_PER_DIM;
-
-                // Determine column and row index of current tile in old block
-                c_old = c_curr + cshift;
-                r_old = r_curr + rshift;
-
-                // Check if current tile was in old block
-                if(c_old >= 0 && c_old < RENDER_TILES_PER_DIM && r_old >= 0 && r_old < RENDER_TILES_PER_DIM) {
-                    // Current tile was in old block. We can copy it from the buffer.
-                    // Determine index of tile in old block.
-                    idx_old = c_old+r_old*RENDER_TILES_PER_DIM;
-                    // Copy tile data from old block position to new block position
-                    memcpy(_renderTileData + _perTileBufferSize*idx_curr, _renderTileData + _perTileBufferSize*idx_old, (_perTileBufferSize)*sizeof(int16_t));
-                    // Copy tile size from old block position to new block position
-                    _renderTileSizes[idx_curr] = _renderTileSizes[idx_old];
-                } else {
-                    // Current tile was not in old block. Need to read it from SD.
-                    // Overwrite buffer with zeros
-                    memset(_renderTileData + _perTileBufferSize*idx_curr, 0, _perTileBufferSize*sizeof(int16_t));
-                    // Read new tile.
-                    _sd->readTile(*_header, _renderTileData + _perTileBufferSize*idx_curr, _renderTileSizes[idx_curr], _renderTileIds[idx_curr]);
-                }
-            }
+    predictTiles(center);
+    for(uint16_t i=0; i<_numPrefetch; i++) {
+        int32_t slot = slotOf(_prefetchTileIds[i]);
+        if(slot >= 0) _slotLastUse[slot] = _cacheClock;
+    }
+    if(!full) requested |= requestTiles(_prefetchTileIds, _numPrefetch);
+    if(full || _arenaFull) {
+        _arenaFull = true;
+        _fullCenterTileId = center.tileId();
+    }
+
+    if(requested) {
+        if(_prefetchTask) {
+            xSemaphoreGive(_prefetchWake);
+        } else {
+            loadTiles();
+            collectLoads();
         }
     }
+
+    for(uint8_t i=0; i<N_RENDER_TILES; i++) {
+        int32_t slot = slotOf(_renderTileIds[i]);
+        _renderTileSlots[i] = (slot >= 0 && !_slotLoading[slot]) ? slot : -1;
+    }
 }
 
 /*
@@ -163,8 +569,21 @@ void TileBlockRenderer::render(LocalGeoPosition& center) {
 
     int disp_LL_x, disp_LL_y, disp_UR_x, disp_UR_y;
 
+    int shift, unit;
+
+    ScreenTransform transform;
+
     for(int tidx=0; tidx<N_RENDER_TILES; tidx++) {
 
+        // Tile is still loading
+        if(_renderTileSlots[tidx] < 0) continue;
+        uint16_t slot = _renderTileSlots[tidx];
+        const int16_t* tileData = _tileBase + _slotOffsets[slot];
+
+        // Stored coordinates are in units of 2^shift
+        shift = _slotShifts[slot];
+        unit = 1 << shift;
+
         // Get lower left corner of tile in global (x, y) coordinates
         LocalGeoPosition::getTileLL(_renderTileIds[tidx], _header, &curr_tile_LL_x, &curr_tile_LL_y);
 
@@ -185,45 +604,50 @@ void TileBlockRenderer::render(LocalGeoPosition& center) {
             disp_LL_y = curr_tile_offset_y - DISPLAY_WIDTH_HALF/(_zoomScale);
             disp_UR_y = curr_tile_offset_y + DISPLAY_WIDTH_HALF/(_zoomScale);
         }
+        if(shift) {
+            disp_LL_x >>= shift;
+            disp_LL_y >>= shift;
+            disp_UR_x = (disp_UR_x >> shift) + 1;
+            disp_UR_y = (disp_UR_y >> shift) + 1;
+        }
 
-        uint64_t p = _perTileBufferSize*tidx;
-        uint64_t pEnd = p + _renderTileSizes[tidx];
+        // Translation, zoom and rotation of this tile
+        transform.set(_scaleQ16, _sinHeading, _cosHeading, curr_tile_offset_x, curr_tile_offset_y);
+
+        uint64_t p = 0;
+        uint64_t pEnd = _slotSizes[slot];
+        // The screen position of the current coordinate is known from the previous segment
+        bool transformed = false;
 
         while(p < pEnd) {
 
             // Check if current or next coordinate is a separator, skip otherwise.
-            if((!_renderTileData[p] && !_renderTileData[p+1]) || (!_renderTileData[p+2] && !_renderTileData[p+3])) {
+            if((!tileData[p] && !tileData[p+1]) || (!tileData[p+2] && !tileData[p+3])) {
+                transformed = false;
                 p += 2;
                 continue;
             }
 
-            // Check if current or next coordinate is on display, skip otherwise.
-            if(!isOnDisplay(disp_LL_x, disp_LL_y, disp_UR_x, disp_UR_y, _renderTileData[p], _renderTileData[p+1])
-                && !isOnDisplay(disp_LL_x, disp_LL_y, disp_UR_x, disp_UR_y, _renderTileData[p+2], _renderTileData[p+3])) {
+            // Skip segments that are entirely on one side of the display. Segments that cross the display
+            // with both coordinates outside of it are kept.
+            if(outCode(tileData[p], tileData[p+1], disp_LL_x, disp_LL_y, disp_UR_x, disp_UR_y)
+               & outCode(tileData[p+2], tileData[p+3], disp_LL_x, disp_LL_y, disp_UR_x, disp_UR_y)) {
+                transformed = false;
                 p += 2;
                 continue;
             }
 
-            // Calculate non-rotated position on screen.
-            x0 = DISPLAY_WIDTH_HALF + (_renderTileData[p] - curr_tile_offset_x) * _zoomScale;
-            y0 = DISPLAY_WIDTH_HALF - (_renderTileData[p+1] - curr_tile_offset_y) * _zoomScale;
-            x1 = DISPLAY_WIDTH_HALF + (_renderTileData[p+2] - curr_tile_offset_x) * _zoomScale;
-            y1 = DISPLAY_WIDTH_HALF - (_renderTileData[p+3] - curr_tile_offset_y) * _zoomScale;
-
-            // Calculate rotated position on screen.
-            if(_heading != 0) {
-                rotatePointInplaceAroundScreenCenter(x0, y0, _rotMtxBuf);
-                rotatePointInplaceAroundScreenCenter(x1, y1, _rotMtxBuf);
+            // Position on screen. Every coordinate of a way is transformed once.
+            if(!transformed) {
+                transform.apply(tileData[p]*unit, tileData[p+1]*unit, x0, y0);
             }
+            transform.apply(tileData[p+2]*unit, tileData[p+3]*unit, x1, y1);
 
-            _display->draw_line(
-                x0,
-                y0,
-                x1,
-                y1,
-                2, BLACK
-            );
+            drawSegment(x0, y0, x1, y1, 2);
 
+            x0 = x1;
+            y0 = y1;
+            transformed = true;
             p += 2;
         }
 
@@ -236,55 +660,62 @@ void TileBlockRenderer::render(LocalGeoPosition& center) {
 
 
 /*
-    Render GPX track
+    Render GPX track (or any other track, e.g. a route back to the track) with the given line width
 */
-void TileBlockRenderer::renderGPX(LocalGeoPosition& center) {
-    if(!_hasTrackIn) return;
-    // TODO: this is horrible
+void TileBlockRenderer::renderGPX(LocalGeoPosition& center, GPXTrack* track, uint8_t width) {
 
     long t_start = millis();
 
-    int x0, y0, x1, y1;
-
-    int curr_tile_offset_x, curr_tile_offset_y, next_tile_offset_x, next_tile_offset_y;
-    int64_t curr_tile_LL_x, curr_tile_LL_y, next_tile_LL_x, next_tile_LL_y;
-
-    for(int tidx=0; tidx<N_RENDER_TILES; tidx++) {
-        for(uint32_t nidx=0; nidx<(_track->numNodes - 1); nidx++) {
-            if(_renderTileIds[tidx] == _track->tileIdList[nidx]) {
-                // Found GPX waypoint on current tile.
-                // Get lower left corner of tile in global (x, y) coordinates
-                LocalGeoPosition::getTileLL(_track->tileIdList[nidx], _header, &curr_tile_LL_x, &curr_tile_LL_y);
-                LocalGeoPosition::getTileLL(_track->tileIdList[nidx+1], _header, &next_tile_LL_x, &next_tile_LL_y);
-
-                // Current position relative to current tile.
-                curr_tile_offset_x = center.x() - curr_tile_LL_x;
-                curr_tile_offset_y = center.y() - curr_tile_LL_y;
-                next_tile_offset_x = center.x() - next_tile_LL_x;
-                next_tile_offset_y = center.y() - next_tile_LL_y;
-
-                // Calculate non-rotated position on screen.
-                x0 = DISPLAY_WIDTH_HALF + (_track->xList[nidx] - curr_tile_offset_x) * _zoomScale;
-                y0 = DISPLAY_WIDTH_HALF - (_track->yList[nidx] - curr_tile_offset_y) * _zoomScale;
-                x1 = DISPLAY_WIDTH_HALF + (_track->xList[nidx+1] - next_tile_offset_x) * _zoomScale;
-                y1 = DISPLAY_WIDTH_HALF - (_track->yList[nidx+1] - next_tile_offset_y) * _zoomScale;
-
-                // Calculate rotated position on screen.
-                if(_heading != 0) {
-                    rotatePointInplaceAroundScreenCenter(x0, y0, _rotMtxBuf);
-                    rotatePointInplaceAroundScreenCenter(x1, y1, _rotMtxBuf);
+    int x0 = 0, y0 = 0, x1, y1;
+    // Points relative to the current position, in mercator units
+    int rel_x0 = 0, rel_y0 = 0, rel_x1, rel_y1;
+    uint8_t code0 = 0, code1;
+
+    int64_t tile_LL_x, tile_LL_y;
+    int tile_offset_x, tile_offset_y;
+
+    // Half of the display in mercator units, large enough for any heading
+    int viewRadius = DISPLAY_MAX_DIM/(_zoomScale) + 1;
+
+    ScreenTransform transform;
+    transform.set(_scaleQ16, _sinHeading, _cosHeading, 0, 0);
+
+    // Every segment is culled against the display on its own instead of by the tile of its run: simplified tracks
+    // and routes have segments across several tiles, which can cross the display with both points on tiles
+    // that are not in view.
+    bool transformed = false;
+    for(uint32_t ridx=0; ridx<track->numRuns; ridx++) {
+        LocalGeoPosition::getTileLL(track->runs[ridx].tileId, _header, &tile_LL_x, &tile_LL_y);
+        // Origin of the tile relative to the current position
+        tile_offset_x = tile_LL_x - center.x();
+        tile_offset_y = tile_LL_y - center.y();
+
+        uint32_t runEnd = track->runEnd(ridx);
+        for(uint32_t nidx=track->runs[ridx].firstPoint; nidx<runEnd; nidx++) {
+            rel_x1 = tile_offset_x + track->points[2*nidx];
+            rel_y1 = tile_offset_y + track->points[2*nidx+1];
+            code1 = outCode(rel_x1, rel_y1, -viewRadius, -viewRadius, viewRadius, viewRadius);
+
+            if(nidx && !(code0 & code1)) {
+                // Position on screen. Every point of consecutive segments in view is transformed once.
+                if(!transformed) {
+                    transform.apply(rel_x0, rel_y0, x0, y0);
                 }
+                transform.apply(rel_x1, rel_y1, x1, y1);
 
-                _display->draw_line(
-                    x0,
-                    y0,
-                    x1,
-                    y1,
-                    6, BLACK
-                );
+                drawSegment(x0, y0, x1, y1, width);
+
+                x0 = x1;
+                y0 = y1;
+                transformed = true;
+            } else {
+                transformed = false;
             }
-        }
 
+            rel_x0 = rel_x1;
+            rel_y0 = rel_y1;
+            code0 = code1;
+        }
     }
 
     long t_end = millis() - t_start;
@@ -298,11 +729,14 @@ void TileBlockRenderer::renderGPX(LocalGeoPosition& center) {
 
 
 /*
-    Determine if point is on display.
-    All coordinates are given in current tile coordinates.
+    Draw a segment in screen coordinates, clipped to the map above the status bar. The viewport is extended
+    by the largest offset of a thick line (see SharedSPIDisplay::draw_line), so lines along its border keep their width,
+    and Bresenham never walks the pixels of a long segment that are off the display.
 */
-bool TileBlockRenderer::isOnDisplay(int disp_LL_x, int disp_LL_y, int disp_UR_x, int disp_UR_y, int16_t x0, int16_t y0) {
-    return (disp_LL_x <= x0) && (x0 <= disp_UR_x) && (disp_LL_y <= y0) && (y0 <= disp_UR_y);
+void TileBlockRenderer::drawSegment(int x0, int y0, int x1, int y1, uint8_t width) {
+    const int margin = 3;
+    if(!clipLine(x0, y0, x1, y1, -margin, -margin, DISPLAY_WIDTH - 1 + margin, DISPLAY_WIDTH - 1 + margin)) return;
+    _display->draw_line(x0, y0, x1, y1, width, BLACK);
 }
 
 bool TileBlockRenderer::step(bool holdOn) {
@@ -320,20 +754,18 @@ bool TileBlockRenderer::step(bool holdOn) {
     }
 
     _heading = _positionProvider->getHeading();
-    rad2rotMtx(_rotMtxBuf, (360-_heading)*DEG_TO_RAD);
+    _sinHeading = sinQ16(_heading);
+    _cosHeading = cosQ16(_heading);
 
     // Get current position and tileID
     LocalGeoPosition center(globcenter, _header);
-    _centerTileId = center.getTileID();
-    // If we changed tile and are over the debounce time, we need to update the tilebuffer
-    if(_centerTileId != _prevCenterTileId && (millis() - _prevTileUpdateTime) > TILE_UPDATE_DEBOUNCE_MS) {
-        updateTileBuffer(center);
-        _prevCenterTileId = _centerTileId;
-        _prevTileUpdateTime = millis();
-    }
+    // Cheap for cached tiles, so the block follows the center on every frame
+    updateTileBuffer(center);
 
     render(center);
-    if(_hasTrackIn) renderGPX(center);
+    if(_hasTrackIn) renderGPX(center, _track, 6);
+    // Route back to the track, drawn thinner than the track itself
+    if(_reroute && _reroute->numNodes) renderGPX(center, _reroute, 3);
     _display->drawCenterMarker();
     if(!holdOn) {
         _display->refresh();
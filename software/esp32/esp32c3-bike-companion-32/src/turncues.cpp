@@ -0,0 +1,139 @@
+#include <turncues.h>
+#include <serialutils.h>
+#include <globalconfig.h>
+
+TurnCues::TurnCues()
+    : _ready(false), _onTrack(false), _next(0), _run(0), _cue(0), _along(0), _distance(0), _tLastResync(0) {
+}
+
+bool TurnCues::initialize(SimpleTile::Header* header, GPXTrack* track) {
+    _header = header;
+    _track = track;
+    if(!_track->numCues || _track->numNodes < 2) {
+        sout.info() <= "Track has no turn cues.";
+        return false;
+    }
+    seek(0);
+    _ready = true;
+    return true;
+}
+
+/*
+    Global coordinates of a point. The run of the point is searched from the current run, which is cheap
+    since points are requested in order.
+*/
+void TurnCues::point(uint32_t pointId, int64_t* x, int64_t* y) {
+    while(_run + 1 < _track->numRuns && _track->runs[_run + 1].firstPoint <= pointId) _run++;
+    while(_run > 0 && _track->runs[_run].firstPoint > pointId) _run--;
+    LocalGeoPosition::getTileLL(_track->runs[_run].tileId, _header, x, y);
+    *x += _track->points[2*pointId];
+    *y += _track->points[2*pointId + 1];
+}
+
+// Length of a segment in meters, scaled at its start like in gpx2simpletrack
+float TurnCues::segmentLength(int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+    return sqrt((float) ((x1 - x0)*(x1 - x0) + (y1 - y0)*(y1 - y0))) / cosh(y0 / R_EARTH);
+}
+
+/*
+    Moves the pointer to a track point. The distance along the track is summed up from the first point.
+*/
+void TurnCues::seek(uint32_t pointId) {
+    _run = 0;
+    _along = 0;
+    point(0, &_nextX, &_nextY);
+    _prevX = _nextX;
+    _prevY = _nextY;
+    for(_next=0; _next<pointId; _next++) {
+        _prevX = _nextX;
+        _prevY = _nextY;
+        point(_next + 1, &_nextX, &_nextY);
+        _along += segmentLength(_prevX, _prevY, _nextX, _nextY);
+    }
+    _cue = 0;
+}
+
+void TurnCues::resync(GeoPosition& pos) {
+    _tLastResync = millis();
+    uint32_t nearest = 0;
+    float best = -1;
+    int64_t x, y;
+    _run = 0;
+    for(uint32_t p=0; p<_track->numNodes; p++) {
+        point(p, &x, &y);
+        float dx = x - pos.x();
+        float dy = y - pos.y();
+        float d = dx*dx + dy*dy;
+        if(best < 0 || d < best) {
+            best = d;
+            nearest = p;
+        }
+    }
+    seek(nearest);
+}
+
+void TurnCues::step(GeoPosition& pos) {
+    if(!_ready) return;
+
+    // Advance the pointer while the rider passed the next point, i.e. is beyond it on the incoming segment
+    for(uint8_t i=0; i<TURN_MAX_ADVANCE && _next + 1 < _track->numNodes; i++) {
+        int64_t dx, dy;
+        if(_next) {
+            dx = _nextX - _prevX;
+            dy = _nextY - _prevY;
+        } else {
+            // The first point has no incoming segment, it is passed as soon as the rider is in front of it
+            point(1, &dx, &dy);
+            dx -= _nextX;
+            dy -= _nextY;
+        }
+        if((pos.x() - _nextX)*dx + (pos.y() - _nextY)*dy <= 0) break;
+        _prevX = _nextX;
+        _prevY = _nextY;
+        _next++;
+        point(_next, &_nextX, &_nextY);
+        _along += segmentLength(_prevX, _prevY, _nextX, _nextY);
+    }
+
+    // Projection of the rider onto the segment ending at the next point
+    float remaining, offTrack;
+    project(pos, remaining, offTrack);
+    if(offTrack > TURN_MAX_TRACK_DISTANCE && millis() - _tLastResync > TURN_RESYNC_INTERVAL_MS) {
+        resync(pos);
+        project(pos, remaining, offTrack);
+    }
+    _onTrack = offTrack <= TURN_MAX_TRACK_DISTANCE;
+    if(!_onTrack) return;
+
+    float along = _along - remaining;
+    while(_cue < _track->numCues && _track->cues[_cue].distance < along) _cue++;
+    if(_cue < _track->numCues) _distance = _track->cues[_cue].distance - along;
+}
+
+/*
+    Projects the rider onto the segment ending at the next point. Returns the distance from the projection
+    to the next point and the distance of the rider to the segment in meters.
+*/
+void TurnCues::project(GeoPosition& pos, float& remaining, float& offTrack) {
+    float dx = _nextX - _prevX;
+    float dy = _nextY - _prevY;
+    float len2 = dx*dx + dy*dy;
+    float t = len2 > 0 ? ((pos.x() - _prevX)*dx + (pos.y() - _prevY)*dy) / len2 : 1;
+    t = t < 0 ? 0 : (t > 1 ? 1 : t);
+    int64_t px = _prevX + (int64_t) (t*dx);
+    int64_t py = _prevY + (int64_t) (t*dy);
+    remaining = segmentLength(px, py, _nextX, _nextY);
+    offTrack = segmentLength(pos.x(), pos.y(), px, py);
+}
+
+bool TurnCues::hasNext() {
+    return _ready && _onTrack && _cue < _track->numCues;
+}
+
+TrackCue* TurnCues::next() {
+    return _track->cues + _cue;
+}
+
+uint32_t TurnCues::distanceToNext() {
+    return _distance;
+}
@@ -4,7 +4,7 @@
 #include <Arduino.h>
 
 UIRenderer::UIRenderer() :
-    _currentScreen(&BOOTSCREEN), _hasGNSS(false), _hasHeader(false), _hasPositionProvider(false) {
+    _hasGNSS(false), _hasPositionProvider(false), _hasHeader(false), _hasTurnCues(false), _currentScreen(&BOOTSCREEN) {
 
     _leftStat = (StatusBarElement) LEFT_STAT;
     _rightStat = (StatusBarElement) RIGHT_STAT;
@@ -14,9 +14,9 @@ UIRenderer::UIRenderer() :
 
 }
 
-bool UIRenderer::initializeMap(SharedSPISDCard* sd) {
+bool UIRenderer::initializeMap(SharedSPISDCard* sd, FlashMap* flashMap) {
     if(_hasHeader) {
-        if(!_mapRenderer.initialize(_header, sd, _disp)) {
+        if(!_mapRenderer.initialize(_header, sd, _disp, flashMap)) {
             return false;
         }
         if(_hasPositionProvider) {
@@ -55,6 +55,15 @@ void UIRenderer::setGPXTrackIn(GPXTrack* track) {
     _mapRenderer.setGPXTrackIn(_track);
 };
 
+void UIRenderer::setReroute(GPXTrack* route) {
+    _mapRenderer.setReroute(route);
+};
+
+void UIRenderer::setTurnCues(TurnCues* turnCues) {
+    _turnCues = turnCues;
+    _hasTurnCues = true;
+};
+
 void UIRenderer::setScreen(Screen* newScreen) {
     _currentScreen = newScreen;
 }
@@ -91,8 +100,9 @@ bool UIRenderer::step() {
 
     // Check if we need to wait before next render loop to achieve desired FPS.
     _tLoopRender = millis() - _tLastRender;
+    // Unlike delayMicroseconds, delay blocks the task, so the prefetch task can read tiles meanwhile.
     if(_tLoopRender < TARGET_FRAME_TIME_MS) {
-        delayMicroseconds((TARGET_FRAME_TIME_MS - _tLoopRender)*1000);
+        ::delay(TARGET_FRAME_TIME_MS - _tLoopRender);
     }
     _tLastRender = millis();
 
@@ -102,7 +112,7 @@ bool UIRenderer::step() {
 void UIRenderer::renderStatusBar() {
 
     // Render left status
-    if(_leftStat == speed || _leftStat == heading || _leftStat == lat || _leftStat == lon) {
+    if(_leftStat == speed || _leftStat == heading || _leftStat == lat || _leftStat == lon || _leftStat == turn) {
         // Requires position provider
         if(!_hasPositionProvider) {
             renderStat(err, _textBuffer, true);
@@ -119,7 +129,7 @@ void UIRenderer::renderStatusBar() {
     }
 
     // Render right status
-    if(_rightStat == speed || _rightStat == heading || _rightStat == lat || _rightStat == lon) {
+    if(_rightStat == speed || _rightStat == heading || _rightStat == lat || _rightStat == lon || _rightStat == turn) {
         // Requires position provider
         if(!_hasPositionProvider) {
             renderStat(err, _textBuffer + N_CHAR_PER_STAT);
@@ -159,6 +169,25 @@ void UIRenderer::renderStat(StatusBarElement ele, char* textBuff, bool removeTer
         // sprintf(textBuff, "%04.0f", (float) 541.653);
         break;
 
+    case turn:
+        // Direction (l/r slight, L/R normal, </> sharp, U u-turn) and distance of the next turn
+        if(_hasTurnCues && _turnCues->hasNext()) {
+            int8_t cue = _turnCues->next()->turn;
+            int cls = abs(cue);
+            if(cls > TURN_UTURN) cls = TURN_UTURN;
+            char symbol = (cue < 0 ? " lL<U" : " rR>U")[cls];
+            uint32_t distance = _turnCues->distanceToNext();
+            if(distance < 1000) {
+                n_print_chars = snprintf(textBuff, N_CHAR_PER_STAT, "%c%4u", symbol, (unsigned int) distance);
+            } else if(distance < 10000) {
+                n_print_chars = snprintf(textBuff, N_CHAR_PER_STAT, "%c%.1fk", symbol, distance / 1000.0);
+            } else {
+                n_print_chars = snprintf(textBuff, N_CHAR_PER_STAT, "%c%3uk", symbol, (unsigned int) (distance / 1000));
+            }
+            break;
+        }
+        // Falls through - the heading is shown if there is no turn ahead
+
     case heading:
         // sout <= "Printing heading";
         n_print_chars = snprintf(textBuff, N_CHAR_PER_STAT, "HE%03i", _posProvider->getHeading());
@@ -3,33 +3,23 @@
 #include <SD.h>
 #include <SPI.h>
 
-struct Header
-{
-  uint64_t map_x;
-  uint64_t map_y;
-  uint64_t map_width;
-  uint64_t map_height;
-  uint64_t n_x_tiles;
-  uint64_t tile_size;
-  uint64_t n_tiles;
-  uint64_t max_nodes;
-  uint64_t n_nodes;
-  uint64_t n_ways;
-
-  void print() {
-    Serial.printf("map_X: %i\n", map_x);
-    Serial.printf("map_Y: %i\n", map_y);
-    Serial.printf("map_width: %i\n", map_width);
-    Serial.printf("map_height: %i\n", map_height);
-    Serial.printf("n_x_tiles: %i\n", n_x_tiles);
-    Serial.printf("tile_size: %i\n", tile_size);
-    Serial.printf("n_tiles: %i\n", n_tiles);
-    Serial.printf("max_nodes: %i\n", max_nodes);
-    Serial.printf("n_nodes: %i\n", n_nodes);
-    Serial.printf("n_ways: %i\n", n_ways);
-  }
-
-};
+#include <simpletileformat.h>
+
+// Map header and file layout shared with the converter and the firmware
+typedef SimpleTileFormat::MapHeader Header;
+
+void printHeader(Header& header) {
+  Serial.printf("map_X: %i\n", header.map_x);
+  Serial.printf("map_Y: %i\n", header.map_y);
+  Serial.printf("map_width: %i\n", header.map_width);
+  Serial.printf("map_height: %i\n", header.map_height);
+  Serial.printf("n_x_tiles: %i\n", header.n_x_tiles);
+  Serial.printf("tile_size: %i\n", header.tile_size);
+  Serial.printf("n_tiles: %i\n", header.n_tiles);
+  Serial.printf("max_nodes: %i\n", header.max_nodes);
+  Serial.printf("n_nodes: %i\n", header.n_nodes);
+  Serial.printf("n_ways: %i\n", header.n_ways);
+}
 
 
 // Selector pin for SPI of SD-Card reader
@@ -87,20 +77,9 @@ void listDir(fs::FS &fs, const char * dirname, uint8_t levels){
 }
 
 void readHeader(fs::File &file, Header& header) {
-  
-  if(file.available()) {
-    file.readBytes((char*) &(header.map_x), 8);
-    file.readBytes((char*) &(header.map_y), 8);
-    file.readBytes((char*) &(header.map_width), 8);
-    file.readBytes((char*) &(header.map_height), 8);
-    file.readBytes((char*) &(header.n_x_tiles), 8);
-    file.readBytes((char*) &(header.tile_size), 8);
-    file.readBytes((char*) &(header.n_tiles), 8);
-    file.readBytes((char*) &(header.max_nodes), 8);
-    file.readBytes((char*) &(header.n_nodes), 8);
-    file.readBytes((char*) &(header.n_ways), 8);
-  }
-
+  // Only maps of version 1 are used for this test
+  file.seek(0);
+  file.read((uint8_t*) &header, sizeof(Header));
 }
 
 void readTile(fs::File &file, Header& header, uint16_t* tile_node_buffer, int tile_id) {
@@ -108,19 +87,19 @@ void readTile(fs::File &file, Header& header, uint16_t* tile_node_buffer, int ti
   uint64_t ptr_tile, ptr_next_tile, tile_size;
 
   // Move reader to tile pointer
-  file.seek(sizeof(uint64_t)*(10 + tile_id));
+  file.seek(SimpleTileFormat::entriesOffset(1, 0, header.n_tiles) + sizeof(uint64_t)*tile_id);
   // Read tile pointer
   file.readBytes((char *) &ptr_tile, sizeof(uint64_t));
   // Read next tile pointer (if it is not the last tile)
-  if(tile_id < header.n_tiles) {
+  if(tile_id + 1 < header.n_tiles) {
     file.readBytes((char *) &ptr_next_tile, sizeof(uint64_t));
   } else {
-    ptr_next_tile = file.size();
+    ptr_next_tile = file.size() - SimpleTileFormat::dataOffset(1, 0, header.n_tiles);
   }
   tile_size = ptr_next_tile - ptr_tile;
 
   // Move reader to start of tile
-  file.seek(sizeof(uint64_t)*(10 + header.n_tiles) + ptr_tile);
+  file.seek(SimpleTileFormat::dataOffset(1, 0, header.n_tiles) + ptr_tile);
   // Read tile
   file.readBytes((char *) tile_node_buffer, tile_size);
 
@@ -166,7 +145,7 @@ void setup(){
 
   // Read map header and print map statistics
   readHeader(file, header);
-  header.print();
+  printHeader(header);
 
   Serial.println("Allocating memory for tile node buffer...");
   tile_node_buffer = new uint16_t[header.max_nodes*2];
@@ -207,8 +207,17 @@ def get_tileid_from_merc(merc_coords, header):
     return n_x_tiles*math.floor(merc_coords[0][1] / tile_size) + math.floor(merc_coords[0][0] / tile_size)
 
 
+'''
+    Magic number at the start of map files with version 2 and flag for sparse maps.
+    See software/cpp/include/MapFile.hpp for the layout.
+'''
+map_magic_v2 = 0x0000000250414d53
+map_flag_sparse = 1
+
+
 '''
     Read header of map which includes statistics like how many tiles are present in the file.
+    For maps of version 2, the header also contains the file layout (index, entries and data offsets).
 '''
 def read_header(binary_path):
     # Parse header
@@ -226,15 +235,57 @@ def read_header(binary_path):
     header_keys = ["map_x", "map_y", "map_width", "map_height", "n_x_tiles", "tile_size", "n_tiles",
                 "max_tile_nodes", "total_tile_nodes", "ways"]
     with open(binary_path, "rb") as f:
+        # Version 2 starts with a magic number
+        header["version"] = 1
+        if int.from_bytes(f.read(8), byteorder='little', signed=False) == map_magic_v2:
+            header["version"] = 2
+        else:
+            f.seek(0)
         # Parse header
         for i in range(10):
             bytes_read = f.read(8)
             is_signed = header_keys[i] in ["map_x", "map_y"]
             header[header_keys[i]] = int.from_bytes(bytes_read, byteorder='little', signed=is_signed)
 
+        if header["version"] == 2:
+            header["flags"] = int.from_bytes(f.read(8), byteorder='little', signed=False)
+            header["n_entries"] = int.from_bytes(f.read(8), byteorder='little', signed=False)
+            header["index_offset"] = 13*8
+            index_bytes = ((header["n_entries"]*4 + 7) // 8) * 8 if header["flags"] & map_flag_sparse else 0
+            header["entries_offset"] = header["index_offset"] + index_bytes
+            header["data_offset"] = header["entries_offset"] + header["n_entries"]*8
+        else:
+            header["flags"] = 0
+            header["n_entries"] = header["n_tiles"]
+            header["entries_offset"] = 10*8
+            header["data_offset"] = 10*8 + header["n_tiles"]*8
+
     return header
 
 
+'''
+    Get start, end and quantization shift of a tile in a map file of version 2. Returns None if the tile is not stored.
+'''
+def get_tile_range_v2(f, tile_idx, header):
+    entry_idx = tile_idx
+    if header["flags"] & map_flag_sparse:
+        # Binary search in sorted index of stored tile IDs
+        f.seek(header["index_offset"])
+        index = np.frombuffer(f.read(header["n_entries"]*4), dtype='<u4')
+        entry_idx = int(np.searchsorted(index, tile_idx))
+        if entry_idx >= len(index) or index[entry_idx] != tile_idx:
+            return None
+    elif tile_idx >= header["n_entries"]:
+        return None
+    f.seek(header["entries_offset"] + entry_idx*8)
+    entry = int.from_bytes(f.read(8), byteorder='little', signed=False)
+    tile_start = header["data_offset"] + ((entry & 0xFFFFFFFFFF) << 2)
+    tile_end = tile_start + (((entry >> 40) & 0xFFFFF) << 2)
+    # Local coordinates are stored in units of 2^shift
+    tile_shift = entry >> 60
+    return tile_start, tile_end, tile_shift
+
+
 '''
     Read data for tile with index tile_idx from a binary file
 '''
@@ -247,19 +298,27 @@ def read_tile(tile_idx, header, binary_path):
     offset = 10*8 + header["n_tiles"]*8
     
     tile = {}
+    tile_shift = 0
     
     with open(binary_path, "rb") as f:
-        # Read tile pointer
-        f.seek(tile_ptr_offset)
-        # Get pointer to start of tile data for current tile
-        tile_start = int.from_bytes(f.read(8), byteorder='little', signed=False) + offset
-        # Check if it is the last tile.
-        if tile_idx == header["n_tiles"]-1:
-            # Tile is the last tile. End of tile data is end of file.
-            tile_end = f_size
+        if header.get("version", 1) == 2:
+            tile_range = get_tile_range_v2(f, tile_idx, header)
+            # Tiles that are not stored are empty
+            if tile_range is None:
+                return tile
+            tile_start, tile_end, tile_shift = tile_range
         else:
-            # Get pointer to start of tile data for next tile
-            tile_end = int.from_bytes(f.read(8), byteorder='little', signed=False) + offset
+            # Read tile pointer
+            f.seek(tile_ptr_offset)
+            # Get pointer to start of tile data for current tile
+            tile_start = int.from_bytes(f.read(8), byteorder='little', signed=False) + offset
+            # Check if it is the last tile.
+            if tile_idx == header["n_tiles"]-1:
+                # Tile is the last tile. End of tile data is end of file.
+                tile_end = f_size
+            else:
+                # Get pointer to start of tile data for next tile
+                tile_end = int.from_bytes(f.read(8), byteorder='little', signed=False) + offset
         # Calculate tile size and number of coordinates in tile (including separators)
         tile_size = tile_end - tile_start
         n_coords = tile_size // 4
@@ -291,46 +350,148 @@ def read_tile(tile_idx, header, binary_path):
 
             else:
                 # Append coordinate to current way
-                curr_way.append(curr_coord)
+                curr_way.append([curr_coord[0] << tile_shift, curr_coord[1] << tile_shift])
     return tile
 
 
 
+'''
+    Get offset, size and quantization shift of every stored tile. The tile table is read through a memory map,
+    so this works for maps of any size. Returns (tile_ids, offsets, sizes, shifts) as arrays, offsets and sizes
+    in bytes relative to the start of the tile data.
+'''
+def read_tile_table(binary_path, header):
+    mm = np.memmap(binary_path, dtype=np.uint8, mode='r')
+    data_bytes = len(mm) - header["data_offset"]
+    table = mm[header["entries_offset"]:header["data_offset"]].view('<u8')
+    if header["version"] == 2:
+        if header["flags"] & map_flag_sparse:
+            index_bytes = header["n_entries"]*4
+            tile_ids = mm[header["index_offset"]:header["index_offset"] + index_bytes].view('<u4').astype(np.int64)
+        else:
+            tile_ids = np.arange(header["n_entries"], dtype=np.int64)
+        offsets = ((table & 0xFFFFFFFFFF) << 2).astype(np.int64)
+        sizes = (((table >> 40) & 0xFFFFF) << 2).astype(np.int64)
+        shifts = (table >> 60).astype(np.int64)
+    else:
+        tile_ids = np.arange(header["n_tiles"], dtype=np.int64)
+        offsets = table.astype(np.int64)
+        sizes = np.diff(np.append(offsets, data_bytes))
+        shifts = np.zeros(header["n_tiles"], dtype=np.int64)
+    return tile_ids, offsets, sizes, shifts
+
+
+'''
+    Vectorized reader for a complete map (or the tiles given by tile_idx_list). The file is memory mapped and all
+    tile payloads are decoded at once into flat arrays with one element per node (separators are dropped):
+        tile_id         ID of the tile the node is stored on
+        polyline_id     consecutive number of the way on its tile, unique within the returned arrays
+        x, y            global mercator coordinates (or local tile coordinates if local=True)
+    A way that crosses several tiles is stored once per tile and thus has several polyline IDs.
+'''
+def read_map(binary_path, header=None, tile_idx_list=None, local=False):
+    if header is None:
+        header = read_header(binary_path)
+    tile_ids, offsets, sizes, shifts = read_tile_table(binary_path, header)
+    if tile_idx_list is not None:
+        selected = np.isin(tile_ids, np.asarray(tile_idx_list, dtype=np.int64))
+        tile_ids, offsets, sizes, shifts = tile_ids[selected], offsets[selected], sizes[selected], shifts[selected]
+    selected = sizes > 0
+    tile_ids, offsets, sizes, shifts = tile_ids[selected], offsets[selected], sizes[selected], shifts[selected]
+
+    # All coordinate pairs of the tile data, without copying
+    mm = np.memmap(binary_path, dtype=np.uint8, mode='r')
+    n_data_pairs = (len(mm) - header["data_offset"]) // 4
+    pairs = mm[header["data_offset"]:header["data_offset"] + 4*n_data_pairs].view('<i2').reshape(-1, 2)
+
+    # Index of every pair of the selected tiles. Tiles are contiguous, so the index is a running count
+    # that jumps to the start of the next tile.
+    counts = sizes // 4
+    n_pairs = int(counts.sum())
+    tile_start = np.zeros(n_pairs, dtype=bool)
+    if n_pairs:
+        first = np.concatenate(([0], np.cumsum(counts)[:-1]))
+        tile_start[first] = True
+        pair_idx = np.arange(n_pairs, dtype=np.int64) + np.repeat(offsets // 4 - first, counts)
+    else:
+        pair_idx = np.zeros(0, dtype=np.int64)
+    coords = pairs[pair_idx].astype(np.int64)
+
+    # Ways start after a separator or at the start of a tile
+    separator = (coords[:, 0] == 0) & (coords[:, 1] == 0)
+    previous_separator = np.concatenate(([True], separator[:-1])) | tile_start
+    node = ~separator
+    polyline_id = np.cumsum(node & previous_separator) - 1
+
+    pair_tile = np.repeat(tile_ids, counts)
+    pair_shift = np.repeat(shifts, counts)
+    x = coords[:, 0] << pair_shift
+    y = coords[:, 1] << pair_shift
+    if not local:
+        x += header["map_x"] + (pair_tile % header["n_x_tiles"]) * header["tile_size"]
+        y += header["map_y"] + (pair_tile // header["n_x_tiles"]) * header["tile_size"]
+
+    return {
+        "tile_id": pair_tile[node],
+        "polyline_id": polyline_id[node],
+        "x": x[node],
+        "y": y[node],
+    }
+
+
+'''
+    Converts the flat arrays of read_map into coordinates for a single plot call. Ways are separated by NaN.
+'''
+def polylines_with_breaks(map_data):
+    breaks = np.flatnonzero(np.diff(map_data["polyline_id"])) + 1
+    x = np.insert(map_data["x"].astype(float), breaks, np.nan)
+    y = np.insert(map_data["y"].astype(float), breaks, np.nan)
+    return x, y
+
+
+'''
+    Number of nodes per cell of a grid with the given cell size in mercator units, e.g. to find dense regions
+    that determine max_nodes. Returns the counts and the extent [x_min, x_max, y_min, y_max] for imshow.
+'''
+def node_density(map_data, cell_size):
+    x, y = map_data["x"], map_data["y"]
+    if not len(x):
+        return np.zeros((0, 0), dtype=np.int64), [0, 0, 0, 0]
+    x_min, y_min = x.min(), y.min()
+    cx = (x - x_min) // cell_size
+    cy = (y - y_min) // cell_size
+    nx, ny = int(cx.max()) + 1, int(cy.max()) + 1
+    counts = np.bincount(cy*nx + cx, minlength=nx*ny).reshape(ny, nx)
+    return counts, [x_min, x_min + nx*cell_size, y_min, y_min + ny*cell_size]
+
+
 '''
     Plot tiles given by a tile index list in a given plot object
 '''
 def plot_tiles(ax, tile_idx_list, header, bin_file_path):
 
-    ll_plot = np.array([1e10, 1e10])
-    ur_plot = np.array([-1e10, -1e10])
-    # 1. Get the tiles.
-    tile_list = [read_tile(idx, header, bin_file_path) for idx in tile_idx_list]
-
-    map_origin = np.array([[header["map_x"], header["map_y"]]])
-
-    # 2. Plot ways of each tile.
-    for tile, tile_idx in zip(tile_list, tile_idx_list):
-        # Plot tile outline
-        ll = get_tile_ll(tile_idx, header["tile_size"], header["n_x_tiles"], map_origin)
-        for hw_id in tile.keys():
-            tile[hw_id] += ll
-        ur = ll + np.array([[header["tile_size"], header["tile_size"]]])
-        if ll_plot[0] > ll[0, 0]:
-            ll_plot[0] = ll[0, 0]
-        if ll_plot[1] > ll[0, 1]:
-            ll_plot[1] = ll[0, 1]
-        if ur_plot[0] < ur[0, 0]:
-            ur_plot[0] = ur[0, 0]
-        if ur_plot[1] < ur[0, 1]:
-            ur_plot[1] = ur[0, 1]
+    tile_idx_list = np.asarray(tile_idx_list, dtype=np.int64)
+    if not len(tile_idx_list):
+        return
+    # 1. Get the nodes of all tiles at once.
+    map_data = read_map(bin_file_path, header, tile_idx_list)
+
+    # 2. Plot tile outlines.
+    tile_size = header["tile_size"]
+    ll_x = header["map_x"] + (tile_idx_list % header["n_x_tiles"]) * tile_size
+    ll_y = header["map_y"] + (tile_idx_list // header["n_x_tiles"]) * tile_size
+    for x, y in zip(ll_x, ll_y):
         ax.add_patch(
-            Rectangle((ll[0, 0], ll[0, 1]), header["tile_size"], header["tile_size"], 
+            Rectangle((x, y), tile_size, tile_size,
                 edgecolor = 'grey',
                 fill=False)
         )
+    ll_plot = np.array([ll_x.min(), ll_y.min()])
+    ur_plot = np.array([ll_x.max() + tile_size, ll_y.max() + tile_size])
 
-        for hw in tile.values():
-            ax.plot(hw[:, 0], hw[:, 1], color='red')
+    # 3. Plot all ways with a single call.
+    x, y = polylines_with_breaks(map_data)
+    ax.plot(x, y, color='red')
     
     ax.set_aspect('equal', adjustable='box')
     ax.set_xlim(ll_plot[0] - 100, ur_plot[0] + 100)